@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "chunkmap.h"
+
+#define INITIAL_CAP   64     // must be a power of two
+#define MAX_LOAD_NUM  3      // grow once used slots reach 3/4 of capacity
+#define MAX_LOAD_DEN  4
+#define MIGRATE_STEP  16     // old slots moved across per operation
+
+// an empty slot has value NULL, a removed one points at tombstone
+static char tombstone;
+#define TOMBSTONE ((chunkmapvalue) &tombstone)
+
+typedef struct {
+  uint64_t key;
+  chunkmapvalue value;
+} slot;
+
+typedef struct {
+  slot *slots;
+  uint32_t cap;
+  uint32_t mask;
+  int shift;   // 64 - log2(cap), used by the multiplicative hash
+  uint32_t used;  // live + tombstones
+} table;
+
+struct chunkmap {
+  table cur;
+  table old;      // non-empty only while a resize is in progress
+  uint32_t migrated;  // next old slot to move across
+  int members;
+  chunkmapfreefunc f;
+};
+
+static inline uint64_t packKey(int x, int z){
+  return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+}
+
+static inline uint32_t bucket(table *t, uint64_t key){
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> t->shift);
+}
+
+static void initTable(table *t, uint32_t cap){
+  t->slots = calloc(cap, sizeof(slot));
+  assert(t->slots != NULL);
+  t->cap  = cap;
+  t->mask = cap - 1;
+  t->used = 0;
+  t->shift = 64;
+  while (cap > 1){
+    cap >>= 1;
+    t->shift--;
+  }
+}
+
+static void clearTable(table *t){
+  free(t->slots);
+  t->slots = NULL;
+  t->cap   = 0;
+  t->used  = 0;
+}
+
+// returns the slot holding key, or NULL
+static slot *lookup(table *t, uint64_t key){
+  if (t->slots == NULL) return NULL;
+  uint32_t i = bucket(t, key);
+  for (;;){
+    slot *s = &t->slots[i];
+    if (s->value == NULL) return NULL;
+    if (s->value != TOMBSTONE && s->key == key) return s;
+    i = (i + 1) & t->mask;
+  }
+}
+
+// key must not already be live in t
+static void insert(table *t, uint64_t key, chunkmapvalue v){
+  uint32_t i = bucket(t, key);
+  while (t->slots[i].value != NULL && t->slots[i].value != TOMBSTONE){
+    i = (i + 1) & t->mask;
+  }
+  if (t->slots[i].value == NULL) t->used++;
+  t->slots[i].key   = key;
+  t->slots[i].value = v;
+}
+
+static void migrate(chunkmap m, uint32_t n){
+  if (m->old.slots == NULL) return;
+  while (n-- > 0 && m->migrated < m->old.cap){
+    slot *s = &m->old.slots[m->migrated++];
+    if (s->value != NULL && s->value != TOMBSTONE){
+      insert(&m->cur, s->key, s->value);
+      // keep the probe chain intact for the entries not yet moved
+      s->value = TOMBSTONE;
+    }
+  }
+  if (m->migrated == m->old.cap){
+    clearTable(&m->old);
+  }
+}
+
+// start moving entries into a fresh table once the current one is too full
+static void maybeGrow(chunkmap m){
+  if ((uint64_t)(m->cur.used + 1) * MAX_LOAD_DEN < (uint64_t)m->cur.cap * MAX_LOAD_NUM){
+    return;
+  }
+  // the previous resize has to finish before another one can start
+  migrate(m, UINT32_MAX);
+
+  // size for the live entries only, so tombstone heavy tables shrink back
+  uint32_t cap = m->cur.cap;
+  if ((uint64_t)(m->members + 1) * MAX_LOAD_DEN * 2 >= (uint64_t)cap * MAX_LOAD_NUM){
+    cap *= 2;
+  }
+  m->old = m->cur;
+  m->migrated = 0;
+  initTable(&m->cur, cap);
+  migrate(m, MIGRATE_STEP);
+}
+
+chunkmap chunkMapCreate(chunkmapfreefunc f){
+  chunkmap new = malloc(sizeof(struct chunkmap));
+  assert(new != NULL);
+  initTable(&new->cur, INITIAL_CAP);
+  new->old.slots = NULL;
+  new->old.cap   = 0;
+  new->old.used  = 0;
+  new->migrated  = 0;
+  new->members   = 0;
+  new->f         = f;
+  return new;
+}
+
+static void freeValues(chunkmap m, table *t){
+  if (t->slots == NULL || m->f == NULL) return;
+  for (uint32_t i = 0; i < t->cap; i++){
+    chunkmapvalue v = t->slots[i].value;
+    if (v != NULL && v != TOMBSTONE){
+      m->f(v);
+    }
+  }
+}
+
+void chunkMapFree(chunkmap m){
+  freeValues(m, &m->cur);
+  freeValues(m, &m->old);
+  clearTable(&m->cur);
+  clearTable(&m->old);
+  free(m);
+}
+
+void chunkMapSet(chunkmap m, int x, int z, chunkmapvalue v){
+  assert(v != NULL);
+  uint64_t key = packKey(x, z);
+  migrate(m, MIGRATE_STEP);
+
+  slot *s = lookup(&m->cur, key);
+  if (s == NULL && m->old.slots != NULL){
+    s = lookup(&m->old, key);
+  }
+  if (s != NULL){
+    if (m->f != NULL && s->value != v) m->f(s->value);
+    s->value = v;
+    return;
+  }
+
+  maybeGrow(m);
+  insert(&m->cur, key, v);
+  m->members++;
+}
+
+chunkmapvalue chunkMapFind(chunkmap m, int x, int z){
+  uint64_t key = packKey(x, z);
+  slot *s = lookup(&m->cur, key);
+  if (s == NULL && m->old.slots != NULL){
+    s = lookup(&m->old, key);
+  }
+  return s == NULL ? NULL : s->value;
+}
+
+chunkmapvalue chunkMapRemove(chunkmap m, int x, int z){
+  uint64_t key = packKey(x, z);
+  migrate(m, MIGRATE_STEP);
+
+  slot *s = lookup(&m->cur, key);
+  if (s == NULL && m->old.slots != NULL){
+    s = lookup(&m->old, key);
+  }
+  if (s == NULL) return NULL;
+
+  chunkmapvalue v = s->value;
+  s->value = TOMBSTONE;
+  m->members--;
+  return v;
+}
+
+static void foreachTable(table *t, chunkmapforeachcb cb, void *arg){
+  if (t->slots == NULL) return;
+  for (uint32_t i = 0; i < t->cap; i++){
+    slot *s = &t->slots[i];
+    if (s->value != NULL && s->value != TOMBSTONE){
+      cb((int)(int32_t)(s->key >> 32), (int)(int32_t)(uint32_t)s->key, s->value, arg);
+    }
+  }
+}
+
+void chunkMapForeach(chunkmap m, chunkmapforeachcb cb, void *arg){
+  assert(cb != NULL);
+  foreachTable(&m->cur, cb, arg);
+  foreachTable(&m->old, cb, arg);
+}
+
+int chunkMapMembers(chunkmap m){
+  return m->members;
+}
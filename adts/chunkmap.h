@@ -0,0 +1,29 @@
+#ifndef CHUNKMAP_H
+#define CHUNKMAP_H
+
+/*
+ * chunkmap.h: map from integer chunk coordinates (x, z) to a value.
+ *  keys are packed into a single 64 bit integer, so no strings are
+ *  built or compared. Open addressing with linear probing over a
+ *  power-of-two table; growing is done incrementally, a few slots are
+ *  migrated from the old table on every operation.
+ */
+
+typedef struct chunkmap *chunkmap;
+typedef void *chunkmapvalue;
+
+typedef void (*chunkmapfreefunc)( chunkmapvalue );
+typedef void (*chunkmapforeachcb)( int x, int z, chunkmapvalue, void * );
+
+extern chunkmap chunkMapCreate( chunkmapfreefunc f );
+extern void chunkMapFree( chunkmap m );
+// replaces (and frees) any existing value, v must not be NULL
+extern void chunkMapSet( chunkmap m, int x, int z, chunkmapvalue v );
+// returns NULL when (x, z) is not present
+extern chunkmapvalue chunkMapFind( chunkmap m, int x, int z );
+// unlinks (x, z) and hands the value back to the caller without freeing it
+extern chunkmapvalue chunkMapRemove( chunkmap m, int x, int z );
+extern void chunkMapForeach( chunkmap m, chunkmapforeachcb cb, void *arg );
+extern int chunkMapMembers( chunkmap m );
+
+#endif
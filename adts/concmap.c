@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "concmap.h"
+
+#define SHARD_BITS   4      // 16 shards
+#define SHARDS       (1 << SHARD_BITS)
+#define INITIAL_CAP  64     // must be a power of two
+#define MAX_LOAD_NUM 3      // rebuild once used slots reach 3/4 of capacity
+#define MAX_LOAD_DEN 4
+#define CACHE_LINE   64
+
+// an empty slot has value NULL, a removed one points at tombstone
+static char tombstone;
+#define TOMBSTONE ((concmapvalue) &tombstone)
+
+typedef struct {
+  _Atomic uint64_t key;             // written once, before the value
+  _Atomic(concmapvalue) value;
+} slot;
+
+typedef struct {
+  uint32_t cap;
+  uint32_t mask;
+  slot slots[];
+} slottable;
+
+typedef struct {
+  _Alignas(CACHE_LINE) pthread_mutex_t lock;  // held by writers
+  _Atomic(slottable *) table;
+  uint32_t used;        // live + tombstones, under lock
+  atomic_int members;
+} shard;
+
+typedef struct retired {
+  void *ptr;
+  concmapfreefunc f;
+  struct retired *next;
+} retired;
+
+typedef struct {
+  _Alignas(CACHE_LINE) atomic_uint epoch;  // epoch << 1 | 1 while reading, 0 otherwise
+} reader;
+
+struct concmap {
+  shard shards[SHARDS];
+  reader readers[CONCMAP_MAX_READERS];
+  concmapfreefunc f;
+  atomic_uint epoch;
+  pthread_mutex_t retireLock;
+  retired *limbo[3];    // things retired in epoch e wait in limbo[e % 3]
+};
+
+// every thread that reads gets its own reader slot, in every map
+static atomic_int nextReader;
+static _Thread_local int readerIndex = -1;
+
+static inline uint64_t packKey(int x, int z){
+  return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+}
+
+static inline int unpackX(uint64_t key){
+  return (int)(uint32_t)(key >> 32);
+}
+
+static inline int unpackZ(uint64_t key){
+  return (int)(uint32_t)key;
+}
+
+static inline uint64_t hashKey(uint64_t key){
+  return key * 0x9E3779B97F4A7C15ull;
+}
+
+static inline shard *shardOf(concmap m, uint64_t h){
+  return &m->shards[h >> (64 - SHARD_BITS)];
+}
+
+static inline uint32_t home(slottable *t, uint64_t h){
+  return (uint32_t)(h >> 24) & t->mask;
+}
+
+static slottable *allocTable(uint32_t cap){
+  slottable *t = calloc(1, sizeof(slottable) + (size_t)cap * sizeof(slot));
+  assert(t != NULL);
+  t->cap  = cap;
+  t->mask = cap - 1;
+  return t;
+}
+
+concmap concMapCreate(concmapfreefunc f){
+  concmap new = aligned_alloc(CACHE_LINE, (sizeof(struct concmap) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1));
+  assert(new != NULL);
+  for (int i = 0; i < SHARDS; i++){
+    shard *s = &new->shards[i];
+    pthread_mutex_init(&s->lock, NULL);
+    atomic_init(&s->table, allocTable(INITIAL_CAP));
+    s->used = 0;
+    atomic_init(&s->members, 0);
+  }
+  for (int i = 0; i < CONCMAP_MAX_READERS; i++){
+    atomic_init(&new->readers[i].epoch, 0);
+  }
+  new->f = f;
+  atomic_init(&new->epoch, 1);
+  pthread_mutex_init(&new->retireLock, NULL);
+  for (int i = 0; i < 3; i++) new->limbo[i] = NULL;
+  return new;
+}
+
+static int freeRetired(retired *r){
+  int n = 0;
+  while (r != NULL){
+    retired *next = r->next;
+    if (r->f != NULL) r->f(r->ptr);
+    free(r);
+    r = next;
+    n++;
+  }
+  return n;
+}
+
+void concMapFree(concmap m){
+  for (int i = 0; i < SHARDS; i++){
+    shard *s = &m->shards[i];
+    slottable *t = atomic_load(&s->table);
+    for (uint32_t j = 0; j < t->cap; j++){
+      concmapvalue v = atomic_load_explicit(&t->slots[j].value, memory_order_relaxed);
+      if (v != NULL && v != TOMBSTONE && m->f != NULL) m->f(v);
+    }
+    free(t);
+    pthread_mutex_destroy(&s->lock);
+  }
+  for (int i = 0; i < 3; i++) freeRetired(m->limbo[i]);
+  pthread_mutex_destroy(&m->retireLock);
+  free(m);
+}
+
+// hand ptr to f once no reader can be looking at it
+static void retire(concmap m, void *ptr, concmapfreefunc f){
+  retired *r = malloc(sizeof(retired));
+  assert(r != NULL);
+  r->ptr = ptr;
+  r->f   = f;
+  pthread_mutex_lock(&m->retireLock);
+  unsigned e = atomic_load(&m->epoch);
+  r->next = m->limbo[e % 3];
+  m->limbo[e % 3] = r;
+  pthread_mutex_unlock(&m->retireLock);
+}
+
+static void freeTable(void *t){
+  free(t);
+}
+
+int concMapCollect(concmap m){
+  pthread_mutex_lock(&m->retireLock);
+  unsigned e = atomic_load(&m->epoch);
+  for (int i = 0; i < CONCMAP_MAX_READERS; i++){
+    unsigned r = atomic_load(&m->readers[i].epoch);
+    if ((r & 1) && (r >> 1) != e){
+      // somebody is still reading in the previous epoch
+      pthread_mutex_unlock(&m->retireLock);
+      return 0;
+    }
+  }
+  atomic_store(&m->epoch, e + 1);
+  // everything retired two epochs ago is now out of every reader's reach
+  retired *done = m->limbo[(e + 2) % 3];
+  m->limbo[(e + 2) % 3] = NULL;
+  pthread_mutex_unlock(&m->retireLock);
+  return freeRetired(done);
+}
+
+void concMapReadBegin(concmap m){
+  if (readerIndex < 0){
+    readerIndex = atomic_fetch_add(&nextReader, 1);
+    assert(readerIndex < CONCMAP_MAX_READERS);
+  }
+  reader *r = &m->readers[readerIndex];
+  assert(atomic_load_explicit(&r->epoch, memory_order_relaxed) == 0);
+  atomic_store(&r->epoch, (atomic_load(&m->epoch) << 1) | 1);
+  // the announcement must be visible before any slot is read
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+void concMapReadEnd(concmap m){
+  atomic_store_explicit(&m->readers[readerIndex].epoch, 0, memory_order_release);
+}
+
+concmapvalue concMapFind(concmap m, int x, int z){
+  uint64_t key = packKey(x, z);
+  uint64_t h   = hashKey(key);
+  slottable *t = atomic_load_explicit(&shardOf(m, h)->table, memory_order_acquire);
+  uint32_t i = home(t, h);
+  for (uint32_t n = 0; n < t->cap; n++){
+    concmapvalue v = atomic_load_explicit(&t->slots[i].value, memory_order_acquire);
+    if (v == NULL) return NULL;
+    if (atomic_load_explicit(&t->slots[i].key, memory_order_relaxed) == key){
+      return v == TOMBSTONE ? NULL : v;
+    }
+    i = (i + 1) & t->mask;
+  }
+  return NULL;
+}
+
+void concMapForeach(concmap m, concmapforeachcb cb, void *arg){
+  for (int i = 0; i < SHARDS; i++){
+    slottable *t = atomic_load_explicit(&m->shards[i].table, memory_order_acquire);
+    for (uint32_t j = 0; j < t->cap; j++){
+      concmapvalue v = atomic_load_explicit(&t->slots[j].value, memory_order_acquire);
+      if (v == NULL || v == TOMBSTONE) continue;
+      uint64_t key = atomic_load_explicit(&t->slots[j].key, memory_order_relaxed);
+      cb(unpackX(key), unpackZ(key), v, arg);
+    }
+  }
+}
+
+// copy the live entries of s into a fresh table with room to spare
+static slottable *rebuild(concmap m, shard *s){
+  slottable *old = atomic_load_explicit(&s->table, memory_order_relaxed);
+  uint32_t live = (uint32_t)atomic_load(&s->members);
+  uint32_t cap  = INITIAL_CAP;
+  while ((live + 1) * 2 > cap) cap *= 2;
+
+  slottable *t = allocTable(cap);
+  for (uint32_t j = 0; j < old->cap; j++){
+    concmapvalue v = atomic_load_explicit(&old->slots[j].value, memory_order_relaxed);
+    if (v == NULL || v == TOMBSTONE) continue;
+    uint64_t key = atomic_load_explicit(&old->slots[j].key, memory_order_relaxed);
+    uint32_t i = home(t, hashKey(key));
+    while (atomic_load_explicit(&t->slots[i].value, memory_order_relaxed) != NULL){
+      i = (i + 1) & t->mask;
+    }
+    atomic_store_explicit(&t->slots[i].key, key, memory_order_relaxed);
+    atomic_store_explicit(&t->slots[i].value, v, memory_order_relaxed);
+  }
+  s->used = live;
+  atomic_store_explicit(&s->table, t, memory_order_release);
+  retire(m, old, &freeTable);
+  return t;
+}
+
+void concMapSet(concmap m, int x, int z, concmapvalue v){
+  assert(v != NULL);
+  uint64_t key = packKey(x, z);
+  uint64_t h   = hashKey(key);
+  shard *s = shardOf(m, h);
+  pthread_mutex_lock(&s->lock);
+
+  slottable *t = atomic_load_explicit(&s->table, memory_order_relaxed);
+  uint32_t i = home(t, h);
+  for (;;){
+    slot *sl = &t->slots[i];
+    concmapvalue old = atomic_load_explicit(&sl->value, memory_order_relaxed);
+    if (old == NULL){
+      if ((s->used + 1) * MAX_LOAD_DEN > t->cap * MAX_LOAD_NUM){
+        t = rebuild(m, s);
+        i = home(t, h);
+        continue;
+      }
+      atomic_store_explicit(&sl->key, key, memory_order_relaxed);
+      atomic_store_explicit(&sl->value, v, memory_order_release);
+      s->used++;
+      atomic_fetch_add(&s->members, 1);
+      break;
+    }
+    if (atomic_load_explicit(&sl->key, memory_order_relaxed) == key){
+      atomic_store_explicit(&sl->value, v, memory_order_release);
+      if (old == TOMBSTONE){
+        atomic_fetch_add(&s->members, 1);
+      } else if (old != v){
+        retire(m, old, m->f);
+      }
+      break;
+    }
+    i = (i + 1) & t->mask;
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+bool concMapDelete(concmap m, int x, int z){
+  uint64_t key = packKey(x, z);
+  uint64_t h   = hashKey(key);
+  shard *s = shardOf(m, h);
+  bool found = false;
+  pthread_mutex_lock(&s->lock);
+
+  slottable *t = atomic_load_explicit(&s->table, memory_order_relaxed);
+  uint32_t i = home(t, h);
+  for (;;){
+    slot *sl = &t->slots[i];
+    concmapvalue old = atomic_load_explicit(&sl->value, memory_order_relaxed);
+    if (old == NULL) break;
+    if (atomic_load_explicit(&sl->key, memory_order_relaxed) == key){
+      if (old != TOMBSTONE){
+        atomic_store_explicit(&sl->value, TOMBSTONE, memory_order_release);
+        atomic_fetch_sub(&s->members, 1);
+        retire(m, old, m->f);
+        found = true;
+      }
+      break;
+    }
+    i = (i + 1) & t->mask;
+  }
+  pthread_mutex_unlock(&s->lock);
+  return found;
+}
+
+int concMapMembers(concmap m){
+  int n = 0;
+  for (int i = 0; i < SHARDS; i++){
+    n += atomic_load(&m->shards[i].members);
+  }
+  return n;
+}
@@ -0,0 +1,53 @@
+#ifndef CONCMAP_H
+#define CONCMAP_H
+
+#include <stdbool.h>
+
+/*
+ * concmap.h: chunkmap for several threads. Keys are packed (x, z) pairs
+ *  as in chunkmap.h. The map is split into shards, each an open
+ *  addressing table with its own writer lock; lookups take no lock at
+ *  all. A slot's key is written once and never changes, removal only
+ *  swaps the value for a tombstone, and tables are rebuilt rather than
+ *  resized in place, so a reader always sees a consistent table.
+ *
+ *  Replaced values, removed values and old tables are not freed
+ *  straight away but retired: concMapCollect frees them once every
+ *  reader that might still hold them has left its read section
+ *  (epoch based reclamation).
+ */
+
+typedef struct concmap *concmap;
+typedef void *concmapvalue;
+
+typedef void (*concmapfreefunc)( concmapvalue );
+typedef void (*concmapforeachcb)( int x, int z, concmapvalue, void * );
+
+// at most this many threads may ever read from concmaps
+#define CONCMAP_MAX_READERS 64
+
+extern concmap concMapCreate( concmapfreefunc f );
+// no other thread may be using the map any more
+extern void concMapFree( concmap m );
+
+// Readers bracket lookups, and every use of the values they return, with
+// these. Read sections do not nest.
+extern void concMapReadBegin( concmap m );
+extern void concMapReadEnd( concmap m );
+// returns NULL when (x, z) is not present
+extern concmapvalue concMapFind( concmap m, int x, int z );
+// sees each entry present for the whole walk, others maybe
+extern void concMapForeach( concmap m, concmapforeachcb cb, void *arg );
+
+// Writers need no read section. v must not be NULL.
+extern void concMapSet( concmap m, int x, int z, concmapvalue v );
+// returns false if (x, z) was not present
+extern bool concMapDelete( concmap m, int x, int z );
+extern int concMapMembers( concmap m );
+
+// frees whatever no reader can see any more, on the calling thread (so
+// call it from the GL thread when values own GL objects). Returns how
+// many values and tables were freed.
+extern int concMapCollect( concmap m );
+
+#endif
@@ -1,13 +1,13 @@
 /*
  * hash.c: hash storage for C.. new version of assoc.c with cooler
  * 	   name and more features (copying, depth metrics etc)
- * 	   we store a hash as a hash table, hashing each key into
- * 	   a dynamic array of binary search trees, and then
- * 	   search/include/exclude the key,value pair in/from the
- * 	   corresponding search tree.  The hash also stores 3 func
- * 	   ptrs: a (file,key,value) print function, a value free function,
- * 	   and a value copy function.  These enable you to use values
- * 	   that are themselves complex data structures.
+ * 	   the (key,value) pairs now live in a string-keyed table
+ * 	   (see table.c: open addressing, no per-entry nodes, no
+ * 	   recursion), this file just keeps the old interface.  The
+ * 	   hash also stores 3 func ptrs: a (file,key,value) print
+ * 	   function, a value free function, and a value copy function.
+ * 	   These enable you to use values that are themselves complex
+ * 	   data structures.
  *
  * (C) Duncan C. White, 1996-2013 although it seems longer:-)
  */
@@ -18,46 +18,21 @@
 #include <assert.h>
 
 #include "hash.h"
-
-
-#define	NHASH	32533
-
-
-typedef struct tree_s *tree;
+#include "table.h"
 
 
 struct hash_s {
-	tree *		data;			/* dynamic array of trees */
+	table		t;			/* string key -> value */
 	hashprintfunc	p;			/* how to print (k,v) pair */
 	hashfreefunc	f;			/* how to free a value  */
 	hashcopyfunc	c;			/* how to copy a value  */
 };
 
-struct tree_s {
-	hashkey		k;			/* Key */
-	hashvalue   	v;			/* Value */
-	tree		left;			/* Left... */
-	tree		right;			/* ... and Right trees */
-};
-
-
-/*
- * operation
- */
-typedef enum { Search, Define } tree_operation;
-
 
 /* Private functions */
 
-static void foreach_tree( tree, hashforeachcb, void * );
 static void dump_cb( hashkey, hashvalue, void * );
-static void free_tree( tree, hashfreefunc );
 static void freevalue( hashfreefunc, hashvalue );
-static tree copy_tree( tree, hashcopyfunc );
-static int depth_tree( tree );
-static tree tree_op( hash, hashkey, hashvalue, tree_operation );
-static tree talloc( hashkey, hashvalue );
-static int shash( char * );
 
 
 /*
@@ -65,22 +40,17 @@ static int shash( char * );
  */
 hash hashCreate( hashprintfunc p, hashfreefunc f, hashcopyfunc c )
 {
-	int  i;
 	hash h;
 
 	h = (hash) malloc( sizeof(struct hash_s) );
+	assert( h != NULL );
 
-	h->data = (tree *) malloc( NHASH*sizeof(tree) );
-
+	/* values are freed here, the table only owns its keys */
+	h->t = tableCreate( TABLE_KEY_STRING, 0, NULL );
 	h->f = f;
 	h->p = p;
 	h->c = c;
 
-	for( i = 0; i < NHASH; i++ )
-	{
-		h->data[i] = NULL;
-	}
-
 	return h;
 }
 
@@ -90,16 +60,14 @@ hash hashCreate( hashprintfunc p, hashfreefunc f, hashcopyfunc c )
  */
 void hashEmpty( hash a )
 {
-	int   i;
+	tableiter	it = tableIterate( a->t );
+	hashvalue	v;
 
-	for( i = 0; i < NHASH; i++ )
+	while( tableNext( &it, NULL, &v ) )
 	{
-		if( a->data[i] != NULL )
-		{
-			free_tree( a->data[i], a->f );
-			a->data[i] = NULL;
-		}
+		freevalue( a->f, v );
 	}
+	tableEmpty( a->t );
 }
 
 
@@ -108,22 +76,14 @@ void hashEmpty( hash a )
  */
 hash hashCopy( hash h )
 {
-	int   i;
-	hash   result;
-
-	result = (hash) malloc( sizeof(struct hash_s) );
-	result->data = (tree *) malloc( NHASH*sizeof(tree) );
-	result->p = h->p;
-	result->f = h->f;
-	result->c = h->c;
+	hash		result = hashCreate( h->p, h->f, h->c );
+	tableiter	it = tableIterate( h->t );
+	const void *	k;
+	hashvalue	v;
 
-	for( i = 0; i < NHASH; i++ )
+	while( tableNext( &it, &k, &v ) )
 	{
-		result->data[i] = NULL;
-		if( h->data[i] != NULL )
-		{
-			result->data[i] = copy_tree( h->data[i], h->c );
-		}
+		tableSet( result->t, k, h->c != NULL ? (*h->c)(v) : v );
 	}
 
 	return result;
@@ -135,27 +95,25 @@ hash hashCopy( hash h )
  */
 void hashFree( hash h )
 {
-	int   i;
-
-	for( i = 0; i < NHASH; i++ )
-	{
-		if( h->data[i] != NULL )
-		{
-			free_tree( h->data[i], h->f );
-		}
-	}
-
-	free( (hashvalue) h->data );
+	hashEmpty( h );
+	tableFree( h->t );
 	free( (hashvalue) h );
 }
 
 
 /*
- * Add k->v to the hash h
+ * Add k->v to the hash h, the table keeps its own copy of k
  */
 void hashSet( hash h, hashkey k, hashvalue v )
 {
-	(void) tree_op( h, k, v, Define);
+	hashvalue old;
+
+	if( tablePresent( h->t, k, &old ) )
+	{
+		/* free old value */
+		freevalue( h->f, old );
+	}
+	tableSet( h->t, k, v );
 }
 
 
@@ -167,13 +125,11 @@ void hashSet( hash h, hashkey k, hashvalue v )
  */
 int hashPresent( hash h, hashkey k, hashvalue *v )
 {
-	tree x = tree_op(h, k, 0, Search);
-	if( x == NULL )
+	if( ! tablePresent( h->t, k, v ) )
 	{
 		*v = (hashvalue)-1;
 		return 0;
 	}
-	*v = x->v;
 	return 1;
 }
 
@@ -183,9 +139,7 @@ int hashPresent( hash h, hashkey k, hashvalue *v )
  */
 hashvalue hashFind( hash h, hashkey k )
 {
-	tree x = tree_op(h, k, 0, Search);
-
-	return ( x == NULL ) ? (hashvalue) NULL : x->v;
+	return tableFind( h->t, k );
 }
 
 
@@ -195,13 +149,15 @@ hashvalue hashFind( hash h, hashkey k )
  */
 void hashForeach( hash h, hashforeachcb cb, void * arg )
 {
-	int	i;
+	tableiter	it = tableIterate( h->t );
+	const void *	k;
+	hashvalue	v;
 
-	for( i = 0; i < NHASH; i++ ) {
-		if( h->data[i] != NULL )
-		{
-			foreach_tree( h->data[i], cb, arg );
-		}
+	assert( cb != NULL );
+
+	while( tableNext( &it, &k, &v ) )
+	{
+		(*cb)( (hashkey) k, v, arg );
 	}
 }
 
@@ -242,67 +198,22 @@ void hashDump( FILE *out, hash h )
 }
 
 
-/*
- * Allocate a new node in the tree
- */
-static tree talloc( hashkey k, hashvalue v )
-{
-	tree   p = (tree) malloc(sizeof(struct tree_s));
-
-	if( p == NULL )
-	{
-		fprintf( stderr, "talloc: No space left\n" );
-		exit(1);
-	}
-	p->left = p->right = NULL;
-	p->k    = strdup(k);		/* Save key */
-	p->v    = v;			/* value */
-	return p;
-}
-
-
 /*
  * Hash metrics:
- *  calculate the min, max and average depth of all non-empty trees
- *  sadly can't do this with a hashForeach unless the depth is magically
- *  passed into the callback..
+ *  calculate the min, max and average probe length of all entries
  */
 void hashMetrics( hash h, int *min, int *max, double *avg )
 {
-	int	i;
-	int	nonempty = 0;
-	int	total    = 0;
-
-	*min =  100000000;
-	*max = -100000000;
-	for( i = 0; i < NHASH; i++ )
-	{
-		if( h->data[i] != NULL )
-		{
-			int d = depth_tree( h->data[i] );
-			if( d < *min ) *min = d;
-			if( d > *max ) *max = d;
-			total += d;
-			nonempty++;
-		}
-	}
-	*avg = ((double)total)/(double)nonempty;
+	tableMetrics( h->t, min, max, avg );
 }
 
 
 /*
  * Hash members: how many members in the Hash?
  */
-static void count_cb( hashkey k, hashvalue v, void *arg )
-{
-	int *n = (int *)arg;
-	(*n)++;
-}
 int hashMembers( hash h )
 {
-	int n = 0;
-	hashForeach( h, &count_cb, (void *)&n );
-	return n;
+	return tableMembers( h->t );
 }
 
 /*
@@ -313,97 +224,6 @@ int hashIsEmpty( hash h )
 	return hashMembers( h ) == 0;
 }
 
-/*
- * Operate on the binary search tree
- * Search, Define.
- */
-static tree tree_op( hash h, hashkey k, hashvalue v, tree_operation op )
-{
-	tree	ptr;
-	tree *	aptr = h->data + shash(k);
-
-	while( (ptr = *aptr) != NULL )
-	{
-		int rc = strcmp(ptr->k, k);
-		if( rc == 0 )
-		{
-			if (op == Define)
-			{
-				/* free old value */
-				freevalue( h->f, ptr->v );
-				/* set new value */
-				ptr->v = v;
-			}
-			return ptr;
-		}
-		if (rc < 0)
-		{
-			/* less - left */
-			aptr = &(ptr->left);
-		} else
-		{
-			/* more - right */
-			aptr = &(ptr->right);
-		}
-	}
-
-	if (op == Define)
-	{
-		return *aptr = talloc(k,v);	/* Alloc new node */
-	}
-
-	return NULL;				/* not found */
-}
-
-
-/*
- * Copy one tree
- */
-static tree copy_tree( tree t, hashcopyfunc c )
-{
-	tree result = NULL;
-	if( t )
-	{
-		hashvalue v = c != NULL ? (*c)(t->v) : t->v;
-		result = talloc( t->k, v );
-		result->left  = copy_tree( t->left, c );
-		result->right = copy_tree( t->right, c );
-	}
-	return result;
-}
-
-
-/*
- * foreach one tree
- */
-static void foreach_tree( tree t, hashforeachcb f, void * arg )
-{
-	assert( f != NULL );
-
-	if( t )
-	{
-		foreach_tree( t->left, f, arg );
-		(*f)( t->k, t->v, arg );
-		foreach_tree( t->right, f, arg );
-	}
-}
-
-
-/*
- * Free one tree
- */
-static void free_tree( tree t, hashfreefunc f )
-{
-	if( t )
-	{
-		free_tree( t->left, f );
-		free_tree( t->right, f );
-		freevalue( f, t->v );
-		free( (hashvalue) t->k );
-		free( (hashvalue) t );
-	}
-}
-
 
 static void freevalue( hashfreefunc f, hashvalue v )
 {
@@ -415,31 +235,3 @@ static void freevalue( hashfreefunc f, hashvalue v )
 		free( v );
 	}
 }
-
-
-/*
- * Compute the depth of a given tree
- */
-#define max(a,b)  ((a)>(b)?(a):(b))
-static int depth_tree( tree t )
-{
-	if( t )
-	{
-		int d2 = depth_tree( t->left );
-		int d3 = depth_tree( t->right );
-		return 1 + max(d2,d3);
-	}
-	return 0;
-}
-
-
-/*
- * Calculate hash on a string
- */
-static int shash( char *str )
-{
-	unsigned char	ch;
-	unsigned int	hh;
-	for (hh = 0; (ch = *str++) != '\0'; hh = hh * 65599 + ch );
-	return hh % NHASH;
-}
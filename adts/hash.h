@@ -1,6 +1,7 @@
 /*
  * hash.h: hash storage for C..
- *  a hash (aka a map) is a hash table of (hashkey, hashvalue) trees..
+ *  a hash (aka a map) of (hashkey, hashvalue) pairs, stored in a
+ *  string-keyed table (see table.h)..
  *  here hashkey == string, hashvalue == void * (generic pointer)
  *
  * (C) Duncan C. White, 1996-2020 although it seems longer:-)
@@ -20,6 +21,9 @@ extern hash hashCreate( hashprintfunc p, hashfreefunc f, hashcopyfunc c );
 extern void hashEmpty( hash a );
 extern hash hashCopy( hash h );
 extern void hashFree( hash h );
+/*  k is copied, so the caller still owns (and frees) the key it passed.
+ *  v belongs to the hash from here on: it is freed by the free function
+ *  when replaced by another hashSet of k, or when the hash is emptied */
 extern void hashSet( hash h, hashkey k, hashvalue v );
 extern int hashPresent( hash h, hashkey k, hashvalue * v );
 extern hashvalue hashFind( hash h, hashkey k );
@@ -28,5 +32,5 @@ extern void hashDump( FILE * out, hash h );
 extern int hashMembers( hash h );
 extern int hashIsEmpty( hash h );
 
-/*  calculate the min, max and average depth of all non-empty trees */
+/*  calculate the min, max and average probe length of all entries */
 extern void hashMetrics( hash h, int * min, int * max, double * avg );
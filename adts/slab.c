@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "slab.h"
+
+// lives in the first slot(s) of every slab
+typedef struct slab {
+  struct slab *prev, *next;  // list of slabs with a free slot
+  void *freeList;            // released slots, linked through their first word
+  int used;
+  int fresh;                 // slots never handed out start at this index
+  int index;                 // position in the pool's slab array
+  bool onList;
+} slab;
+
+struct slabpool {
+  size_t slotBytes;
+  int headerSlots;
+  int slotsPerSlab;
+  slab *partial;   // slabs with at least one free slot
+  slab *spare;     // an empty slab kept around to absorb churn
+  slab **slabs;
+  int numSlabs;
+  int capSlabs;
+  slabStats stats;
+};
+
+static size_t roundToLine(size_t n){
+  return (n + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+}
+
+slabpool slabPoolCreate(size_t objectBytes){
+  slabpool new = malloc(sizeof(struct slabpool));
+  assert(new != NULL);
+  if (objectBytes < sizeof(void *)) objectBytes = sizeof(void *);
+  new->slotBytes    = roundToLine(objectBytes);
+  new->headerSlots  = (int)((roundToLine(sizeof(slab)) + new->slotBytes - 1) / new->slotBytes);
+  new->slotsPerSlab = (int)(SLAB_BYTES / new->slotBytes) - new->headerSlots;
+  assert(new->slotsPerSlab > 0);
+  new->partial  = NULL;
+  new->spare    = NULL;
+  new->numSlabs = 0;
+  new->capSlabs = 16;
+  new->slabs    = malloc(new->capSlabs * sizeof(slab *));
+  assert(new->slabs != NULL);
+
+  new->stats.slotBytes     = new->slotBytes;
+  new->stats.slotsPerSlab  = new->slotsPerSlab;
+  new->stats.slabs         = 0;
+  new->stats.inUse         = 0;
+  new->stats.peakInUse     = 0;
+  new->stats.allocations   = 0;
+  new->stats.releases      = 0;
+  new->stats.reservedBytes = 0;
+  return new;
+}
+
+void slabPoolFree(slabpool p){
+  for (int i = 0; i < p->numSlabs; i++){
+    free(p->slabs[i]);
+  }
+  free(p->slabs);
+  free(p);
+}
+
+static void pushPartial(slabpool p, slab *s){
+  s->prev = NULL;
+  s->next = p->partial;
+  if (p->partial != NULL) p->partial->prev = s;
+  p->partial = s;
+  s->onList = true;
+}
+
+static void unlinkPartial(slabpool p, slab *s){
+  if (s->prev != NULL) s->prev->next = s->next;
+  else p->partial = s->next;
+  if (s->next != NULL) s->next->prev = s->prev;
+  s->onList = false;
+}
+
+static slab *newSlab(slabpool p){
+  slab *s = aligned_alloc(SLAB_BYTES, SLAB_BYTES);
+  assert(s != NULL);
+  s->freeList = NULL;
+  s->used     = 0;
+  s->fresh    = 0;
+
+  if (p->numSlabs == p->capSlabs){
+    p->capSlabs *= 2;
+    p->slabs = realloc(p->slabs, p->capSlabs * sizeof(slab *));
+    assert(p->slabs != NULL);
+  }
+  s->index = p->numSlabs;
+  p->slabs[p->numSlabs++] = s;
+  pushPartial(p, s);
+
+  p->stats.slabs++;
+  p->stats.reservedBytes += SLAB_BYTES;
+  return s;
+}
+
+static void dropSlab(slabpool p, slab *s){
+  unlinkPartial(p, s);
+  p->slabs[s->index] = p->slabs[--p->numSlabs];
+  p->slabs[s->index]->index = s->index;
+  free(s);
+  p->stats.slabs--;
+  p->stats.reservedBytes -= SLAB_BYTES;
+}
+
+void *slabAlloc(slabpool p){
+  slab *s = p->partial != NULL ? p->partial : newSlab(p);
+  if (s == p->spare) p->spare = NULL;
+
+  void *obj;
+  if (s->freeList != NULL){
+    obj = s->freeList;
+    s->freeList = *(void **)obj;
+  } else {
+    obj = (char *)s + (size_t)(p->headerSlots + s->fresh) * p->slotBytes;
+    s->fresh++;
+  }
+  if (++s->used == p->slotsPerSlab) unlinkPartial(p, s);
+
+  p->stats.allocations++;
+  if (++p->stats.inUse > p->stats.peakInUse) p->stats.peakInUse = p->stats.inUse;
+  return obj;
+}
+
+void slabRelease(slabpool p, void *obj){
+  if (obj == NULL) return;
+  slab *s = (slab *)((uintptr_t)obj & ~(uintptr_t)(SLAB_BYTES - 1));
+  *(void **)obj = s->freeList;
+  s->freeList = obj;
+  if (!s->onList) pushPartial(p, s);
+
+  p->stats.releases++;
+  p->stats.inUse--;
+
+  if (--s->used == 0){
+    if (p->spare == NULL){
+      p->spare = s;
+    } else {
+      dropSlab(p, s);
+    }
+  }
+}
+
+slabStats slabPoolStats(slabpool p){
+  return p->stats;
+}
+
+void slabPoolReport(FILE *out, slabpool p){
+  // occupancy buckets: empty, 1-25%, 26-50%, 51-75%, 76-99%, full
+  int buckets[6] = {0};
+  long stranded = 0;   // free slots in slabs that cannot be returned
+  for (int i = 0; i < p->numSlabs; i++){
+    slab *s = p->slabs[i];
+    int b;
+    if (s->used == 0) b = 0;
+    else if (s->used == p->slotsPerSlab) b = 5;
+    else b = 1 + (s->used * 4 - 1) / p->slotsPerSlab;
+    buckets[b]++;
+    if (s->used > 0) stranded += p->slotsPerSlab - s->used;
+  }
+  long capacity = (long)p->numSlabs * p->slotsPerSlab;
+  double fragmentation = capacity > 0 ? (double)stranded / capacity : 0.0;
+
+  fprintf(out, "slab pool: %zu byte slots, %d per slab, %d slabs (%zu KB)\n",
+          p->slotBytes, p->slotsPerSlab, p->numSlabs, p->stats.reservedBytes / 1024);
+  fprintf(out, "  in use %ld (peak %ld), %lu allocations, %lu releases\n",
+          p->stats.inUse, p->stats.peakInUse, p->stats.allocations, p->stats.releases);
+  fprintf(out, "  slabs by occupancy: empty %d, <=25%% %d, <=50%% %d, <=75%% %d, <100%% %d, full %d\n",
+          buckets[0], buckets[1], buckets[2], buckets[3], buckets[4], buckets[5]);
+  fprintf(out, "  fragmentation %.1f%% (%ld free slots in partly used slabs)\n",
+          fragmentation * 100.0, stranded);
+}
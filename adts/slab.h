@@ -0,0 +1,41 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * slab.h: fixed-size object pool.
+ *  objects are carved out of SLAB_BYTES slabs, each slot rounded up to
+ *  a whole number of cache lines so no two objects share a line. A
+ *  released slot goes back on its slab's free list and is handed out
+ *  again before any new slab is made; a slab that empties is returned
+ *  to the system unless it is the only spare. Not thread safe.
+ */
+
+#define CACHE_LINE 64
+#define SLAB_BYTES (16 * 1024)  // power of two, slabs are aligned to it
+
+typedef struct slabpool *slabpool;
+
+typedef struct {
+  size_t slotBytes;          // object size rounded up to cache lines
+  int slotsPerSlab;
+  int slabs;
+  long inUse;
+  long peakInUse;
+  unsigned long allocations;
+  unsigned long releases;
+  size_t reservedBytes;      // slab memory held, used or not
+} slabStats;
+
+extern slabpool slabPoolCreate( size_t objectBytes );
+// releases every slab, objects still in use included
+extern void slabPoolFree( slabpool p );
+extern void *slabAlloc( slabpool p );
+extern void slabRelease( slabpool p, void *obj );
+extern slabStats slabPoolStats( slabpool p );
+// occupancy of each slab and how much of the reserved memory is stranded
+extern void slabPoolReport( FILE *out, slabpool p );
+
+#endif
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include "table.h"
+
+#define INITIAL_CAP   16     // must be a power of two
+#define MAX_LOAD_NUM  7      // grow once 7/8 of the slots are used
+#define MAX_LOAD_DEN  8
+#define EMPTY         0      // stored hashes always have the top bit set
+
+struct table {
+  tablekeytype type;
+  size_t keyBytes;        // bytes of key stored per slot
+  tablefreefunc f;
+  uint32_t *hashes;       // EMPTY marks an unused slot
+  unsigned char *keys;    // cap * keyBytes, a char * for string keys
+  tablevalue *values;
+  uint32_t cap;
+  uint32_t mask;
+  uint32_t members;
+  unsigned char *scratch; // two keys' worth, used while displacing entries
+};
+
+static uint64_t mix64(uint64_t x){
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t fnv1a(const unsigned char *p, size_t n){
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < n; i++){
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static uint32_t hashKey(table t, const void *key){
+  uint64_t h;
+  switch (t->type){
+    case TABLE_KEY_INT:   h = mix64((uint64_t)*(const int64_t *)key); break;
+    case TABLE_KEY_BYTES: h = mix64(fnv1a(key, t->keyBytes)); break;
+    default:              h = mix64(fnv1a(key, strlen(key))); break;
+  }
+  return (uint32_t)(h >> 32) | 0x80000000u;
+}
+
+static unsigned char *slotKey(table t, uint32_t i){
+  return t->keys + (size_t)i * t->keyBytes;
+}
+
+// what callers see as the key of slot i
+static const void *userKey(table t, uint32_t i){
+  if (t->type == TABLE_KEY_STRING) return *(char **)slotKey(t, i);
+  return slotKey(t, i);
+}
+
+static bool keyEquals(table t, uint32_t i, const void *key){
+  switch (t->type){
+    case TABLE_KEY_INT:   return *(int64_t *)slotKey(t, i) == *(const int64_t *)key;
+    case TABLE_KEY_BYTES: return memcmp(slotKey(t, i), key, t->keyBytes) == 0;
+    default:              return strcmp(*(char **)slotKey(t, i), key) == 0;
+  }
+}
+
+// how far slot i is from the home slot of hash h
+static uint32_t distance(table t, uint32_t h, uint32_t i){
+  return (i - (h & t->mask)) & t->mask;
+}
+
+static void allocSlots(table t, uint32_t cap){
+  t->cap     = cap;
+  t->mask    = cap - 1;
+  t->hashes  = calloc(cap, sizeof(uint32_t));
+  t->keys    = malloc((size_t)cap * t->keyBytes);
+  t->values  = malloc((size_t)cap * sizeof(tablevalue));
+  assert(t->hashes != NULL && t->keys != NULL && t->values != NULL);
+}
+
+table tableCreate(tablekeytype type, size_t keyBytes, tablefreefunc f){
+  table new = malloc(sizeof(struct table));
+  assert(new != NULL);
+  new->type = type;
+  switch (type){
+    case TABLE_KEY_INT:   new->keyBytes = sizeof(int64_t); break;
+    case TABLE_KEY_BYTES: new->keyBytes = keyBytes; break;
+    default:              new->keyBytes = sizeof(char *); break;
+  }
+  assert(new->keyBytes > 0);
+  new->f       = f;
+  new->members = 0;
+  new->scratch = malloc(2 * new->keyBytes);
+  assert(new->scratch != NULL);
+  allocSlots(new, INITIAL_CAP);
+  return new;
+}
+
+void tableEmpty(table t){
+  for (uint32_t i = 0; i < t->cap; i++){
+    if (t->hashes[i] == EMPTY) continue;
+    if (t->f != NULL) t->f(t->values[i]);
+    if (t->type == TABLE_KEY_STRING) free(*(char **)slotKey(t, i));
+    t->hashes[i] = EMPTY;
+  }
+  t->members = 0;
+}
+
+void tableFree(table t){
+  tableEmpty(t);
+  free(t->hashes);
+  free(t->keys);
+  free(t->values);
+  free(t->scratch);
+  free(t);
+}
+
+// returns the slot holding key, or -1
+static int64_t findSlot(table t, const void *key, uint32_t h){
+  uint32_t i = h & t->mask;
+  for (uint32_t d = 0; ; d++){
+    uint32_t sh = t->hashes[i];
+    // a richer entry here means ours would have taken this slot
+    if (sh == EMPTY || distance(t, sh, i) < d) return -1;
+    if (sh == h && keyEquals(t, i, key)) return i;
+    i = (i + 1) & t->mask;
+  }
+}
+
+// key is in stored form; the caller has made sure there is room
+static void insertSlot(table t, uint32_t h, const unsigned char *key, tablevalue v){
+  unsigned char *carry = t->scratch;
+  unsigned char *tmp   = t->scratch + t->keyBytes;
+  memcpy(carry, key, t->keyBytes);
+
+  uint32_t i = h & t->mask;
+  for (uint32_t d = 0; ; d++){
+    uint32_t sh = t->hashes[i];
+    if (sh == EMPTY){
+      t->hashes[i] = h;
+      memcpy(slotKey(t, i), carry, t->keyBytes);
+      t->values[i] = v;
+      return;
+    }
+    uint32_t theirs = distance(t, sh, i);
+    if (theirs < d){
+      // take from the rich: swap and carry on inserting the old entry
+      t->hashes[i] = h;
+      h = sh;
+      memcpy(tmp, slotKey(t, i), t->keyBytes);
+      memcpy(slotKey(t, i), carry, t->keyBytes);
+      memcpy(carry, tmp, t->keyBytes);
+      tablevalue old = t->values[i];
+      t->values[i] = v;
+      v = old;
+      d = theirs;
+    }
+    i = (i + 1) & t->mask;
+  }
+}
+
+static void grow(table t){
+  uint32_t oldCap         = t->cap;
+  uint32_t *oldHashes     = t->hashes;
+  unsigned char *oldKeys  = t->keys;
+  tablevalue *oldValues   = t->values;
+
+  allocSlots(t, oldCap * 2);
+  for (uint32_t i = 0; i < oldCap; i++){
+    if (oldHashes[i] == EMPTY) continue;
+    insertSlot(t, oldHashes[i], oldKeys + (size_t)i * t->keyBytes, oldValues[i]);
+  }
+  free(oldHashes);
+  free(oldKeys);
+  free(oldValues);
+}
+
+void tableSet(table t, const void *key, tablevalue v){
+  uint32_t h = hashKey(t, key);
+  int64_t i = findSlot(t, key, h);
+  if (i >= 0){
+    if (t->f != NULL && t->values[i] != v) t->f(t->values[i]);
+    t->values[i] = v;
+    return;
+  }
+
+  if ((uint64_t)(t->members + 1) * MAX_LOAD_DEN > (uint64_t)t->cap * MAX_LOAD_NUM){
+    grow(t);
+  }
+  if (t->type == TABLE_KEY_STRING){
+    char *copy = strdup(key);
+    assert(copy != NULL);
+    insertSlot(t, h, (unsigned char *)&copy, v);
+  } else {
+    insertSlot(t, h, key, v);
+  }
+  t->members++;
+}
+
+bool tablePresent(table t, const void *key, tablevalue *v){
+  int64_t i = findSlot(t, key, hashKey(t, key));
+  if (i < 0) return false;
+  *v = t->values[i];
+  return true;
+}
+
+tablevalue tableFind(table t, const void *key){
+  int64_t i = findSlot(t, key, hashKey(t, key));
+  return i < 0 ? NULL : t->values[i];
+}
+
+tablevalue tableRemove(table t, const void *key){
+  int64_t found = findSlot(t, key, hashKey(t, key));
+  if (found < 0) return NULL;
+
+  uint32_t i = (uint32_t)found;
+  tablevalue v = t->values[i];
+  if (t->type == TABLE_KEY_STRING) free(*(char **)slotKey(t, i));
+
+  // shift the following entries back a slot until one is already home
+  uint32_t next = (i + 1) & t->mask;
+  while (t->hashes[next] != EMPTY && distance(t, t->hashes[next], next) > 0){
+    t->hashes[i] = t->hashes[next];
+    memcpy(slotKey(t, i), slotKey(t, next), t->keyBytes);
+    t->values[i] = t->values[next];
+    i    = next;
+    next = (next + 1) & t->mask;
+  }
+  t->hashes[i] = EMPTY;
+  t->members--;
+  return v;
+}
+
+int tableMembers(table t){
+  return (int)t->members;
+}
+
+tableiter tableIterate(table t){
+  tableiter it = { t, 0 };
+  return it;
+}
+
+bool tableNext(tableiter *it, const void **key, tablevalue *v){
+  table t = it->t;
+  while (it->next < t->cap){
+    uint32_t i = it->next++;
+    if (t->hashes[i] == EMPTY) continue;
+    if (key != NULL) *key = userKey(t, i);
+    if (v != NULL) *v = t->values[i];
+    return true;
+  }
+  return false;
+}
+
+void tableForeach(table t, tableforeachcb cb, void *arg){
+  tableiter it = tableIterate(t);
+  const void *key;
+  tablevalue v;
+  while (tableNext(&it, &key, &v)){
+    cb(key, v, arg);
+  }
+}
+
+void tableMetrics(table t, int *min, int *max, double *avg){
+  long total = 0;
+  *min = 0;
+  *max = 0;
+  for (uint32_t i = 0; i < t->cap; i++){
+    if (t->hashes[i] == EMPTY) continue;
+    int probes = (int)distance(t, t->hashes[i], i) + 1;
+    if (total == 0 || probes < *min) *min = probes;
+    if (probes > *max) *max = probes;
+    total += probes;
+  }
+  *avg = t->members > 0 ? (double)total / t->members : 0.0;
+}
@@ -0,0 +1,59 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * table.h: generic hash table with pluggable key types.
+ *  Robin Hood open addressing over a power-of-two array: entries that
+ *  are further from their home slot win the slot, which keeps probe
+ *  lengths short and even, and removal shifts the following entries
+ *  back instead of leaving tombstones. The table grows when it is 7/8
+ *  full. Each slot keeps a 32 bit hash beside the key so most probes
+ *  never touch the key itself.
+ *
+ *  Keys are always passed by address:
+ *   TABLE_KEY_INT    - const int64_t *
+ *   TABLE_KEY_BYTES  - pointer to keyBytes bytes, compared with memcmp
+ *   TABLE_KEY_STRING - const char *, the table keeps its own copy
+ */
+
+typedef enum { TABLE_KEY_INT, TABLE_KEY_BYTES, TABLE_KEY_STRING } tablekeytype;
+
+typedef struct table *table;
+typedef void *tablevalue;
+
+typedef void (*tablefreefunc)( tablevalue );
+// key is the string itself for TABLE_KEY_STRING, else the stored bytes
+typedef void (*tableforeachcb)( const void *key, tablevalue, void * );
+
+// walks the slots in order, no recursion and no allocation
+typedef struct {
+  table t;
+  uint32_t next;
+} tableiter;
+
+// keyBytes is only used by TABLE_KEY_BYTES, f may be NULL
+extern table tableCreate( tablekeytype type, size_t keyBytes, tablefreefunc f );
+extern void tableFree( table t );
+// frees every value but keeps the slot array
+extern void tableEmpty( table t );
+// replaces (and frees) any existing value
+extern void tableSet( table t, const void *key, tablevalue v );
+// like tableFind, but tells a stored NULL apart from a missing key
+extern bool tablePresent( table t, const void *key, tablevalue *v );
+extern tablevalue tableFind( table t, const void *key );
+// unlinks key and hands the value back without freeing it
+extern tablevalue tableRemove( table t, const void *key );
+extern int tableMembers( table t );
+// the table must not be changed while iterating
+extern tableiter tableIterate( table t );
+extern bool tableNext( tableiter *it, const void **key, tablevalue *v );
+extern void tableForeach( table t, tableforeachcb cb, void *arg );
+// probe length of every entry, 1 means it sits in its home slot
+extern void tableMetrics( table t, int *min, int *max, double *avg );
+
+#endif
@@ -3,6 +3,7 @@ import struct
 import mediapipe as mp
 import socket
 import math
+import time
 
 sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 WSL_IP = "172.26.95.134" 
@@ -10,6 +11,13 @@ PORT = 5005
 
 KEYS = [1, 2, 33, 263, 70, 300, 13, 14, 152]
 
+# version 1 of the datagram, see tracking/faceproto.h: magic, version,
+# flags, landmark count, sequence, reserved, capture and send times in ns
+HEADER = struct.Struct('<IBBHIIQQ')
+MAGIC = 0x4b525446
+VERSION = 1
+sequence = 0
+
 mp_face = mp.solutions.face_mesh
 cap = cv2.VideoCapture(0)
 
@@ -17,6 +25,7 @@ with mp_face.FaceMesh(refine_landmarks=True) as face_mesh:
   while cap.isOpened():
     ret, frame = cap.read()
     if not ret: break
+    captured = time.monotonic_ns()
 
     rgb = cv2.cvtColor(frame, cv2.COLOR_BGR2RGB)
     result = face_mesh.process(rgb)
@@ -41,5 +50,8 @@ with mp_face.FaceMesh(refine_landmarks=True) as face_mesh:
         # msg = f"{yaw:.4f},{pitch:.4f}"
         print(yaw, pitch)
 
-        data = struct.pack(f'{len(floats)}f', *floats)
-        sock.sendto(data, (WSL_IP, PORT))
+        data = struct.pack(f'<{len(floats)}f', *floats)
+        header = HEADER.pack(MAGIC, VERSION, 0, len(KEYS), sequence & 0xffffffff, 0,
+                             captured, time.monotonic_ns())
+        sock.sendto(header + data, (WSL_IP, PORT))
+        sequence += 1
@@ -18,8 +18,12 @@
 #include "utils/perlin.h"
 
 #include "utils/texture.h"
-
-#include <arpa/inet.h>
+#include "utils/frameclock.h"
+#include "utils/jobs.h"
+#include "utils/session.h"
+#include "tracking/facerecv.h"
+#include "tracking/faceshm.h"
+#include "tracking/posefilter.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height){
   glViewport(0, 0, width, height);
@@ -33,24 +37,21 @@ void checkOpenGLError(const char* context) {
   }
 }
 
-void sleepSeconds(double seconds) {
-  #ifdef _WIN32
-      Sleep((DWORD)(seconds * 1000));
-  #else
-      struct timespec ts;
-      ts.tv_sec = (time_t)seconds;
-      ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
-      nanosleep(&ts, NULL);
-  #endif
-}
-
 static bool firstMouse = true;
 static double lastX = SCREEN_WIDTH / 2.0;
 static double lastY = SCREEN_HEIGHT / 2.0;
 static camera cam; // required for mouseCallback
+// where mouseCallback leaves cursor samples, NULL while replaying
+static sessionInput *cursorInput;
 
 
 void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
+  if (cursorInput != NULL) sessionAddCursor(cursorInput, xpos, ypos);
+}
+
+// cursor samples turn the camera when the frame's input is handled, so a
+// replay turns it the same way
+static void turnCamera(double xpos, double ypos) {
   if (firstMouse) {
     lastX = xpos;
     lastY = ypos;
@@ -82,43 +83,6 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
   setPitch(cam, pitch);
 }
 
-typedef struct { float x, y, z; } Point3D;
-#define MAX_LANDMARKS 32
-
-bool getFaceData(Point3D* outPoints, int* outCount, float* yaw, float* pitch) {
-  static int sockfd = -1;
-  static struct sockaddr_in addr;
-
-  if (sockfd < 0) {
-      sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-      addr.sin_family = AF_INET;
-      addr.sin_port = htons(5005);
-      addr.sin_addr.s_addr = INADDR_ANY;
-      bind(sockfd, (struct sockaddr*)&addr, sizeof(addr));
-  }
-
-  char buffer[512];
-  ssize_t len = recv(sockfd, buffer, sizeof(buffer), MSG_DONTWAIT);
-  if (len <= 0) return false;
-
-  int floatCount = len / sizeof(float);
-  if (floatCount < 2) return false;
-
-  float* floats = (float*)buffer;
-  int landmarkCount = (floatCount - 2) / 3;
-
-  if (landmarkCount > MAX_LANDMARKS) landmarkCount = MAX_LANDMARKS;
-
-  for (int i = 0; i < landmarkCount; ++i) {
-      outPoints[i] = (Point3D){ floats[i * 3 + 0], floats[i * 3 + 1], floats[i * 3 + 2] };
-  }
-
-  *yaw = floats[landmarkCount * 3];
-  *pitch = floats[landmarkCount * 3 + 1];
-  *outCount = landmarkCount;
-  return true;
-}
-
 void initFBO(int width, int height, GLuint *fbo, GLuint *fboTex, GLuint *fboDepth) {
   glGenFramebuffers(1, fbo);
   glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
@@ -145,8 +109,264 @@ void initFBO(int width, int height, GLuint *fbo, GLuint *fboTex, GLuint *fboDept
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+// what one frame's jobs share. Each field is written by one job and
+// only read by the jobs that run after it
+typedef struct {
+  GLFWwindow *window;
+  world game;
+  frameclock clock;
+  int steps;            // simulation steps this frame
+  // everything the simulation is fed this frame, read back when replaying
+  sessionInput input;
+  bool replaying;
+  // face tracking
+  facereceiver tracker;
+  posefilter headFilter;
+  facePose face;        // the last pose read, in screen space
+  bool haveFace;
+  // the body, and where the views are from
+  vec3 velocity;
+  vec3 previousPos;     // before the last step, drawn part way to where it is now
+  vec3 eyePos, reflectionPos;
+  mat4 view, reflectionView, proj;
+  // GL objects
+  GLuint program, waterShader, skyShader, fireflyShader, faceShader, facyShader;
+  GLuint texture, dudvTexture, normalTexture;
+  GLuint skyVAO, fireflyVAO, faceVAO, faceVBO, screenVAO;
+  GLuint fbo, fboTex, dubFbo, dubTex;
+  vec3 lightPos;
+} frame;
+
+// GLFW only hands out events and key states on the main thread
+static void inputJob(void *arg){
+  frame *f = arg;
+  glfwPollEvents();
+  if (!f->replaying) {
+    static const struct { int key; uint8_t bit; } keys[] = {
+      { GLFW_KEY_W, SESSION_KEY_FORWARD }, { GLFW_KEY_S, SESSION_KEY_BACK },
+      { GLFW_KEY_A, SESSION_KEY_LEFT }, { GLFW_KEY_D, SESSION_KEY_RIGHT },
+      { GLFW_KEY_SPACE, SESSION_KEY_JUMP },
+    };
+    f->input.keys = 0;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+      if (glfwGetKey(f->window, keys[i].key) == GLFW_PRESS) f->input.keys |= keys[i].bit;
+    }
+  }
+  for (int i = 0; i < f->input.cursorCount; i++) {
+    turnCamera(f->input.cursor[i].x, f->input.cursor[i].y);
+  }
+}
+
+// the head pose, carried forward to when this frame will be shown
+static void faceJob(void *arg){
+  frame *f = arg;
+  if (!f->replaying) {
+    f->input.hasFace = f->tracker != NULL && faceReceiverLatest(f->tracker, &f->input.face);
+    f->input.faceNow = faceClockSeconds();
+  }
+  if (f->input.hasFace) {
+    f->haveFace = true;
+    poseFilterAdd(f->headFilter, &f->input.face);
+    f->face = f->input.face;
+    for (int i = 0; i < f->face.count; ++i) {
+      Point3D p = f->face.points[i];
+      p.x = p.x * 2.0f - 1.0f;
+      p.y = 1.0f - p.y * 2.0f;
+      p.z = 0.0f;
+      f->face.points[i] = p;
+    }
+  }
+  float headYaw, headPitch;
+  if (poseFilterPredict(f->headFilter, f->input.faceNow, &headYaw, &headPitch)) {
+    setYaw(cam, headYaw * 180.0f / 3.14159f);
+    setPitch(cam, headPitch * 180.0f / 3.14159f);
+  }
+}
+
+static void faceUploadJob(void *arg){
+  frame *f = arg;
+  if (!f->input.hasFace) return;
+  glBindBuffer(GL_ARRAY_BUFFER, f->faceVBO);
+  glBufferData(GL_ARRAY_BUFFER, f->face.count * sizeof(Point3D), f->face.points, GL_DYNAMIC_DRAW);
+}
+
+static void simulateJob(void *arg){
+  frame *f = arg;
+  vec3 up = vec3Make(0.0f, 1.0f, 0.0f);
+  vec3 front = frontVector(getYaw(cam), getPitch(cam));
+  vec3 right = vec3Normalise(vec3Cross(front, up));
+  vec3 flatFront = vec3Normalise(vec3Make(front.x, 0.0f, front.z));
+
+  // the keys held this frame drive every step it runs. Gravity and the
+  // jump are tuned per step, so they now feel the same at any frame rate
+  for (int step = 0; step < f->steps; step++) {
+    f->previousPos = *getPosition(cam);
+
+    f->velocity.y -= 4.81f;
+    f->velocity.x = 0.0f;
+    f->velocity.z = 0.0f; 
+
+    float speed = 4.5f;
+
+    uint8_t keys = f->input.keys;
+    if (keys & SESSION_KEY_FORWARD) f->velocity = vec3Add(f->velocity, vec3Scale(flatFront, speed));
+    if (keys & SESSION_KEY_BACK)    f->velocity = vec3Add(f->velocity, vec3Scale(flatFront, -speed));
+    if (keys & SESSION_KEY_LEFT)    f->velocity = vec3Add(f->velocity, vec3Scale(right, -speed));
+    if (keys & SESSION_KEY_RIGHT)   f->velocity = vec3Add(f->velocity, vec3Scale(right, speed));
+
+    bool grounded = false;
+    centreWorld(f->game, getPosition(cam));
+    physics(f->game, cam, &f->velocity, &grounded, (float) SIM_STEP);
+
+    if (grounded){
+      f->velocity.y = 0.0f;
+      if (keys & SESSION_KEY_JUMP) f->velocity.y = 40.0f;
+    }
+  }
+
+  float eye_offset = 1.61f;
+  float forward_offset = 0.5f;  // tweak this to avoid clipping
+
+  // player base position, between the last two steps; where it looks
+  // is not interpolated, the newest mouse and head input wins
+  vec3 camPos = vec3Lerp(f->previousPos, *getPosition(cam), frameClockAlpha(f->clock));
+
+  f->eyePos = vec3Make(
+      camPos.x + front.x * forward_offset,
+      camPos.y + eye_offset,
+      camPos.z + front.z * forward_offset);
+  f->view = mat4LookAt(f->eyePos, vec3Add(f->eyePos, front), up);
+
+  // the reflection looks up from as far under the water as the eye is above it
+  float distance = 2 * (f->eyePos.y - 3.0f);
+  f->reflectionPos = vec3Make(f->eyePos.x, f->eyePos.y - distance, f->eyePos.z);
+  vec3 reflectionFront = frontVector(getYaw(cam), -getPitch(cam));
+  f->reflectionView = mat4LookAt(f->reflectionPos, vec3Add(f->reflectionPos, reflectionFront), up);
+}
+
+static void cullMainJob(void *arg){
+  frame *f = arg;
+  cullWorld(f->game, RENDER_PASS_MAIN, f->eyePos, &f->view, &f->proj);
+}
+
+static void cullReflectionJob(void *arg){
+  frame *f = arg;
+  cullWorld(f->game, RENDER_PASS_REFLECTION, f->reflectionPos, &f->reflectionView, &f->proj);
+}
+
+static void drawJob(void *arg){
+  frame *f = arg;
+
+  // Rendering
+  // Face screen 
+  glBindFramebuffer(GL_FRAMEBUFFER, f->fbo);
+  glViewport(0, 0, 256, 256);
+  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // render to the fbo, the last pose stays up until a newer one arrives
+  if (f->haveFace) {
+    glBindVertexArray(f->faceVAO);
+    glUseProgram(f->facyShader);
+    glPointSize(10.0f);
+    glDrawArrays(GL_POINTS, 0, f->face.count);
+    glPointSize(1.0f);
+    glBindVertexArray(0);
+  }
+
+  // reset stuff
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+  // Main screen 
+  // Clear screen 
+  glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Render the background
+  glDepthMask(GL_FALSE);
+  glUseProgram(f->skyShader); 
+  glBindVertexArray(f->skyVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glDepthMask(GL_TRUE);
+
+  vec3 viewPos = f->eyePos;
+  float currTime = glfwGetTime();
+
+  // fake screen 
+  glBindFramebuffer(GL_FRAMEBUFFER, f->dubFbo);
+  glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // render background to fake screen 
+  glDepthMask(GL_FALSE);
+  glUseProgram(f->skyShader); 
+  glBindVertexArray(f->skyVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glDepthMask(GL_TRUE);
+  // render world to fake screen 
+  drawWorld(f->game, RENDER_PASS_REFLECTION, f->program, f->waterShader, &f->reflectionView, &f->proj,
+            &f->lightPos, &viewPos, currTime, f->texture, f->dubTex, f->dudvTexture, f->normalTexture);
+  // reset to normal frame buffer
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+  // render the world
+  drawWorld(f->game, RENDER_PASS_MAIN, f->program, f->waterShader, &f->view, &f->proj,
+            &f->lightPos, &viewPos, currTime, f->texture, f->dubTex, f->dudvTexture, f->normalTexture);
+
+  // render the ui 
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDepthMask(GL_FALSE);
+  glUseProgram(f->fireflyShader); 
+  glBindVertexArray(f->fireflyVAO);
+
+  glUniform1f(glGetUniformLocation(f->fireflyShader, "time"), glfwGetTime());
+  glUniformMatrix4fv(glGetUniformLocation(f->fireflyShader, "matProj"), 1, GL_TRUE, (float*)f->proj.m);
+  glUniformMatrix4fv(glGetUniformLocation(f->fireflyShader, "view"), 1, GL_TRUE, (float*)f->view.m);
+  glUniform3f(glGetUniformLocation(f->fireflyShader, "cameraWorldPos"), f->eyePos.x, f->eyePos.y, f->eyePos.z);
+
+  int fireflyCount = 400;
+  int tiles = (2 * 5 + 1) * (2 * 5 + 1);
+  glPointSize(2.0f);
+  glDrawArrays(GL_POINTS, 0, fireflyCount * tiles);
+  glPointSize(1.0f);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
+
+  glUseProgram(f->faceShader);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, f->fboTex);
+  glUniform1i(glGetUniformLocation(f->faceShader, "screenTex"), 0);
+
+  glBindVertexArray(f->screenVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+
+  checkOpenGLError("In loop");
+
+  endWorldFrame(f->game);
+}
+
+int main(int argc, char **argv){
+  // a session is recorded to or replayed from a file
+  const char *recordPath = NULL, *replayPath = NULL;
+  bool badArgs = false;
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+    else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replayPath = argv[++i];
+    else badArgs = true;
+  }
+  if (badArgs || (recordPath != NULL && replayPath != NULL)){
+    fprintf(stderr, "usage: %s [--record file | --replay file]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  session replay = NULL;
+  if (replayPath != NULL){
+    replay = replaySession(replayPath, SIM_STEP, MAX_SIM_STEPS);
+    if (replay == NULL) return EXIT_FAILURE;
+  }
 
-int main(){
   if (!glfwInit()){
     fprintf(stderr, "Failed to initilaise GLFW window");
     exit(1);
@@ -200,17 +420,13 @@ int main(){
   float fFovRad      = 1.0f / tanf(fFov * 0.5f / 180.0f * 3.14159f);
 
   // create the projection matrix
-  mat4x4 matProj = constructMat4x4(0.0f);
-  matProj->m[0][0] = fAspectRatio * fFovRad;
-  matProj->m[1][1] = fFovRad;
-  matProj->m[2][2] = -(fFar + fNear) / (fFar - fNear);
-  matProj->m[3][2] = -1.0f;
-  matProj->m[2][3] = -(2.0f * fFar * fNear) / (fFar - fNear);
-  matProj->m[3][3] = 0.0f;
-
-  float angle = 0.0f;
-  mat4x4 view = constructRotationY(angle);
-  view->m[2][3] = -16.0f;
+  mat4 matProj = {{{ 0.0f }}};
+  matProj.m[0][0] = fAspectRatio * fFovRad;
+  matProj.m[1][1] = fFovRad;
+  matProj.m[2][2] = -(fFar + fNear) / (fFar - fNear);
+  matProj.m[3][2] = -1.0f;
+  matProj.m[2][3] = -(2.0f * fFar * fNear) / (fFar - fNear);
+  matProj.m[3][3] = 0.0f;
 
   // load textures 
   GLuint texture = loadTexture("texture/tile.png", 64, 16, 3);
@@ -219,7 +435,7 @@ int main(){
 
   glEnable(GL_DEPTH_TEST);
 
-  glfwSwapInterval(1);
+  glfwSwapInterval(VSYNC);
 
   checkOpenGLError("depth error stuff");
 
@@ -302,7 +518,7 @@ int main(){
 
   glBindVertexArray(faceVAO);
   glBindBuffer(GL_ARRAY_BUFFER, faceVBO);
-  glBufferData(GL_ARRAY_BUFFER, MAX_LANDMARKS * sizeof(Point3D), NULL, GL_DYNAMIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, FACE_MAX_POINTS * sizeof(Point3D), NULL, GL_DYNAMIC_DRAW);
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Point3D), (void*)0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -321,15 +537,23 @@ int main(){
   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
   glEnableVertexAttribArray(1);
 
-  // create world
-  world game = createWorld(16, 16);
+  // create world. A session starts from a freshly generated one and
+  // never evicts chunks, so its replay does not depend on what was saved
+  // or drawn
+  bool inSession = recordPath != NULL || replayPath != NULL;
+  unsigned seed = replay != NULL ? sessionSeed(replay) : (unsigned)time(NULL);
+  setChunkSeed(seed);
+  world game = createWorld(16, 16, inSession ? NULL : WORLD_SAVE_DIR);
+  if (!inSession) setWorldMemoryBudget(game, CHUNK_MEMORY_BUDGET);
+  setWorldColdAfter(game, COLD_CHUNK_FRAMES);
+  setWorldOcclusion(game, OCCLUSION_WORKERS, OCCLUSION_BUDGET);
+
+  // shared memory when the tracker runs here, UDP otherwise
+  facereceiver tracker = replay != NULL ? NULL : createFaceReceiver(SOCK_ADD, FACE_SHM_NAME);
+  posefilter headFilter = createPoseFilter(HEAD_MIN_CUTOFF, HEAD_BETA, HEAD_MAX_LEAD);
   
   // camera stuff
   cam = constructCamera(65.7f, 23.0f, 32.3f);
-  vec3d front = getFrontVector(getYaw(cam), getPitch(cam));
-  vec3d up = constructVec3d(0.0f, 1.0f, 0.0f);
-  vec3d right = cross(front, up);
-  normalise(right);
 
   initPerlin();
 
@@ -339,223 +563,143 @@ int main(){
   }
   glfwSetCursorPosCallback(window, mouseCallback);
 
-  double targetFPS = 60.0;
-  double frameTime = 1.0 / targetFPS;
-  double lastFrameTime = glfwGetTime();
+  double startTime     = replay != NULL ? sessionStart(replay) : glfwGetTime();
+  double lastSaveTime  = startTime;
+  double lastStatsTime = startTime;
+  frameclock frames = createFrameClock(SIM_STEP, MAX_SIM_STEPS, startTime);
+  session record = NULL;
+  if (recordPath != NULL){
+    record = recordSession(recordPath, seed, startTime, SIM_STEP, MAX_SIM_STEPS);
+    if (record == NULL) glfwSetWindowShouldClose(window, GLFW_TRUE);
+  }
 
-  vec3d lightPos = constructVec3d(100.0f, 100.0f, 100.0f);
-  vec3d viewPos = constructVec3d(0.0f, 0.0f, 0.0f);
+  frame f = {
+    .window = window, .game = game, .clock = frames, .replaying = replay != NULL,
+    .tracker = tracker, .headFilter = headFilter, .haveFace = false,
+    .velocity = vec3Make(0.0f, 0.0f, 0.0f), .previousPos = *getPosition(cam),
+    .proj = matProj,
+    .program = program, .waterShader = waterShader, .skyShader = skyShader,
+    .fireflyShader = fireflyShader, .faceShader = faceShader, .facyShader = facyShader,
+    .texture = texture, .dudvTexture = dudvTexture, .normalTexture = normalTexture,
+    .skyVAO = skyVAO, .fireflyVAO = fireflyVAO, .faceVAO = faceVAO, .faceVBO = faceVBO,
+    .screenVAO = screenVAO, .fbo = fbo, .fboTex = fboTex, .dubFbo = dubFbo, .dubTex = dubTex,
+    .lightPos = vec3Make(100.0f, 100.0f, 100.0f),
+  };
 
-  vec3d velocity = constructVec3d(0.0f, 0.0f, 0.0f);
+  // a frame: input and the face come in, the body moves, both views are
+  // culled side by side, and everything is drawn once they are done
+  jobs frameJobs = createJobs(JOB_WORKERS);
+  int input      = jobsAdd(frameJobs, "input", &inputJob, &f, true);
+  int face       = jobsAdd(frameJobs, "face", &faceJob, &f, false);
+  int faceUpload = jobsAdd(frameJobs, "face upload", &faceUploadJob, &f, true);
+  int simulate   = jobsAdd(frameJobs, "simulate", &simulateJob, &f, false);
+  int cullMain   = jobsAdd(frameJobs, "cull main", &cullMainJob, &f, false);
+  int cullMirror = jobsAdd(frameJobs, "cull reflection", &cullReflectionJob, &f, false);
+  int draw       = jobsAdd(frameJobs, "draw", &drawJob, &f, true);
+  jobsDepend(frameJobs, face, input);         // the mouse and the head both turn the camera
+  jobsDepend(frameJobs, faceUpload, face);
+  jobsDepend(frameJobs, simulate, face);
+  jobsDepend(frameJobs, cullMain, simulate);
+  jobsDepend(frameJobs, cullMirror, simulate);
+  jobsDepend(frameJobs, draw, faceUpload);
+  jobsDepend(frameJobs, draw, cullMain);
+  jobsDepend(frameJobs, draw, cullMirror);
+
+  cursorInput = replay != NULL ? NULL : &f.input;
 
   glEnable(GL_FRAMEBUFFER_SRGB);
 
+  int sessionFrames = 0;
+  double sessionStarted = glfwGetTime();
+
   // GAME loop
   while (!glfwWindowShouldClose(window)) {
-    double now = glfwGetTime();
-    double deltaTime = now - lastFrameTime;
-
-    if (deltaTime < frameTime) {
-        // Sleep remaining time to avoid busy wait
-        sleepSeconds(frameTime - deltaTime);
-        continue;
-    }
-
-    lastFrameTime = now;
-
-    glfwPollEvents();
-    free(front);
-    front = getFrontVector(getYaw(cam), getPitch(cam));
-    free(right);
-    right = cross(front, up);
-    normalise(right);
-
-    vec3d flatFront = constructVec3d(front->x, 0.0f, front->z);
-    normalise(flatFront);
-
-    float cameraSpeed = 5.0f * (float)deltaTime;
-
-    velocity->y -= 4.81f;
-    velocity->x = 0.0f;
-    velocity->z = 0.0f; 
-
-    float speed = 4.5f;
-
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-      vec3d forwardStep = multiply(flatFront, speed);
-      velocity = add(velocity, forwardStep);
-      // setPosition(cam, add(getPosition(cam), multiply(front, cameraSpeed)));
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-      vec3d backStep = multiply(flatFront, -speed);
-      velocity = add(velocity, backStep);
-      // setPosition(cam, subtract(getPosition(cam), multiply(front, cameraSpeed)));
-    }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-      vec3d leftStep = multiply(right, -speed);
-      velocity = add(velocity, leftStep);
-      // setPosition(cam, subtract(getPosition(cam), multiply(right, cameraSpeed)));
+    if (replay != NULL) {
+      if (!sessionNextInput(replay, &f.input)) break;
+    } else {
+      f.input.now = glfwGetTime();
+      f.input.cursorCount = 0;
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-      vec3d rightStep = multiply(right, speed);
-      velocity = add(velocity, rightStep);
-      // setPosition(cam, add(getPosition(cam), multiply(right, cameraSpeed)));
+    double now = f.input.now;
+    f.steps = frameClockAdvance(frames, now);
+
+    jobsRun(frameJobs);
+
+    if (now - lastSaveTime > AUTOSAVE_INTERVAL && saveWorldAsync(game)){
+      lastSaveTime = now;
+      saveStats stats = getWorldSaveStats(game);
+      printf("Autosave: snapshot of %d chunks took %.3f ms, %lu bytes copied on write so far\n",
+             stats.lastSnapshotChunks, stats.lastSnapshotSeconds * 1000.0, stats.copiedBytes);
+      chunkTierStats tier = getChunkTierStats();
+      printf("Cold chunks: %d (%ld bytes saved), %lu compressed, %lu thawed, "
+             "%lu incompressible, %lu bytes copied on write\n",
+             tier.coldChunks, tier.bytesSaved, tier.compressions, tier.decompressions,
+             tier.incompressible, tier.copiedBytes);
     }
 
-    // velocity->y -= 9.81f;
-
-    bool grounded = false;
-    physics(game, cam, velocity, &grounded, (float) deltaTime);
-
-    if (grounded){
-      velocity->y = 0.0f;
-      if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS){
-        velocity->y = 40.0f;
+    if (now - lastStatsTime > RENDER_STATS_INTERVAL){
+      lastStatsTime = now;
+      frameStats frame = getFrameStats(frames);
+      printf("Frames: %.1f/s, %.2f ms mean, %.2f median, %.2f p95, %.2f p99, %.2f max; "
+             "steps a frame 0: %d, 1: %d, 2: %d, more: %d; %.3f s dropped\n",
+             frame.rate, frame.mean * 1000.0, frame.median * 1000.0, frame.p95 * 1000.0,
+             frame.p99 * 1000.0, frame.max * 1000.0, frame.steps[0], frame.steps[1],
+             frame.steps[2], frame.steps[3], frame.dropped);
+      passStats mainPass = getWorldPassStats(game, RENDER_PASS_MAIN);
+      passStats reflectionPass = getWorldPassStats(game, RENDER_PASS_REFLECTION);
+      printf("Chunks: main drew %d, culled %d, unreachable %d, occluded %d; "
+             "reflection drew %d, culled %d, unreachable %d, occluded %d\n",
+             mainPass.drawn, mainPass.culled, mainPass.unreachable, mainPass.occluded,
+             reflectionPass.drawn, reflectionPass.culled, reflectionPass.unreachable, reflectionPass.occluded);
+      jobStats timings = getJobStats(frameJobs);
+      printf("Jobs: %d threads, %.2f ms a frame (max %.2f), %lu stolen;",
+             timings.threads, timings.mean * 1000.0, timings.max * 1000.0, timings.steals);
+      for (int i = 0; i < timings.count; i++){
+        printf(" %s %.2f ms (max %.2f) on %d%s", timings.jobs[i].name, timings.jobs[i].mean * 1000.0,
+               timings.jobs[i].max * 1000.0, timings.jobs[i].thread, i + 1 < timings.count ? "," : "\n");
       }
-    }
-
-    float eye_offset = 1.61f;
-    float forward_offset = 0.5f;  // tweak this to avoid clipping
-
-    vec3d camPos = getPosition(cam);  // player base position
-    vec3d camForward = getFrontVector(getYaw(cam), getPitch(cam));
-    normalise(camForward);
-
-    vec3d eyePos = constructVec3d(
-        camPos->x + camForward->x * forward_offset,
-        camPos->y + eye_offset,
-        camPos->z + camForward->z * forward_offset);
-
-    view = lookAt(eyePos, add(eyePos, camForward), up);
-
-
-
-    // Rendering
-    // Face screen 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, 256, 256);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // render to the fbo
-    Point3D facePoints[MAX_LANDMARKS];
-    int facePointCount = 0;
-    float yaw = 0.0f, pitch = 0.0f;
-
-    if (getFaceData(facePoints, &facePointCount, &yaw, &pitch)) {
-      for (int i = 0; i < facePointCount; ++i) {
-        Point3D p = facePoints[i];
-        p.x = p.x * 2.0f - 1.0f;
-        p.y = 1.0f - p.y * 2.0f;
-        p.z = 0.0f;
-        facePoints[i] = p;
+      if (tracker != NULL){
+        faceRecvStats face = getFaceReceiverStats(tracker);
+        printf("Face (%s): %.1f poses/s, age %.2f ms (max %.2f), %lu superseded, %lu invalid, "
+               "%lu late, %lu lost, %lu dropped by the kernel\n",
+               face.shared ? "shared memory" : "UDP", face.rate, face.age * 1000.0, face.maxAge * 1000.0,
+               face.superseded, face.invalid, face.late, face.lost, face.kernelDropped);
+        poseFilterStats head = getPoseFilterStats(headFilter);
+        printf("Head: pose to screen %.1f ms (max %.1f), %.1f ms of it predicted, jitter %.3f deg\n",
+               head.latency * 1000.0, head.maxLatency * 1000.0, head.lead * 1000.0, head.jitter);
       }
-
-      glBindBuffer(GL_ARRAY_BUFFER, faceVBO);
-      glBufferData(GL_ARRAY_BUFFER, facePointCount * sizeof(Point3D), facePoints, GL_DYNAMIC_DRAW);
-      setYaw(cam, yaw * 180.0f / 3.14159f);
-      setPitch(cam, pitch * 180.0f / 3.14159f);
-
-      glBindVertexArray(faceVAO);
-      glUseProgram(facyShader);
-      glPointSize(10.0f);
-      glDrawArrays(GL_POINTS, 0, facePointCount);
-      glPointSize(1.0f);
-      glBindVertexArray(0);
     }
 
-    // reset stuff
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-
-    // Main screen 
-    // Clear screen 
-    glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Render the background
-    glDepthMask(GL_FALSE);
-    glUseProgram(skyShader); 
-    glBindVertexArray(skyVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glDepthMask(GL_TRUE);
-
-    // update view matrix
-    viewPos->x = eyePos->x;
-    viewPos->y = eyePos->y;
-    viewPos->z = eyePos->z;
-
-    float currTime = glfwGetTime();
-
-    // fake screen 
-    glBindFramebuffer(GL_FRAMEBUFFER, dubFbo);
-    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    // render background to fake screen 
-    glDepthMask(GL_FALSE);
-    glUseProgram(skyShader); 
-    glBindVertexArray(skyVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glDepthMask(GL_TRUE);
-    // render world to fake screen 
-    float distance = 2 * (eyePos->y - 3.0f);
-    vec3d distancePos = constructVec3d(eyePos->x, eyePos->y - distance, eyePos->z);
-    setPitch(cam, -getPitch(cam));
-    vec3d newUp = constructVec3d(0.0f, 1.0f, 0.0f);
-    view = lookAt(distancePos, add(distancePos, getFrontVector(getYaw(cam), getPitch(cam))), newUp);
-    renderWorld(game, distancePos, program, waterShader, view, matProj, lightPos, viewPos, currTime, texture, true, dubTex, dudvTexture, normalTexture);
-    setPitch(cam, -getPitch(cam));
-    // reset to normal frame buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-    view = lookAt(eyePos, add(eyePos, front), up);
-
-    // render the world
-    renderWorld(game, eyePos, program, waterShader, view, matProj, lightPos, viewPos, currTime, texture, false, dubTex, dudvTexture, normalTexture);
-
-    // render the ui 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDepthMask(GL_FALSE);
-    glUseProgram(fireflyShader); 
-    glBindVertexArray(fireflyVAO);
-
-    glUniform1f(glGetUniformLocation(fireflyShader, "time"), glfwGetTime());
-    glUniformMatrix4fv(glGetUniformLocation(fireflyShader, "matProj"), 1, GL_TRUE, (float*)matProj->m);
-    glUniformMatrix4fv(glGetUniformLocation(fireflyShader, "view"), 1, GL_TRUE, (float*)view->m);
-    glUniform3f(glGetUniformLocation(fireflyShader, "cameraWorldPos"), eyePos->x, eyePos->y, eyePos->z);
-
-    int fireflyCount = 400;
-    int tiles = (2 * 5 + 1) * (2 * 5 + 1);
-    glPointSize(2.0f);
-    glDrawArrays(GL_POINTS, 0, fireflyCount * tiles);
-    glPointSize(1.0f);
-    glDepthMask(GL_TRUE);
-    glDisable(GL_BLEND);
-
-    glUseProgram(faceShader);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, fboTex);
-    glUniform1i(glGetUniformLocation(faceShader, "screenTex"), 0);
-
-    glBindVertexArray(screenVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    checkOpenGLError("In loop");
-
     glfwSwapBuffers(window);
+    if (replay == NULL) f.input.shownAt = faceClockSeconds();
+    poseFilterShown(headFilter, f.input.shownAt);
+
+    session s = replay != NULL ? replay : record;
+    if (s != NULL) {
+      sessionBody body = { *getPosition(cam), f.velocity, getYaw(cam), getPitch(cam) };
+      sessionEndFrame(s, &f.input, &body);
+      sessionFrames++;
+    }
+  }
+
+  int status = EXIT_SUCCESS;
+  if (replay != NULL || record != NULL) {
+    double took = glfwGetTime() - sessionStarted;
+    printf("Session: %d frames in %.2f s, %.2f ms a frame\n",
+           sessionFrames, took, sessionFrames > 0 ? took / sessionFrames * 1000.0 : 0.0);
+    if (!closeSession(replay != NULL ? replay : record, worldChecksum(game))) status = EXIT_FAILURE;
   }
 
 
+  freeJobs(frameJobs);
+  if (tracker != NULL) freeFaceReceiver(tracker);
+  freePoseFilter(headFilter);
+  freeFrameClock(frames);
+  reportChunkPool(stdout);
+  saveWorld(game);
   freeWorld(game);
-  free(front);
-  free(up);
-  free(right);
-  free(matProj);
-  free(view);
 
   glfwDestroyWindow(window);
   glfwTerminate();
-  return EXIT_SUCCESS;
+  return status;
 }
\ No newline at end of file
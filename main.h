@@ -9,7 +9,13 @@
 
 #define SENSITIVITY 0.0125
 
+// UDP port face.py sends head poses to
 #define SOCK_ADD 5005
+// head pose smoothing: cutoff in Hz when still, how fast it opens up
+// with speed, and the most seconds a pose is carried forward
+#define HEAD_MIN_CUTOFF 1.0f
+#define HEAD_BETA       20.0f
+#define HEAD_MAX_LEAD   0.05f
 
 #define DEPTH_SIZE 24 
 
@@ -18,8 +24,13 @@
 #define FFAR  1000.0f
 #define FFOV  90.0f
 
-#define TARGET_FPS 60.0
-#define FRAME_TIME 1.0 / TARGET_FPS
+// the simulation steps at a fixed rate whatever the frame rate, and
+// catches up at most MAX_SIM_STEPS a frame after a stall
+#define SIM_RATE      60.0
+#define SIM_STEP      (1.0 / SIM_RATE)
+#define MAX_SIM_STEPS 5
+// 1 waits for the display between frames, 0 draws as fast as it can
+#define VSYNC 1
 
 #define CAM_SPEED 5.0f
 
@@ -32,10 +43,21 @@
 
 #define STB_IMAGE_IMPLEMENTATION
 
-#define MAX_LANDMARKS 32
-
-#define SOCK_RECV_LEN 512
-
-#define NUM_OF_LANDMARKS landmarkCount * 3
+// region files for the world are kept here
+#define WORLD_SAVE_DIR "saves"
+// block + mesh bytes of loaded chunks before the least recently seen are evicted
+#define CHUNK_MEMORY_BUDGET (64 * 1024 * 1024)
+// seconds between background saves of the world
+#define AUTOSAVE_INTERVAL 60.0
+// frames a chunk's blocks go untouched before they are kept compressed
+#define COLD_CHUNK_FRAMES 600
+// threads besides the culling one rasterising occluders, shared by the
+// passes, and the time a pass may spend on it before drawing what it has
+#define OCCLUSION_WORKERS 2
+#define OCCLUSION_BUDGET  0.001
+// threads besides the main one running the non-GL jobs of a frame
+#define JOB_WORKERS 2
+// seconds between printed culling stats
+#define RENDER_STATS_INTERVAL 5.0
 
 #endif
\ No newline at end of file
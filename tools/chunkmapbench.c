@@ -0,0 +1,107 @@
+/*
+ * Measures how many chunk lookups a second chunkmap does, against
+ * hash.h with the "(x, z)" string keys the world used to build.
+ *
+ *   ./chunkmapbench [lookups] [widths...]
+ *
+ * A square of width x width chunks (default 16, 64 and 256) is stored
+ * in both maps, then lookups (default 10000000) random coordinates are
+ * looked up in each. About one in eleven lies just past the square, as
+ * a lookup at the edge of the loaded world would. Both maps are then
+ * cross-checked against the square.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../adts/chunkmap.h"
+#include "../adts/hash.h"
+
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// a NULL free function makes hash.h free() the values
+static void keepValue(hashvalue v){
+  (void)v;
+}
+
+static void bench(int width, int lookups, const int *coords){
+  chunkmap m = chunkMapCreate(NULL);
+  hash h = hashCreate(NULL, keepValue, NULL);
+  char buffer[32];
+  for (int x = 0; x < width; x++){
+    for (int z = 0; z < width; z++){
+      void *v = (void *)(intptr_t)(x * width + z + 1);
+      chunkMapSet(m, x, z, v);
+      sprintf(buffer, "(%d, %d)", x, z);
+      hashSet(h, buffer, v);
+    }
+  }
+
+  // coords holds pairs in [0, 1 << 16), scaled down to the square
+  long found = 0;
+  double start = now();
+  for (int i = 0; i < lookups; i++){
+    int x = coords[2 * i] % (width + width / 10 + 1);
+    int z = coords[2 * i + 1] % width;
+    if (chunkMapFind(m, x, z) != NULL) found++;
+  }
+  double mapSeconds = now() - start;
+
+  long hashFound = 0;
+  start = now();
+  for (int i = 0; i < lookups; i++){
+    int x = coords[2 * i] % (width + width / 10 + 1);
+    int z = coords[2 * i + 1] % width;
+    sprintf(buffer, "(%d, %d)", x, z);
+    if (hashFind(h, buffer) != NULL) hashFound++;
+  }
+  double hashSeconds = now() - start;
+
+  int wrong = found == hashFound ? 0 : 1;
+  for (int x = -1; x <= width; x++){
+    for (int z = -1; z <= width; z++){
+      void *expected = x >= 0 && x < width && z >= 0 && z < width ?
+                       (void *)(intptr_t)(x * width + z + 1) : NULL;
+      sprintf(buffer, "(%d, %d)", x, z);
+      if (chunkMapFind(m, x, z) != expected || hashFind(h, buffer) != expected) wrong++;
+    }
+  }
+
+  printf("%3dx%-3d  hash+sprintf %6.1f M lookups/s   chunkmap %6.1f M lookups/s%s\n",
+         width, width, lookups / hashSeconds / 1e6, lookups / mapSeconds / 1e6,
+         wrong == 0 ? "" : "  (maps disagree!)");
+  chunkMapFree(m);
+  hashFree(h);
+}
+
+int main(int argc, char **argv){
+  int lookups = argc > 1 ? atoi(argv[1]) : 10000000;
+  if (lookups <= 0){
+    fprintf(stderr, "usage: %s [lookups] [widths...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int *coords = malloc(2 * (size_t)lookups * sizeof(int));
+  if (coords == NULL){
+    fprintf(stderr, "Out of memory for %d lookups\n", lookups);
+    return EXIT_FAILURE;
+  }
+  srand(1);
+  for (int i = 0; i < 2 * lookups; i++) coords[i] = rand() & 0xffff;
+
+  if (argc > 2){
+    for (int i = 2; i < argc; i++){
+      if (atoi(argv[i]) > 0) bench(atoi(argv[i]), lookups, coords);
+    }
+  } else {
+    bench(16, lookups, coords);
+    bench(64, lookups, coords);
+    bench(256, lookups, coords);
+  }
+  free(coords);
+  return EXIT_SUCCESS;
+}
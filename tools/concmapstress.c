@@ -0,0 +1,155 @@
+/*
+ * Hammers a concmap from several threads at once and reports how many
+ * reads and writes a second got through.
+ *
+ *   ./concmapstress [readers] [writers] [seconds]
+ *
+ * Readers (default 4) look up random keys over a 64x64 square and check
+ * every value they find is the one stored under that key and not yet
+ * freed. Writers (default 1) set and delete random keys in the same
+ * square, and one more thread keeps collecting what they retire. Runs
+ * for seconds (default 2), then checks every value made was freed
+ * exactly once. Exits with failure if anything was wrong.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "../adts/concmap.h"
+
+#define SPAN      64        // keys are (x, z) with both in [0, SPAN)
+#define LIVE      0x4c495645
+#define DEAD      0x44454144
+
+typedef struct {
+  int x, z;
+  atomic_int marker;        // LIVE until freed
+} value;
+
+typedef struct {
+  concmap m;
+  unsigned seed;
+  unsigned long ops;
+} thread;
+
+static atomic_bool stop;
+static atomic_long made, freed, wrong;
+
+static int randomBelow(unsigned *seed, int n){
+  return rand_r(seed) % n;
+}
+
+static void freeValue(concmapvalue v){
+  value *val = v;
+  if (atomic_exchange(&val->marker, DEAD) != LIVE) atomic_fetch_add(&wrong, 1);
+  atomic_fetch_add(&freed, 1);
+  // a reader still holding it sees the marker, under ASan it is caught
+  // touching freed memory
+  free(val);
+}
+
+static void *readerThread(void *arg){
+  thread *t = arg;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)){
+    concMapReadBegin(t->m);
+    for (int i = 0; i < 64; i++){
+      int x = randomBelow(&t->seed, SPAN), z = randomBelow(&t->seed, SPAN);
+      value *v = concMapFind(t->m, x, z);
+      if (v != NULL && (v->x != x || v->z != z || atomic_load(&v->marker) != LIVE)){
+        atomic_fetch_add(&wrong, 1);
+      }
+    }
+    concMapReadEnd(t->m);
+    t->ops += 64;
+  }
+  return NULL;
+}
+
+static void *writerThread(void *arg){
+  thread *t = arg;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)){
+    int x = randomBelow(&t->seed, SPAN), z = randomBelow(&t->seed, SPAN);
+    if (randomBelow(&t->seed, 4) == 0){
+      concMapDelete(t->m, x, z);
+    } else {
+      value *new = malloc(sizeof(value));
+      if (new == NULL) abort();
+      new->x = x;
+      new->z = z;
+      atomic_init(&new->marker, LIVE);
+      atomic_fetch_add(&made, 1);
+      concMapSet(t->m, x, z, new);
+    }
+    t->ops++;
+  }
+  return NULL;
+}
+
+static void *collectorThread(void *arg){
+  thread *t = arg;
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)){
+    t->ops += concMapCollect(t->m);
+    sched_yield();
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv){
+  int readers = argc > 1 ? atoi(argv[1]) : 4;
+  int writers = argc > 2 ? atoi(argv[2]) : 1;
+  double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+  if (readers < 0 || writers < 0 || readers + writers == 0 ||
+      readers > CONCMAP_MAX_READERS || seconds <= 0.0){
+    fprintf(stderr, "usage: %s [readers] [writers] [seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  concmap m = concMapCreate(freeValue);
+  int count = readers + writers + 1;
+  thread *threads = calloc(count, sizeof(thread));
+  pthread_t *handles = malloc(count * sizeof(pthread_t));
+  if (threads == NULL || handles == NULL){
+    fprintf(stderr, "Out of memory\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < count; i++){
+    threads[i] = (thread){ m, (unsigned)i + 1, 0 };
+    void *(*run)(void *) = i < readers ? readerThread :
+                           i < readers + writers ? writerThread : collectorThread;
+    if (pthread_create(&handles[i], NULL, run, &threads[i]) != 0){
+      fprintf(stderr, "Could not start thread %d\n", i);
+      return EXIT_FAILURE;
+    }
+  }
+  struct timespec wait = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+  nanosleep(&wait, NULL);
+  atomic_store(&stop, true);
+
+  unsigned long reads = 0, writes = 0;
+  for (int i = 0; i < count; i++){
+    pthread_join(handles[i], NULL);
+    if (i < readers) reads += threads[i].ops;
+    else if (i < readers + writers) writes += threads[i].ops;
+  }
+  int left = concMapMembers(m);
+  concMapFree(m);
+  free(threads);
+  free(handles);
+
+  printf("%d readers, %d writers: %.2f M reads/s, %.2f M writes/s, %d keys left\n",
+         readers, writers, reads / seconds / 1e6, writes / seconds / 1e6, left);
+  long bad = atomic_load(&wrong);
+  if (atomic_load(&made) != atomic_load(&freed)){
+    printf("%ld values made but %ld freed\n", atomic_load(&made), atomic_load(&freed));
+    bad++;
+  }
+  if (bad > 0){
+    printf("FAILED: %ld wrong values seen or freed\n", bad);
+    return EXIT_FAILURE;
+  }
+  printf("every value seen was right and freed exactly once\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+/*
+ * Checks the column quadtree finds the same chunks as testing each one
+ * against the frustum, and measures both, without opening a window.
+ *
+ *   ./cullbench [views] [width distance...]
+ *
+ * Columns of a width x width grid are given random heights: one in ten
+ * is empty, one in ten is unknown (a full chunk tall, as when evicted).
+ * From views (default 2000) random eyes, the tree and the per-chunk test
+ * each list the columns within distance of the eye that may be seen.
+ * Pairs of width and distance default to 16 5, 128 32, 512 64 and
+ * 1000 200. Exits with failure if the two ever disagree.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../world/culltree.h"
+#include "../world/camera.h"
+#include "../world/chunk.h"
+#include "../main.h"
+
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+  int width;
+  unsigned char *seen;    // by the tree in the current view
+  int visits;
+  int repeats;            // columns it visited twice
+} visitArg;
+
+static void visitColumn(int x, int z, void *arg){
+  visitArg *v = arg;
+  unsigned char *seen = &v->seen[x * v->width + z];
+  if (*seen) v->repeats++;
+  *seen = 1;
+  v->visits++;
+}
+
+// the projection main.c builds, looking from a random height and direction
+static frustum randomView(float x, float z){
+  float near = 0.05f;
+  float fov  = 1.0f / tanf(radians(FFOV) / 2.0f);
+  mat4 proj = {{{ 0.0f }}};
+  proj.m[0][0] = (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT * fov;
+  proj.m[1][1] = fov;
+  proj.m[2][2] = -(FFAR + near) / (FFAR - near);
+  proj.m[2][3] = -(2.0f * FFAR * near) / (FFAR - near);
+  proj.m[3][2] = -1.0f;
+  vec3 eye = vec3Make(x * CHUNK_SIZE_X, (float)(rand() % 40), z * CHUNK_SIZE_Z);
+  vec3 front = frontVector((float)(rand() % 3600) / 10.0f, (float)(rand() % 1200) / 10.0f - 60.0f);
+  mat4 view = mat4LookAt(eye, vec3Add(eye, front), vec3Make(0.0f, 1.0f, 0.0f));
+  mat4 viewProj = mat4Multiply(&proj, &view);
+  return frustumFromMatrix(&viewProj);
+}
+
+// returns the number of columns the two disagreed on
+static long bench(int width, int distance, int views){
+  int count = width * width;
+  float *lo = malloc(count * sizeof(float));
+  float *hi = malloc(count * sizeof(float));
+  unsigned char *seen = malloc(count);
+  if (lo == NULL || hi == NULL || seen == NULL){
+    fprintf(stderr, "Out of memory for %d columns\n", count);
+    exit(EXIT_FAILURE);
+  }
+
+  srand(1);
+  culltree t = createCullTree(width, width);
+  for (int i = 0; i < count; i++){
+    int kind = rand() % 10;
+    if (kind == 0){
+      lo[i] = 1.0f;
+      hi[i] = 0.0f;
+      cullTreeSetColumn(t, i / width, i % width, lo[i], hi[i]);
+    } else if (kind == 1){
+      lo[i] = 0.0f;
+      hi[i] = CHUNK_SIZE_Y;
+      cullTreeResetColumn(t, i / width, i % width);
+    } else {
+      lo[i] = (float)(rand() % 6);
+      hi[i] = lo[i] + 1.0f + (float)(rand() % 10);
+      cullTreeSetColumn(t, i / width, i % width, lo[i], hi[i]);
+    }
+  }
+
+  visitArg arg = { width, seen, 0, 0 };
+  long wrong = 0, treeVisible = 0, boxTests = 0, chunkVisible = 0;
+  double treeSeconds = 0.0, chunkSeconds = 0.0;
+  for (int v = 0; v < views; v++){
+    int cx = rand() % width, cz = rand() % width;
+    frustum f = randomView(cx + 0.5f, cz + 0.5f);
+    int minX = cx - distance, maxX = cx + distance;
+    int minZ = cz - distance, maxZ = cz + distance;
+    memset(seen, 0, count);
+    arg.visits = 0;
+
+    double start = now();
+    boxTests += cullTreeQuery(t, &f, minX, minZ, maxX, maxZ, &visitColumn, &arg);
+    treeSeconds += now() - start;
+    treeVisible += arg.visits;
+
+    start = now();
+    int visible = 0;
+    for (int x = minX; x <= maxX; x++){
+      for (int z = minZ; z <= maxZ; z++){
+        if (x < 0 || z < 0 || x >= width || z >= width) continue;
+        int i = x * width + z;
+        if (lo[i] >= hi[i]) continue;
+        vec3 min = vec3Make((float)x * CHUNK_SIZE_X, lo[i], (float)z * CHUNK_SIZE_Z);
+        vec3 max = vec3Make((float)(x + 1) * CHUNK_SIZE_X, hi[i], (float)(z + 1) * CHUNK_SIZE_Z);
+        if (!frustumTestBox(&f, min, max)) continue;
+        visible++;
+        // the tree must have found it, and may not find anything else
+        if (!seen[i]) wrong++;
+        seen[i] = 2;
+      }
+    }
+    chunkSeconds += now() - start;
+    chunkVisible += visible;
+    for (int i = 0; i < count; i++) if (seen[i] == 1) wrong++;
+  }
+  wrong += arg.repeats;
+
+  printf("%4d %4d  %8.1f %8.1f %12.1f %8.1f us %8.1f us%s\n",
+         width, distance, (double)treeVisible / views, (double)chunkVisible / views,
+         (double)boxTests / views, treeSeconds / views * 1e6, chunkSeconds / views * 1e6,
+         wrong == 0 ? "" : "  (disagree!)");
+  freeCullTree(t);
+  free(lo);
+  free(hi);
+  free(seen);
+  return wrong;
+}
+
+int main(int argc, char **argv){
+  int views = argc > 1 ? atoi(argv[1]) : 2000;
+  if (views <= 0 || argc == 3){
+    fprintf(stderr, "usage: %s [views] [width distance...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  printf("%d views\n", views);
+  printf("grid dist   visible  by chunk  boxes tested       tree    per chunk\n");
+  long wrong = 0;
+  if (argc > 3){
+    for (int i = 2; i + 1 < argc; i += 2){
+      int width = atoi(argv[i]), distance = atoi(argv[i + 1]);
+      if (width > 0 && distance > 0) wrong += bench(width, distance, views);
+    }
+  } else {
+    wrong += bench(16, 5, views);
+    wrong += bench(128, 32, views);
+    wrong += bench(512, 64, views);
+    wrong += bench(1000, 200, views);
+  }
+  if (wrong > 0){
+    printf("FAILED: the tree and the per-chunk test disagreed on %ld columns\n", wrong);
+    return EXIT_FAILURE;
+  }
+  printf("the tree found exactly the columns the per-chunk test did\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+/*
+ * Measures how many bodies a second stepEntities moves over generated
+ * terrain, without opening a window.
+ *
+ *   ./entitybench [workers] [steps] [bodies...]
+ *
+ * Bodies (default 1000, 10000 and 100000) are dropped at random over a
+ * world sized to keep about one to every three columns, given random
+ * walking speeds, and stepped steps times (default 600) at 60 a second.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../world/world.h"
+#include "../world/entities.h"
+
+#define DT            (1.0f / 60.0f)
+#define COLUMNS_EACH  3.0f
+#define WALK_SPEED    3.0f
+
+static float randomBetween(float lo, float hi){
+  return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static void bench(int bodies, int workers, int steps){
+  int chunks = (int)ceilf(sqrtf(bodies * COLUMNS_EACH) / CHUNK_SIZE_X);
+  if (chunks < 2) chunks = 2;
+  float span = (float)chunks * CHUNK_SIZE_X;
+  world w = createWorld(chunks, chunks, NULL);
+  vec3 centre = vec3Make(span / 2.0f, CHUNK_SIZE_Y, span / 2.0f);
+  centreWorld(w, &centre);
+
+  entities e = createEntities(bodies, workers);
+  srand(1);
+  for (int i = 0; i < bodies; i++){
+    addEntity(e, vec3Make(randomBetween(1.0f, span - 1.0f), randomBetween(12.0f, 15.0f),
+                          randomBetween(1.0f, span - 1.0f)),
+              vec3Make(0.6f, 0.9f, 0.6f),
+              vec3Make(randomBetween(-WALK_SPEED, WALK_SPEED), 0.0f,
+                       randomBetween(-WALK_SPEED, WALK_SPEED)));
+  }
+
+  entityStats total = { 0 };
+  for (int s = 0; s < steps; s++){
+    stepEntities(e, w, DT);
+    entityStats stats = getEntityStats(e);
+    total.candidates     += stats.candidates;
+    total.contacts       += stats.contacts;
+    total.worldSeconds   += stats.worldSeconds;
+    total.gridSeconds    += stats.gridSeconds;
+    total.contactSeconds += stats.contactSeconds;
+    total.stepSeconds    += stats.stepSeconds;
+  }
+  entityStats last = getEntityStats(e);
+  printf("%7d bodies, %d threads, %dx%d chunks: %.3f ms a step, %.2fM bodies/s\n"
+         "        world %.3f ms, grid %.3f ms, contacts %.3f ms; "
+         "%.1f candidates and %.2f contacts a body, %d%% grounded at the end\n",
+         bodies, last.threads, chunks, chunks, total.stepSeconds / steps * 1000.0,
+         (double)bodies * steps / total.stepSeconds / 1e6,
+         total.worldSeconds / steps * 1000.0, total.gridSeconds / steps * 1000.0,
+         total.contactSeconds / steps * 1000.0,
+         (double)total.candidates / steps / bodies, (double)total.contacts / steps / bodies,
+         100 * last.grounded / bodies);
+  freeEntities(e);
+  freeWorld(w);
+}
+
+int main(int argc, char **argv){
+  int workers = argc > 1 ? atoi(argv[1]) : 3;
+  int steps   = argc > 2 ? atoi(argv[2]) : 600;
+  if (workers < 0 || steps <= 0){
+    fprintf(stderr, "usage: %s [workers] [steps] [bodies...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc > 3){
+    for (int i = 3; i < argc; i++) bench(atoi(argv[i]), workers, steps);
+  } else {
+    bench(1000, workers, steps);
+    bench(10000, workers, steps);
+    bench(100000, workers, steps);
+  }
+  return EXIT_SUCCESS;
+}
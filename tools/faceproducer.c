@@ -0,0 +1,102 @@
+/*
+ * Stand-in for face.py: writes a head slowly looking around, so the
+ * face tracking transports can be run without a camera.
+ *
+ *   ./faceproducer [rate] [udp]
+ *
+ * rate is poses a second (default 60). Poses go to shared memory unless
+ * udp is given, then they are sent to 127.0.0.1 like face.py would.
+ * Either way a pose is stamped with the time it was meant to be captured.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../main.h"
+#include "../tracking/facerecv.h"
+#include "../tracking/faceshm.h"
+#include "../tracking/faceproto.h"
+
+#define LANDMARKS 9   // as many as face.py sends
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig){
+  (void)sig;
+  running = 0;
+}
+
+static void sleepUntil(double when){
+  struct timespec ts;
+  ts.tv_sec  = (time_t)when;
+  ts.tv_nsec = (long)((when - ts.tv_sec) * 1e9);
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void makePose(facePose *pose, double t){
+  pose->yaw   = 0.6f * (float)sin(t * 0.5);
+  pose->pitch = 0.3f * (float)sin(t * 0.3);
+  pose->count = LANDMARKS;
+  for (int i = 0; i < LANDMARKS; i++){
+    float angle = (float)i / LANDMARKS * 6.2831853f;
+    pose->points[i] = (Point3D){ 0.5f + 0.2f * cosf(angle) + 0.1f * pose->yaw,
+                                 0.5f + 0.2f * sinf(angle) - 0.1f * pose->pitch,
+                                 0.0f };
+  }
+}
+
+int main(int argc, char **argv){
+  double rate = argc > 1 ? atof(argv[1]) : 60.0;
+  int udp = argc > 2 && strcmp(argv[2], "udp") == 0;
+  if (rate <= 0.0){
+    fprintf(stderr, "usage: %s [rate] [udp]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  faceshmwriter writer = NULL;
+  int sockfd = -1;
+  struct sockaddr_in to;
+  if (udp){
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_port        = htons(SOCK_ADD);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  } else {
+    writer = createFaceShmWriter(FACE_SHM_NAME);
+    if (writer == NULL) return EXIT_FAILURE;
+  }
+  printf("Writing %.0f poses a second to %s\n", rate, udp ? "UDP" : FACE_SHM_NAME);
+
+  double start = faceClockSeconds();
+  unsigned long written = 0;
+  while (running){
+    double next = start + written / rate;
+    sleepUntil(next);
+    facePose pose;
+    makePose(&pose, next - start);
+    if (udp){
+      float datagram[FACE_PROTO_HEADER / sizeof(float) + LANDMARKS * 3 + 2];
+      uint64_t captureNs = (uint64_t)(next * 1e9);
+      uint64_t sendNs = (uint64_t)(faceClockSeconds() * 1e9);
+      int len = faceProtoEncode(&pose, (uint32_t)written, captureNs, sendNs, datagram, sizeof(datagram));
+      sendto(sockfd, datagram, len, 0, (struct sockaddr *)&to, sizeof(to));
+    } else {
+      pose.captured = next;
+      faceShmPublish(writer, &pose);
+    }
+    written++;
+  }
+
+  printf("Wrote %lu poses\n", written);
+  if (writer != NULL) freeFaceShmWriter(writer);
+  if (sockfd >= 0) close(sockfd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*
+ * Checks the face datagram is read the way faceproto.h describes it,
+ * and that a receiver counts late, lost and invalid datagrams right.
+ *
+ *   ./faceprotocheck [port]
+ *
+ * A version 1 header laid out byte by byte must decode to its fields
+ * and encode back to the same bytes, bare floats must still read as
+ * version 0, and wrong versions or lengths must be refused. Then
+ * datagrams are sent over loopback to a receiver on port (default one
+ * above main's): sequences out of order, a version 2 datagram, and poses
+ * of up to 5455 landmarks, the most one UDP datagram holds. Exits with
+ * failure if anything came out different.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../main.h"
+#include "../tracking/facerecv.h"
+#include "../tracking/faceproto.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what){
+  printf("  %-66s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+static void put(uint8_t *bytes, int at, uint64_t value, int size){
+  for (int i = 0; i < size; i++) bytes[at + i] = (uint8_t)(value >> (8 * i));
+}
+
+static void checkDecoding(void){
+  printf("decoding\n");
+  // one landmark (1, 2, 3), yaw 0.25 and pitch -0.5, laid out by hand
+  float datagram[(FACE_PROTO_HEADER + 5 * sizeof(float)) / sizeof(float)];
+  uint8_t *bytes = (uint8_t *)datagram;
+  memset(datagram, 0, sizeof(datagram));
+  memcpy(bytes, "FTRK", 4);
+  put(bytes, 4, FACE_PROTO_VERSION, 1);
+  put(bytes, 6, 1, 2);
+  put(bytes, 8, 0xfffffffeu, 4);
+  put(bytes, 16, 0x0102030405060708ull, 8);
+  put(bytes, 24, 0x1112131415161718ull, 8);
+  float floats[5] = { 1.0f, 2.0f, 3.0f, 0.25f, -0.5f };
+  memcpy(bytes + FACE_PROTO_HEADER, floats, sizeof(floats));
+
+  faceDatagram d;
+  bool ok = faceProtoCheck(datagram, sizeof(datagram), &d);
+  check(ok && d.version == 1 && d.landmarks == 1 && d.sequence == 0xfffffffeu &&
+        d.captureNs == 0x0102030405060708ull && d.sendNs == 0x1112131415161718ull,
+        "version 1 header decodes to its fields");
+  facePose pose;
+  memset(&pose, 0, sizeof(pose));
+  if (ok) faceProtoPose(&d, &pose);
+  check(ok && pose.count == 1 && pose.points[0].x == 1.0f && pose.points[0].z == 3.0f &&
+        pose.yaw == 0.25f && pose.pitch == -0.5f, "landmarks, yaw and pitch come out");
+
+  float encoded[sizeof(datagram) / sizeof(float)];
+  int len = ok ? faceProtoEncode(&pose, d.sequence, d.captureNs, d.sendNs, encoded, sizeof(encoded)) : 0;
+  check(len == (int)sizeof(datagram) && memcmp(encoded, datagram, len) == 0,
+        "encoding the pose again gives the same bytes");
+  check(faceProtoEncode(&pose, 0, 0, 0, encoded, sizeof(encoded) - 1) == 0,
+        "encoding into too small a buffer is refused");
+
+  check(!faceProtoCheck(datagram, sizeof(datagram) - sizeof(float), &d),
+        "a length that does not match the count is refused");
+  put(bytes, 4, FACE_PROTO_VERSION + 1, 1);
+  check(!faceProtoCheck(datagram, sizeof(datagram), &d), "an unknown version is refused");
+
+  float bare[5] = { 1.0f, 2.0f, 3.0f, 0.25f, -0.5f };
+  ok = faceProtoCheck(bare, sizeof(bare), &d);
+  if (ok) faceProtoPose(&d, &pose);
+  check(ok && d.version == 0 && d.landmarks == 1 && pose.yaw == 0.25f && pose.pitch == -0.5f,
+        "bare floats still read as version 0");
+}
+
+// sends a version 1 pose of the given landmarks and sequence, or of
+// another version, and gives the receiver time to take it
+static bool sendPose(int sockfd, const struct sockaddr_in *to, int landmarks,
+                     uint32_t sequence, int version){
+  static float datagram[FACE_PROTO_MAX_DATAGRAM / sizeof(float)];
+  facePose pose;
+  memset(&pose, 0, sizeof(pose));
+  pose.yaw = 0.25f;
+  pose.pitch = -0.5f;
+  uint64_t now = (uint64_t)(faceClockSeconds() * 1e9);
+  faceProtoEncode(&pose, sequence, now, now, datagram, sizeof(datagram));
+  uint8_t *bytes = (uint8_t *)datagram;
+  put(bytes, 4, (uint64_t)version, 1);
+  put(bytes, 6, (uint64_t)landmarks, 2);
+  float *floats = datagram + FACE_PROTO_HEADER / sizeof(float);
+  for (int i = 0; i < landmarks * 3; i++) floats[i] = (float)i;
+  floats[landmarks * 3]     = 0.25f;
+  floats[landmarks * 3 + 1] = -0.5f;
+  int len = FACE_PROTO_HEADER + (landmarks * 3 + 2) * (int)sizeof(float);
+  bool sent = sendto(sockfd, datagram, len, 0, (const struct sockaddr *)to, sizeof(*to)) == len;
+  struct timespec wait = { 0, 20000000 };
+  nanosleep(&wait, NULL);
+  return sent;
+}
+
+static void checkReceiving(int port){
+  printf("receiving on port %d\n", port);
+  facereceiver r = createFaceReceiver(port, NULL);
+  if (r == NULL){
+    check(false, "receiver started");
+    return;
+  }
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family      = AF_INET;
+  to.sin_port        = htons(port);
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  // 3 and 4 arrive after newer ones, 7 and 8 never do, and the jumps to
+  // 1000 and back to 3 are each taken as the sender starting over
+  uint32_t sequences[] = { 0, 1, 2, 5, 4, 6, 1000, 3, 9 };
+  int count = sizeof(sequences) / sizeof(sequences[0]);
+  for (int i = 0; i < count; i++) sendPose(sockfd, &to, 9, sequences[i], FACE_PROTO_VERSION);
+  sendPose(sockfd, &to, 9, 10, FACE_PROTO_VERSION + 1);
+  facePose pose;
+  faceReceiverLatest(r, &pose);
+  faceRecvStats stats = getFaceReceiverStats(r);
+  char what[80];
+  snprintf(what, sizeof(what), "0 1 2 5 4 6 1000 3 9 and a version 2: late %lu, lost %lu, invalid %lu",
+           stats.late, stats.lost, stats.invalid);
+  check(stats.late == 1 && stats.lost == 7 && stats.invalid == 1, what);
+  unsigned long invalid = stats.invalid;
+
+  int sizes[] = { 39, 40, 200, 5455 };
+  for (int i = 0; i < 4; i++){
+    bool sent = sendPose(sockfd, &to, sizes[i], 20 + i, FACE_PROTO_VERSION);
+    bool read = faceReceiverLatest(r, &pose);
+    snprintf(what, sizeof(what), "a pose of %d landmarks is read whole", sizes[i]);
+    check(sent && read && pose.sequence == (unsigned long)(20 + i) && pose.yaw == 0.25f &&
+          pose.count == (sizes[i] < FACE_MAX_POINTS ? sizes[i] : FACE_MAX_POINTS), what);
+  }
+  stats = getFaceReceiverStats(r);
+  check(stats.invalid == invalid, "none of them counted invalid");
+  close(sockfd);
+  freeFaceReceiver(r);
+}
+
+int main(int argc, char **argv){
+  int port = argc > 1 ? atoi(argv[1]) : SOCK_ADD + 1;
+  if (port <= 0){
+    fprintf(stderr, "usage: %s [port]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  checkDecoding();
+  checkReceiving(port);
+  if (failures > 0){
+    printf("FAILED: %d checks\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("every check passed\n");
+  return EXIT_SUCCESS;
+}
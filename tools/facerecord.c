@@ -0,0 +1,99 @@
+/*
+ * Records the face tracker's datagrams to a file until interrupted, so
+ * the input path can be replayed later without a camera.
+ *
+ *   ./facerecord file [port]
+ *
+ * port defaults to the one main listens on, so run one or the other.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../main.h"
+#include "../tracking/facerecv.h"
+#include "../tracking/faceproto.h"
+#include "facerecording.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig){
+  (void)sig;
+  running = 0;
+}
+
+int main(int argc, char **argv){
+  if (argc < 2){
+    fprintf(stderr, "usage: %s file [port]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int port = argc > 2 ? atoi(argv[2]) : SOCK_ADD;
+
+  // no SA_RESTART, so an interrupt ends the blocked recv
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = INADDR_ANY;
+  if (sockfd < 0 || bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    fprintf(stderr, "Cannot bind UDP port %d\n", port);
+    return EXIT_FAILURE;
+  }
+  FILE *out = fopen(argv[1], "wb");
+  if (out == NULL){
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  recordingHeader header = { RECORDING_MAGIC, RECORDING_VERSION };
+  fwrite(&header, sizeof(header), 1, out);
+  printf("Recording port %d to %s, interrupt to stop\n", port, argv[1]);
+
+  float datagram[RECORDING_MAX_DATAGRAM / sizeof(float)];
+  unsigned long count = 0, versioned = 0, invalid = 0, gaps = 0, truncated = 0;
+  uint32_t lastSequence = 0;
+  while (running){
+    // MSG_TRUNC returns the whole length even when it did not fit
+    ssize_t len = recv(sockfd, datagram, sizeof(datagram), MSG_TRUNC);
+    if (len < 0){
+      if (errno == EINTR) continue;
+      perror("recv");
+      break;
+    }
+    if ((size_t)len > sizeof(datagram)){
+      fprintf(stderr, "Skipped a %zd byte datagram, more than %zu fit\n", len, sizeof(datagram));
+      truncated++;
+      continue;
+    }
+    recordingEntry entry = { (uint64_t)(faceClockSeconds() * 1e9), (uint32_t)len };
+    fwrite(&entry, sizeof(entry), 1, out);
+    fwrite(datagram, 1, len, out);
+    count++;
+
+    faceDatagram d;
+    if (!faceProtoCheck(datagram, (int)len, &d)){
+      invalid++;
+    } else if (d.version > 0){
+      if (versioned > 0 && d.sequence != lastSequence + 1) gaps++;
+      lastSequence = d.sequence;
+      versioned++;
+    }
+  }
+
+  fclose(out);
+  close(sockfd);
+  printf("Recorded %lu datagrams: %lu versioned, %lu invalid, %lu sequence gaps, %lu too long\n",
+         count, versioned, invalid, gaps, truncated);
+  return EXIT_SUCCESS;
+}
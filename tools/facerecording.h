@@ -0,0 +1,28 @@
+#ifndef FACERECORDING_H
+#define FACERECORDING_H
+
+#include <stdint.h>
+
+#include "../tracking/faceproto.h"
+
+/*
+ * A recording of face tracking datagrams, as written by facerecord and
+ * read by facereplay. It starts with a header, then holds every datagram
+ * exactly as it arrived, behind the time it arrived. All in the byte
+ * order of the machine that recorded it.
+ */
+#define RECORDING_MAGIC   0x43455246u   // "FREC"
+#define RECORDING_VERSION 1
+#define RECORDING_MAX_DATAGRAM FACE_PROTO_MAX_DATAGRAM
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+} recordingHeader;
+
+typedef struct {
+  uint64_t arrivedNs;   // on the recorder's monotonic clock
+  uint32_t length;      // bytes of datagram that follow
+} recordingEntry;
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Sends poses to a face receiver over loopback faster or slower than a
+ * frame, and checks the receiver hands the newest one to each frame.
+ *
+ *   ./facerecvbench [rate] [seconds] [port]
+ *
+ * A thread sends version 1 datagrams at rate poses a second (default
+ * 2000) to port (default one above main's, so both can run) while the
+ * main thread reads the receiver at 60 frames a second for seconds
+ * (default 3). Prints how old the poses were when read, how far behind
+ * the newest sent they were and how many were passed over. Exits with
+ * failure if a frame was handed an older pose than the one before, or
+ * a datagram was counted invalid.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../main.h"
+#include "../tracking/facerecv.h"
+#include "../tracking/faceproto.h"
+
+#define FRAME_RATE 60.0
+#define LANDMARKS  9
+
+typedef struct {
+  int port;
+  double rate, until;
+  atomic_ulong sent;
+} sender;
+
+static void sleepUntil(double when){
+  struct timespec ts;
+  ts.tv_sec  = (time_t)when;
+  ts.tv_nsec = (long)((when - ts.tv_sec) * 1e9);
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void *sendLoop(void *arg){
+  sender *s = arg;
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family      = AF_INET;
+  to.sin_port        = htons(s->port);
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  facePose pose;
+  memset(&pose, 0, sizeof(pose));
+  pose.count = LANDMARKS;
+  float datagram[FACE_PROTO_HEADER / sizeof(float) + LANDMARKS * 3 + 2];
+  double start = faceClockSeconds();
+  for (unsigned long i = 0; ; i++){
+    double next = start + i / s->rate;
+    if (next > s->until) break;
+    sleepUntil(next);
+    uint64_t nowNs = (uint64_t)(faceClockSeconds() * 1e9);
+    pose.yaw = (float)i;
+    int len = faceProtoEncode(&pose, (uint32_t)i, nowNs, nowNs, datagram, sizeof(datagram));
+    // counted first, so the reader never sees a pose newer than sent
+    atomic_store(&s->sent, i + 1);
+    sendto(sockfd, datagram, len, 0, (struct sockaddr *)&to, sizeof(to));
+  }
+  close(sockfd);
+  return NULL;
+}
+
+int main(int argc, char **argv){
+  double rate    = argc > 1 ? atof(argv[1]) : 2000.0;
+  double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+  int port       = argc > 3 ? atoi(argv[3]) : SOCK_ADD + 1;
+  if (rate <= 0.0 || seconds <= 0.0 || port <= 0){
+    fprintf(stderr, "usage: %s [rate] [seconds] [port]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  facereceiver r = createFaceReceiver(port, NULL);
+  if (r == NULL) return EXIT_FAILURE;
+
+  double start = faceClockSeconds();
+  sender s = { port, rate, start + seconds, 0 };
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, sendLoop, &s) != 0){
+    fprintf(stderr, "Could not start the sender\n");
+    return EXIT_FAILURE;
+  }
+
+  unsigned long frames = 0, read = 0, backwards = 0, maxBehind = 0;
+  double age = 0.0, maxAge = 0.0;
+  long lastSequence = -1;
+  for (double next = start; next < start + seconds; next += 1.0 / FRAME_RATE){
+    sleepUntil(next);
+    frames++;
+    facePose pose;
+    if (!faceReceiverLatest(r, &pose)) continue;
+    double now = faceClockSeconds();
+    unsigned long sent = atomic_load(&s.sent);
+    read++;
+    if ((long)pose.sequence <= lastSequence) backwards++;
+    lastSequence = (long)pose.sequence;
+    if (sent - 1 - pose.sequence > maxBehind) maxBehind = sent - 1 - pose.sequence;
+    age += now - pose.captured;
+    if (now - pose.captured > maxAge) maxAge = now - pose.captured;
+  }
+  pthread_join(thread, NULL);
+  faceRecvStats stats = getFaceReceiverStats(r);
+  freeFaceReceiver(r);
+
+  printf("%.0f poses/s for %.1f s, read at %.0f frames/s\n", rate, seconds, FRAME_RATE);
+  printf("  sent %lu, received %lu, %lu of %lu frames had a new pose\n",
+         atomic_load(&s.sent), stats.received, read, frames);
+  printf("  age when read: mean %.2f ms, max %.2f ms\n",
+         read > 0 ? age / read * 1000.0 : 0.0, maxAge * 1000.0);
+  printf("  at most %lu behind the newest sent, %lu superseded, %lu dropped by the kernel\n",
+         maxBehind, stats.superseded, stats.kernelDropped);
+  if (backwards > 0 || stats.invalid > 0){
+    printf("FAILED: %lu poses read out of order, %lu datagrams invalid\n", backwards, stats.invalid);
+    return EXIT_FAILURE;
+  }
+  printf("every frame got a newer pose than the last\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/*
+ * Sends a recording made by facerecord back over loopback, to benchmark
+ * or regression test the input path without a camera.
+ *
+ *   ./facereplay file [speed] [port]
+ *
+ * speed 1 (the default) keeps the original timing, 4 plays four times as
+ * fast and 0 sends as fast as it can. Versioned datagrams are restamped
+ * as sent now, keeping the tracker's own delay between capture and send.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../main.h"
+#include "../tracking/facerecv.h"
+#include "../tracking/faceproto.h"
+#include "facerecording.h"
+
+static void sleepUntil(double when){
+  struct timespec ts;
+  ts.tv_sec  = (time_t)when;
+  ts.tv_nsec = (long)((when - ts.tv_sec) * 1e9);
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+int main(int argc, char **argv){
+  if (argc < 2){
+    fprintf(stderr, "usage: %s file [speed] [port]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  double speed = argc > 2 ? atof(argv[2]) : 1.0;
+  int port = argc > 3 ? atoi(argv[3]) : SOCK_ADD;
+
+  FILE *in = fopen(argv[1], "rb");
+  if (in == NULL){
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  recordingHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      header.magic != RECORDING_MAGIC || header.version != RECORDING_VERSION){
+    fprintf(stderr, "%s is not a face recording\n", argv[1]);
+    fclose(in);
+    return EXIT_FAILURE;
+  }
+
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family      = AF_INET;
+  to.sin_port        = htons(port);
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  float datagram[RECORDING_MAX_DATAGRAM / sizeof(float)];
+  recordingEntry entry;
+  unsigned long sent = 0;
+  uint64_t firstArrived = 0;
+  double start = faceClockSeconds();
+  double late = 0.0;   // the furthest behind schedule a datagram went out
+  while (fread(&entry, sizeof(entry), 1, in) == 1){
+    if (entry.length > sizeof(datagram) || fread(datagram, 1, entry.length, in) != entry.length){
+      fprintf(stderr, "%s is cut short after %lu datagrams\n", argv[1], sent);
+      break;
+    }
+    if (sent == 0) firstArrived = entry.arrivedNs;
+    if (speed > 0.0){
+      double due = start + (entry.arrivedNs - firstArrived) * 1e-9 / speed;
+      sleepUntil(due);
+      double behind = faceClockSeconds() - due;
+      if (behind > late) late = behind;
+    }
+
+    faceDatagram d;
+    if (faceProtoCheck(datagram, (int)entry.length, &d) && d.version > 0){
+      uint64_t sendNs = (uint64_t)(faceClockSeconds() * 1e9);
+      uint64_t trackerNs = d.sendNs > d.captureNs ? d.sendNs - d.captureNs : 0;
+      faceProtoRestamp(datagram, sendNs - trackerNs, sendNs);
+    }
+    sendto(sockfd, datagram, entry.length, 0, (struct sockaddr *)&to, sizeof(to));
+    sent++;
+  }
+
+  double elapsed = faceClockSeconds() - start;
+  printf("Sent %lu datagrams in %.3f s, %.0f a second, at worst %.3f ms behind schedule\n",
+         sent, elapsed, elapsed > 0.0 ? sent / elapsed : 0.0, late * 1000.0);
+  fclose(in);
+  close(sockfd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/*
+ * Races a shared memory pose writer against a reader and checks no read
+ * ever comes back torn or older than the one before.
+ *
+ *   ./faceshmstress [seconds]
+ *
+ * One thread publishes poses to a scratch segment as fast as it can,
+ * every field of pose n set from n. The main thread reads the newest
+ * pose over and over for seconds (default 2), checking each copy is all
+ * one pose and newer than the last. Prints how many got through, how
+ * old they were when read and how often the reader met the writer.
+ * Exits with failure if any read was torn or went backwards, or none
+ * got through at all.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "../tracking/facerecv.h"
+#include "../tracking/faceshm.h"
+
+#define SEGMENT "/terrain-face-stress"
+
+static atomic_bool stop;
+static atomic_ulong written;
+
+static void *writeLoop(void *arg){
+  faceshmwriter w = arg;
+  facePose pose = { 0 };
+  pose.count = FACE_MAX_POINTS;
+  for (unsigned long n = 1; !atomic_load_explicit(&stop, memory_order_relaxed); n++){
+    float f = (float)(n & 0xffffff);  // exact as a float
+    pose.yaw   = f;
+    pose.pitch = -f;
+    for (int i = 0; i < FACE_MAX_POINTS; i++) pose.points[i] = (Point3D){ f, (float)i, -f };
+    faceShmPublish(w, &pose);
+    atomic_store_explicit(&written, n, memory_order_relaxed);
+    if ((n & 63) == 0) sched_yield();
+  }
+  return NULL;
+}
+
+// true when every field came from the same pose
+static bool whole(const facePose *pose){
+  if (pose->count != FACE_MAX_POINTS || pose->pitch != -pose->yaw) return false;
+  for (int i = 0; i < FACE_MAX_POINTS; i++){
+    const Point3D *p = &pose->points[i];
+    if (p->x != pose->yaw || p->y != (float)i || p->z != -pose->yaw) return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+  if (seconds <= 0.0){
+    fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  faceshmwriter w = createFaceShmWriter(SEGMENT);
+  if (w == NULL) return EXIT_FAILURE;
+  faceshm s = openFaceShm(SEGMENT);
+  if (s == NULL){
+    freeFaceShmWriter(w);
+    return EXIT_FAILURE;
+  }
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, writeLoop, w) != 0){
+    fprintf(stderr, "Could not start the writer\n");
+    return EXIT_FAILURE;
+  }
+
+  unsigned long reads = 0, torn = 0, backwards = 0, superseded = 0;
+  unsigned long last = 0;
+  double age = 0.0, maxAge = 0.0;
+  double start = faceClockSeconds(), now = start;
+  for (unsigned long i = 0; now - start < seconds; i++){
+    // both give way now and then, so on one core they still interleave
+    if ((i & 1023) == 0) sched_yield();
+    facePose pose;
+    unsigned long skipped;
+    bool fresh = faceShmLatest(s, &pose, &skipped);
+    now = faceClockSeconds();
+    if (!fresh) continue;
+    reads++;
+    superseded += skipped;
+    if (!whole(&pose)) torn++;
+    if (reads > 1 && pose.sequence <= last) backwards++;
+    last = pose.sequence;
+    age += now - pose.captured;
+    if (now - pose.captured > maxAge) maxAge = now - pose.captured;
+  }
+  atomic_store(&stop, true);
+  pthread_join(thread, NULL);
+  unsigned long retries = faceShmRetries(s);
+  closeFaceShm(s);
+  freeFaceShmWriter(w);
+
+  printf("%.1f s: %lu poses written, %lu read, %lu superseded, %lu retries\n",
+         seconds, atomic_load(&written), reads, superseded, retries);
+  printf("  age when read: mean %.1f us, max %.1f us\n",
+         reads > 0 ? age / reads * 1e6 : 0.0, maxAge * 1e6);
+  if (reads == 0){
+    printf("FAILED: the writer lapped every read\n");
+    return EXIT_FAILURE;
+  }
+  if (torn > 0 || backwards > 0){
+    printf("FAILED: %lu torn reads, %lu older than the one before\n", torn, backwards);
+    return EXIT_FAILURE;
+  }
+  printf("every read was one whole pose, newer than the last\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+/*
+ * Runs main's frame graph on the job system with 0 to 3 workers and
+ * checks every frame kept to it, then checks culling both passes as jobs
+ * finds what culling them one after the other does.
+ *
+ *   ./jobstress [frames]
+ *
+ * The graph has main's shape: input, face, face upload, simulate, the
+ * two culls and draw, with the same dependencies and the same jobs kept
+ * on the main thread. Each job spins for a random while, so the order
+ * they finish in changes from frame to frame. For frames (default 2000)
+ * frames a job must start after everything it depends on finished.
+ * Then both passes are culled over a 32x32 world from frames / 10 views,
+ * in a graph and one after the other, and must keep the same chunks.
+ * Exits with failure on any difference.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../main.h"
+#include "../utils/jobs.h"
+#include "../utils/perlin.h"
+#include "../world/world.h"
+#include "../world/camera.h"
+
+enum {
+  FRAME_INPUT, FRAME_FACE, FRAME_FACE_UPLOAD, FRAME_SIMULATE,
+  FRAME_CULL_MAIN, FRAME_CULL_REFLECTION, FRAME_DRAW, FRAME_JOBS
+};
+
+static const char *jobNames[FRAME_JOBS] = {
+  "input", "face", "face upload", "simulate", "cull main", "cull reflection", "draw"
+};
+static const bool onMainThread[FRAME_JOBS] = { true, false, true, false, false, false, true };
+// main.c's dependencies: job, then the one it waits for
+static const int depends[][2] = {
+  { FRAME_FACE, FRAME_INPUT },
+  { FRAME_FACE_UPLOAD, FRAME_FACE },
+  { FRAME_SIMULATE, FRAME_FACE },
+  { FRAME_CULL_MAIN, FRAME_SIMULATE },
+  { FRAME_CULL_REFLECTION, FRAME_SIMULATE },
+  { FRAME_DRAW, FRAME_FACE_UPLOAD },
+  { FRAME_DRAW, FRAME_CULL_MAIN },
+  { FRAME_DRAW, FRAME_CULL_REFLECTION }
+};
+#define DEPENDS ((int)(sizeof(depends) / sizeof(depends[0])))
+
+typedef struct {
+  atomic_int clock;         // ticks once as each job starts and finishes
+  int started[FRAME_JOBS], finished[FRAME_JOBS];
+  int spins[FRAME_JOBS];
+  pthread_t mainThread;
+  atomic_int offMain;       // main thread jobs that ran elsewhere
+} frameRecord;
+
+typedef struct {
+  frameRecord *record;
+  int job;
+} jobArg;
+
+static void recordJob(void *arg){
+  jobArg *a = arg;
+  frameRecord *r = a->record;
+  r->started[a->job] = atomic_fetch_add(&r->clock, 1);
+  if (onMainThread[a->job] && !pthread_equal(pthread_self(), r->mainThread)){
+    atomic_fetch_add(&r->offMain, 1);
+  }
+  volatile double sink = 0.0;
+  for (int i = 0; i < r->spins[a->job]; i++) sink += i * 0.5;
+  r->finished[a->job] = atomic_fetch_add(&r->clock, 1);
+}
+
+// returns the number of frames that broke the graph
+static int checkOrder(int workers, int frames){
+  frameRecord record;
+  memset(&record, 0, sizeof(record));
+  record.mainThread = pthread_self();
+  jobArg args[FRAME_JOBS];
+  jobs js = createJobs(workers);
+  for (int i = 0; i < FRAME_JOBS; i++){
+    args[i] = (jobArg){ &record, i };
+    jobsAdd(js, jobNames[i], &recordJob, &args[i], onMainThread[i]);
+  }
+  for (int i = 0; i < DEPENDS; i++) jobsDepend(js, depends[i][0], depends[i][1]);
+
+  int broken = 0;
+  srand(1);
+  for (int frame = 0; frame < frames; frame++){
+    atomic_store(&record.clock, 0);
+    for (int i = 0; i < FRAME_JOBS; i++) record.spins[i] = rand() % 20000;
+    jobsRun(js);
+    for (int i = 0; i < DEPENDS; i++){
+      if (record.started[depends[i][0]] < record.finished[depends[i][1]]){
+        broken++;
+        break;
+      }
+    }
+  }
+  jobStats stats = getJobStats(js);
+  freeJobs(js);
+  int offMain = atomic_load(&record.offMain);
+  printf("  %d workers: %d frames, %.3f ms a frame, %lu steals, %d out of order, "
+         "%d main thread jobs run elsewhere\n",
+         workers, stats.frames, stats.mean * 1000.0, stats.steals, broken, offMain);
+  return broken + offMain;
+}
+
+typedef struct {
+  world w;
+  vec3 eye, reflectionEye;
+  mat4 view, reflectionView, proj;
+} cullFrame;
+
+static void cullMain(void *arg){
+  cullFrame *f = arg;
+  cullWorld(f->w, RENDER_PASS_MAIN, f->eye, &f->view, &f->proj);
+}
+
+static void cullReflection(void *arg){
+  cullFrame *f = arg;
+  cullWorld(f->w, RENDER_PASS_REFLECTION, f->reflectionEye, &f->reflectionView, &f->proj);
+}
+
+// the chunks a pass kept, and its counts, as they were left by the last cull
+typedef struct {
+  passStats stats;
+  int count;
+  chunk *chunks;
+} passResult;
+
+static void takeResult(world w, RENDER_PASS pass, passResult *result){
+  result->stats = getWorldPassStats(w, pass);
+  chunk *visible = getWorldVisibleChunks(w, pass, &result->count);
+  result->chunks = realloc(result->chunks, (result->count + 1) * sizeof(chunk));
+  memcpy(result->chunks, visible, result->count * sizeof(chunk));
+}
+
+static bool sameResult(const passResult *a, const passResult *b){
+  return memcmp(&a->stats, &b->stats, sizeof(passStats)) == 0 && a->count == b->count &&
+         memcmp(a->chunks, b->chunks, a->count * sizeof(chunk)) == 0;
+}
+
+// returns the number of views the two ways disagreed on
+static int checkCulling(int workers, int views){
+  initPerlin();
+  cullFrame f;
+  f.w = createWorld(32, 32, NULL);
+  setWorldRenderDistance(f.w, 10);
+  // a budget no pass comes near, so rasterising never stops early
+  setWorldOcclusion(f.w, 1, 1.0);
+  float fov = 1.0f / tanf(radians(FFOV) / 2.0f), near = 0.05f;
+  memset(&f.proj, 0, sizeof(f.proj));
+  f.proj.m[0][0] = (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT * fov;
+  f.proj.m[1][1] = fov;
+  f.proj.m[2][2] = -(FFAR + near) / (FFAR - near);
+  f.proj.m[2][3] = -(2.0f * FFAR * near) / (FFAR - near);
+  f.proj.m[3][2] = -1.0f;
+
+  jobs js = createJobs(workers);
+  jobsAdd(js, "cull main", &cullMain, &f, false);
+  jobsAdd(js, "cull reflection", &cullReflection, &f, false);
+
+  passResult alone[RENDER_PASSES] = { { { 0 }, 0, NULL } };
+  passResult together[RENDER_PASSES] = { { { 0 }, 0, NULL } };
+  int wrong = 0;
+  double aloneSeconds = 0.0, togetherSeconds = 0.0;
+  vec3 up = vec3Make(0.0f, 1.0f, 0.0f);
+  for (int i = 0; i < views; i++){
+    float yaw = i * 1.7f, pitch = -20.0f + i % 40;
+    f.eye = vec3Make(256.0f + i * 0.3f, 20.0f, 256.0f);
+    vec3 centre = vec3Make(f.eye.x, 0.0f, f.eye.z);
+    centreWorld(f.w, &centre);
+    f.view = mat4LookAt(f.eye, vec3Add(f.eye, frontVector(yaw, pitch)), up);
+    f.reflectionEye  = vec3Make(f.eye.x, 6.0f - f.eye.y, f.eye.z);
+    f.reflectionView = mat4LookAt(f.reflectionEye, vec3Add(f.reflectionEye, frontVector(yaw, -pitch)), up);
+
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    cullMain(&f);
+    cullReflection(&f);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int p = 0; p < RENDER_PASSES; p++) takeResult(f.w, p, &alone[p]);
+    jobsRun(js);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    for (int p = 0; p < RENDER_PASSES; p++) takeResult(f.w, p, &together[p]);
+
+    aloneSeconds    += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    togetherSeconds += (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9;
+    if (!sameResult(&alone[RENDER_PASS_MAIN], &together[RENDER_PASS_MAIN]) ||
+        !sameResult(&alone[RENDER_PASS_REFLECTION], &together[RENDER_PASS_REFLECTION])){
+      wrong++;
+    }
+  }
+  printf("  %d workers: %d views, one after the other %.3f ms, as jobs %.3f ms, %d differed\n",
+         workers, views, aloneSeconds / views * 1000.0, togetherSeconds / views * 1000.0, wrong);
+  for (int p = 0; p < RENDER_PASSES; p++){
+    free(alone[p].chunks);
+    free(together[p].chunks);
+  }
+  freeJobs(js);
+  freeWorld(f.w);
+  return wrong;
+}
+
+int main(int argc, char **argv){
+  int frames = argc > 1 ? atoi(argv[1]) : 2000;
+  if (frames < 10){
+    fprintf(stderr, "usage: %s [frames], at least 10\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  int wrong = 0;
+  printf("main's frame graph\n");
+  for (int workers = 0; workers <= 3; workers++) wrong += checkOrder(workers, frames);
+  printf("both passes culled\n");
+  wrong += checkCulling(JOB_WORKERS, frames / 10);
+  if (wrong > 0){
+    printf("FAILED: %d frames or views went wrong\n", wrong);
+    return EXIT_FAILURE;
+  }
+  printf("every frame kept to the graph and culling matched\n");
+  return EXIT_SUCCESS;
+}
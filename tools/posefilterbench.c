@@ -0,0 +1,115 @@
+/*
+ * Scores the head pose filter on a simulated tracker, without a camera
+ * or a window.
+ *
+ *   ./posefilterbench [minCutoff beta maxLead]
+ *
+ * A 30 Hz tracker with 50 ms of delay and 0.01 rad of noise follows a
+ * head that keeps still, sways, or sways with sudden turns, and frames
+ * are shown at 60 Hz. Each frame's yaw is compared with where the head
+ * really was when it was shown. Prints the RMS error and the jitter (the
+ * RMS change of angular speed between frames) in degrees, for the raw
+ * poses, the filter carrying nothing forward and the filter with its
+ * lead. The filter settings default to main's.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../main.h"
+#include "../tracking/posefilter.h"
+
+#define TRACKER_RATE  30.0
+#define TRACKER_DELAY 0.05
+#define NOISE         0.01
+#define FRAME         (1.0 / 60.0)
+#define SECONDS       60.0
+#define DEGREES       (180.0 / M_PI)
+
+typedef enum { HEAD_STILL, HEAD_SWAY, HEAD_TURNS, HEAD_MOTIONS } headMotion;
+
+static const char *motionNames[HEAD_MOTIONS] = { "still", "smooth 0.3 Hz sway", "sway with sudden turns" };
+
+// where the head really points at time t, in radians
+static double headYaw(headMotion motion, double t){
+  if (motion == HEAD_STILL) return 0.2;
+  if (motion == HEAD_SWAY) return 0.5 * sin(2.0 * M_PI * 0.3 * t);
+  // a half radian turn over 0.4 s every 4 s, held for the rest
+  double yaw = 0.4 * sin(2.0 * M_PI * 0.3 * t);
+  double phase = fmod(t, 4.0);
+  if (phase > 2.0 && phase < 2.4) yaw += 0.5 * (phase - 2.0) / 0.4;
+  else if (phase >= 2.4) yaw += 0.5;
+  return yaw;
+}
+
+static double gaussian(void){
+  double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// filter NULL shows the newest raw pose instead
+static void run(headMotion motion, posefilter filter, double *error, double *jitter){
+  srand(1);
+  double nextSample = 0.0, squared = 0.0, speedChange = 0.0;
+  double lastYaw = 0.0, lastStep = 0.0;
+  float rawYaw = 0.0f;
+  int frames = 0, steps = 0;
+  bool havePose = false;
+  for (double t = 0.0; t < SECONDS; t += FRAME){
+    while (nextSample <= t){
+      facePose pose = { 0 };
+      pose.captured = nextSample - TRACKER_DELAY;
+      pose.yaw = (float)(headYaw(motion, pose.captured) + NOISE * gaussian());
+      if (filter != NULL) poseFilterAdd(filter, &pose);
+      rawYaw = pose.yaw;
+      havePose = true;
+      nextSample += 1.0 / TRACKER_RATE;
+    }
+    float yaw = rawYaw, pitch;
+    if (filter != NULL && !poseFilterPredict(filter, t, &yaw, &pitch)) continue;
+    if (!havePose) continue;
+    if (filter != NULL) poseFilterShown(filter, t + FRAME);
+
+    double miss = yaw - headYaw(motion, t + FRAME);
+    squared += miss * miss;
+    frames++;
+    double step = yaw - lastYaw;
+    if (frames > 2){
+      speedChange += (step - lastStep) * (step - lastStep);
+      steps++;
+    }
+    lastStep = step;
+    lastYaw  = yaw;
+  }
+  *error  = frames > 0 ? sqrt(squared / frames) * DEGREES : 0.0;
+  *jitter = steps > 0 ? sqrt(speedChange / steps) * DEGREES : 0.0;
+}
+
+int main(int argc, char **argv){
+  float minCutoff = argc > 3 ? (float)atof(argv[1]) : HEAD_MIN_CUTOFF;
+  float beta      = argc > 3 ? (float)atof(argv[2]) : HEAD_BETA;
+  float maxLead   = argc > 3 ? (float)atof(argv[3]) : HEAD_MAX_LEAD;
+  if (argc != 1 && argc != 4){
+    fprintf(stderr, "usage: %s [minCutoff beta maxLead]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  printf("%.0f Hz tracker, %.0f ms delay, %.2f rad noise, shown at %.0f Hz\n",
+         TRACKER_RATE, TRACKER_DELAY * 1000.0, NOISE, 1.0 / FRAME);
+  printf("filter at %.2f Hz, beta %.2f, lead up to %.0f ms; error / jitter in degrees\n",
+         minCutoff, beta, maxLead * 1000.0);
+  printf("%-24s %15s %17s %17s\n", "head", "raw pose", "filter, no lead", "filter with lead");
+  for (int motion = 0; motion < HEAD_MOTIONS; motion++){
+    double error[3], jitter[3];
+    run(motion, NULL, &error[0], &jitter[0]);
+    posefilter f = createPoseFilter(minCutoff, beta, 0.0f);
+    run(motion, f, &error[1], &jitter[1]);
+    freePoseFilter(f);
+    f = createPoseFilter(minCutoff, beta, maxLead);
+    run(motion, f, &error[2], &jitter[2]);
+    freePoseFilter(f);
+    printf("%-24s %7.2f / %5.2f %9.2f / %5.2f %9.2f / %5.2f\n", motionNames[motion],
+           error[0], jitter[0], error[1], jitter[1], error[2], jitter[2]);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/*
+ * Measures how many rays a second raycast and raycastBatch trace through
+ * generated terrain, without opening a window.
+ *
+ *   ./raybench [rays] [chunks]
+ *
+ * rays (default 1000000) are cast in each test over a world chunks wide
+ * (default 16): picks from head height in random directions, then line
+ * of sight checks from one spot to random points on the ground.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../world/world.h"
+#include "../world/raycast.h"
+
+#define PICK_DISTANCE  64.0f
+#define SIGHT_SOURCES  64     // line of sight batches, one per spot
+
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float randomBetween(float lo, float hi){
+  return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+static void report(const char *name, int count, const rayHit *hits, double seconds){
+  int hit = 0;
+  double distance = 0.0;
+  for (int i = 0; i < count; i++){
+    if (!hits[i].hit) continue;
+    hit++;
+    distance += hits[i].distance;
+  }
+  printf("%-16s %10.0f rays/s  %5.1f%% hit, %.1f blocks to a hit on average\n",
+         name, count / seconds, 100.0 * hit / count, hit > 0 ? distance / hit : 0.0);
+}
+
+int main(int argc, char **argv){
+  int count = argc > 1 ? atoi(argv[1]) : 1000000;
+  int size  = argc > 2 ? atoi(argv[2]) : 16;
+  if (count <= 0 || size <= 0){
+    fprintf(stderr, "usage: %s [rays] [chunks]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  world w = createWorld(size, size, NULL);
+  float span = (float)size * CHUNK_SIZE_X;
+  vec3 centre = vec3Make(span / 2.0f, CHUNK_SIZE_Y, span / 2.0f);
+  centreWorld(w, &centre);
+
+  ray *rays = malloc(sizeof(ray) * count);
+  rayHit *hits = malloc(sizeof(rayHit) * count);
+  if (rays == NULL || hits == NULL){
+    fprintf(stderr, "Cannot allocate %d rays\n", count);
+    return EXIT_FAILURE;
+  }
+  srand(1);
+  for (int i = 0; i < count; i++){
+    rays[i].origin = vec3Make(randomBetween(0.0f, span), randomBetween(8.0f, 15.0f),
+                              randomBetween(0.0f, span));
+    rays[i].direction = vec3Make(randomBetween(-1.0f, 1.0f), randomBetween(-1.0f, 0.5f),
+                                 randomBetween(-1.0f, 1.0f));
+    rays[i].maxDistance = PICK_DISTANCE;
+    rays[i].throughWater = false;
+  }
+  double start = now();
+  for (int i = 0; i < count; i++) hits[i] = raycast(w, &rays[i]);
+  report("picks", count, hits, now() - start);
+
+  start = now();
+  raycastBatch(w, rays, hits, count);
+  report("picks, batched", count, hits, now() - start);
+
+  // many checks from the same spot, towards points on the ground
+  int perSource = count / SIGHT_SOURCES;
+  for (int s = 0; s < SIGHT_SOURCES; s++){
+    vec3 eye = vec3Make(randomBetween(0.0f, span), 15.0f, randomBetween(0.0f, span));
+    for (int i = s * perSource; i < (s + 1) * perSource; i++){
+      vec3 target = vec3Make(randomBetween(0.0f, span), 4.0f, randomBetween(0.0f, span));
+      rays[i].origin = eye;
+      rays[i].direction = vec3Sub(target, eye);
+      rays[i].maxDistance = vec3Length(rays[i].direction);
+      rays[i].throughWater = true;
+    }
+  }
+  start = now();
+  for (int s = 0; s < SIGHT_SOURCES; s++){
+    raycastBatch(w, rays + s * perSource, hits + s * perSource, perSource);
+  }
+  report("line of sight", perSource * SIGHT_SOURCES, hits, now() - start);
+
+  free(rays);
+  free(hits);
+  freeWorld(w);
+  return EXIT_SUCCESS;
+}
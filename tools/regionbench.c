@@ -0,0 +1,135 @@
+/*
+ * Measures loading chunks back from region files against generating
+ * them again, without opening a window.
+ *
+ *   ./regionbench [width] [edits]
+ *
+ * A square of width x width chunks (default 48) is generated and given
+ * edits (default 5000) random block changes, saved to region files in
+ * a scratch directory under /tmp and loaded back. Prints how long each
+ * step took and how small the files came out, and checks every chunk
+ * came back byte for byte. The scratch directory is removed afterwards.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../world/chunk.h"
+#include "../world/region.h"
+
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// adds up the size of every file in dir, and removes them if asked
+static long filesIn(const char *dir, bool remove){
+  DIR *d = opendir(dir);
+  if (d == NULL) return 0;
+  long bytes = 0;
+  char path[512];
+  struct dirent *entry;
+  struct stat st;
+  while ((entry = readdir(d)) != NULL){
+    if (entry->d_name[0] == '.') continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    if (stat(path, &st) == 0) bytes += st.st_size;
+    if (remove) unlink(path);
+  }
+  closedir(d);
+  return bytes;
+}
+
+int main(int argc, char **argv){
+  int width = argc > 1 ? atoi(argv[1]) : 48;
+  int edits = argc > 2 ? atoi(argv[2]) : 5000;
+  if (width <= 0 || edits < 0){
+    fprintf(stderr, "usage: %s [width] [edits]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  char dir[] = "/tmp/regionbench.XXXXXX";
+  if (mkdtemp(dir) == NULL){
+    perror(dir);
+    return EXIT_FAILURE;
+  }
+  int count = width * width;
+  chunk *chunks = malloc(count * sizeof(chunk));
+  if (chunks == NULL){
+    fprintf(stderr, "Out of memory for %d chunks\n", count);
+    return EXIT_FAILURE;
+  }
+
+  double start = now();
+  for (int i = 0; i < count; i++){
+    chunks[i] = createChunk((float)(i / width) * CHUNK_SIZE_X, 0.0f, (float)(i % width) * CHUNK_SIZE_Z);
+  }
+  double generate = now() - start;
+
+  srand(1);
+  for (int i = 0; i < edits; i++){
+    setChunkBlock(chunks[rand() % count], rand() % CHUNK_SIZE_X, rand() % CHUNK_SIZE_Y,
+                  rand() % CHUNK_SIZE_Z, (BLOCK_TYPE)(rand() % BLOCK_NULL));
+  }
+
+  start = now();
+  regionstore store = openRegionStore(dir);
+  for (int i = 0; i < count; i++) regionStoreSave(store, i / width, i % width, getChunkBlocks(chunks[i]));
+  regionStoreFlush(store);
+  closeRegionStore(store);
+  double save = now() - start;
+  long stored = filesIn(dir, false);
+
+  int wrong = 0;
+  chunk *loaded = malloc(count * sizeof(chunk));
+  if (loaded == NULL){
+    fprintf(stderr, "Out of memory for %d chunks\n", count);
+    return EXIT_FAILURE;
+  }
+  uint8_t blocks[CHUNK_BLOCK_BYTES];
+  start = now();
+  store = openRegionStore(dir);
+  for (int i = 0; i < count; i++){
+    loaded[i] = NULL;
+    if (regionStoreLoad(store, i / width, i % width, blocks)){
+      loaded[i] = createChunkFromBlocks((float)(i / width) * CHUNK_SIZE_X, 0.0f,
+                                        (float)(i % width) * CHUNK_SIZE_Z, blocks);
+    }
+  }
+  closeRegionStore(store);
+  double load = now() - start;
+
+  for (int i = 0; i < count; i++){
+    if (loaded[i] == NULL){
+      wrong++;
+      continue;
+    }
+    if (memcmp(getChunkBlocks(loaded[i]), getChunkBlocks(chunks[i]), CHUNK_BLOCK_BYTES) != 0) wrong++;
+    freeChunk(loaded[i]);
+  }
+  free(loaded);
+
+  printf("%dx%d chunks, %d edits\n", width, width, edits);
+  printf("  generate %8.1f ms  %7.1fk chunks/s\n", generate * 1000.0, count / generate / 1000.0);
+  printf("  load     %8.1f ms  %7.1fk chunks/s, %.0fx faster than generating\n",
+         load * 1000.0, count / load / 1000.0, generate / load);
+  printf("  save     %8.1f ms\n", save * 1000.0);
+  printf("  %.1f MB of blocks stored in %ld KB\n",
+         (double)count * CHUNK_BLOCK_BYTES / (1024.0 * 1024.0), stored / 1024);
+
+  for (int i = 0; i < count; i++) freeChunk(chunks[i]);
+  free(chunks);
+  releaseChunkPool();
+  filesIn(dir, true);
+  rmdir(dir);
+  if (wrong > 0){
+    printf("FAILED: %d chunks did not come back as saved\n", wrong);
+    return EXIT_FAILURE;
+  }
+  printf("every chunk came back byte for byte\n");
+  return EXIT_SUCCESS;
+}
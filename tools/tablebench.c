@@ -0,0 +1,148 @@
+/*
+ * Measures what a table insert, lookup and delete cost, with int and
+ * string keys, and what the same string keys cost through hash.h.
+ *
+ *   ./tablebench [keys...]
+ *
+ * For each count of keys (default 10000 and 1000000) the keys are
+ * inserted in order, looked up in a shuffled order and then deleted in
+ * another, and the time each operation took on average is printed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../adts/table.h"
+#include "../adts/hash.h"
+
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void shuffle(int *order, int count){
+  for (int i = count - 1; i > 0; i--){
+    int j = rand() % (i + 1);
+    int t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+}
+
+static void report(const char *name, int count, double insert, double lookup, double remove, long found){
+  printf("%-8s %8d keys: insert %7.1f ns, lookup %7.1f ns, delete %7.1f ns%s\n",
+         name, count, insert / count * 1e9, lookup / count * 1e9, remove / count * 1e9,
+         found == count ? "" : "  (lost keys!)");
+}
+
+static void benchInt(int count, int *order){
+  table t = tableCreate(TABLE_KEY_INT, 0, NULL);
+  double start = now();
+  for (int64_t i = 0; i < count; i++) tableSet(t, &i, (tablevalue)(intptr_t)(i + 1));
+  double insert = now() - start;
+
+  shuffle(order, count);
+  long found = 0;
+  start = now();
+  for (int i = 0; i < count; i++){
+    int64_t key = order[i];
+    if (tableFind(t, &key) != NULL) found++;
+  }
+  double lookup = now() - start;
+
+  shuffle(order, count);
+  start = now();
+  for (int i = 0; i < count; i++){
+    int64_t key = order[i];
+    tableRemove(t, &key);
+  }
+  double remove = now() - start;
+  tableFree(t);
+  report("int", count, insert, lookup, remove, found);
+}
+
+static void benchString(int count, int *order, char (*keys)[16]){
+  table t = tableCreate(TABLE_KEY_STRING, 0, NULL);
+  double start = now();
+  for (int i = 0; i < count; i++) tableSet(t, keys[i], (tablevalue)(intptr_t)(i + 1));
+  double insert = now() - start;
+
+  shuffle(order, count);
+  long found = 0;
+  start = now();
+  for (int i = 0; i < count; i++){
+    if (tableFind(t, keys[order[i]]) != NULL) found++;
+  }
+  double lookup = now() - start;
+
+  shuffle(order, count);
+  start = now();
+  for (int i = 0; i < count; i++) tableRemove(t, keys[order[i]]);
+  double remove = now() - start;
+  tableFree(t);
+  report("string", count, insert, lookup, remove, found);
+}
+
+// a NULL free function makes hash.h free() the values
+static void keepValue(hashvalue v){
+  (void)v;
+}
+
+// hash.h has no delete, so the last column is freeing the whole hash
+static void benchHash(int count, int *order, char (*keys)[16]){
+  hash h = hashCreate(NULL, keepValue, NULL);
+  double start = now();
+  for (int i = 0; i < count; i++) hashSet(h, keys[i], (hashvalue)(intptr_t)(i + 1));
+  double insert = now() - start;
+
+  shuffle(order, count);
+  long found = 0;
+  start = now();
+  for (int i = 0; i < count; i++){
+    if (hashFind(h, keys[order[i]]) != NULL) found++;
+  }
+  double lookup = now() - start;
+
+  start = now();
+  hashFree(h);
+  double remove = now() - start;
+  report("hash.h", count, insert, lookup, remove, found);
+}
+
+static void bench(int count){
+  int *order = malloc(count * sizeof(int));
+  char (*keys)[16] = malloc(count * sizeof(*keys));
+  if (order == NULL || keys == NULL){
+    fprintf(stderr, "Out of memory for %d keys\n", count);
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < count; i++){
+    order[i] = i;
+    snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+  }
+  srand(1);
+  benchInt(count, order);
+  benchString(count, order, keys);
+  benchHash(count, order, keys);
+  free(order);
+  free(keys);
+}
+
+int main(int argc, char **argv){
+  for (int i = 1; i < argc; i++){
+    if (atoi(argv[i]) <= 0){
+      fprintf(stderr, "usage: %s [keys...]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (argc > 1){
+    for (int i = 1; i < argc; i++) bench(atoi(argv[i]));
+  } else {
+    bench(10000);
+    bench(1000000);
+  }
+  return EXIT_SUCCESS;
+}
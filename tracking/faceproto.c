@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "faceproto.h"
+
+// the wire is little endian, like every machine the tracker runs on
+static uint16_t read16(const uint8_t *p){ return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t read32(const uint8_t *p){ return (uint32_t)read16(p) | (uint32_t)read16(p + 2) << 16; }
+static uint64_t read64(const uint8_t *p){ return (uint64_t)read32(p) | (uint64_t)read32(p + 4) << 32; }
+
+static void write16(uint8_t *p, uint16_t v){ p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void write32(uint8_t *p, uint32_t v){ write16(p, (uint16_t)v); write16(p + 2, (uint16_t)(v >> 16)); }
+static void write64(uint8_t *p, uint64_t v){ write32(p, (uint32_t)v); write32(p + 4, (uint32_t)(v >> 32)); }
+
+bool faceProtoCheck(const void *data, int len, faceDatagram *d){
+  const uint8_t *bytes = data;
+  int floatCount;
+  if (len >= FACE_PROTO_HEADER && read32(bytes) == FACE_PROTO_MAGIC){
+    d->version = bytes[4];
+    if (d->version != FACE_PROTO_VERSION) return false;
+    d->landmarks = read16(bytes + 6);
+    d->sequence  = read32(bytes + 8);
+    d->captureNs = read64(bytes + 16);
+    d->sendNs    = read64(bytes + 24);
+    d->floats    = (const float *)(bytes + FACE_PROTO_HEADER);
+    floatCount   = d->landmarks * 3 + 2;
+    if (len != FACE_PROTO_HEADER + floatCount * (int)sizeof(float)) return false;
+  } else {
+    if (len % sizeof(float) != 0 || len < 2 * (int)sizeof(float)) return false;
+    d->version   = 0;
+    d->landmarks = (len / (int)sizeof(float) - 2) / 3;
+    d->sequence  = 0;
+    d->captureNs = 0;
+    d->sendNs    = 0;
+    d->floats    = data;
+  }
+  float yaw   = d->floats[d->landmarks * 3];
+  float pitch = d->floats[d->landmarks * 3 + 1];
+  return isfinite(yaw) && isfinite(pitch);
+}
+
+void faceProtoPose(const faceDatagram *d, facePose *pose){
+  const float *floats = d->floats;
+  pose->yaw   = floats[d->landmarks * 3];
+  pose->pitch = floats[d->landmarks * 3 + 1];
+  int count = d->landmarks < FACE_MAX_POINTS ? d->landmarks : FACE_MAX_POINTS;
+  for (int i = 0; i < count; i++){
+    pose->points[i] = (Point3D){ floats[i * 3 + 0], floats[i * 3 + 1], floats[i * 3 + 2] };
+  }
+  pose->count = count;
+}
+
+void faceProtoRestamp(void *data, uint64_t captureNs, uint64_t sendNs){
+  uint8_t *bytes = data;
+  write64(bytes + 16, captureNs);
+  write64(bytes + 24, sendNs);
+}
+
+int faceProtoEncode(const facePose *pose, uint32_t sequence,
+                    uint64_t captureNs, uint64_t sendNs, void *data, int size){
+  int floatCount = pose->count * 3 + 2;
+  int len = FACE_PROTO_HEADER + floatCount * (int)sizeof(float);
+  if (len > size) return 0;
+
+  uint8_t *bytes = data;
+  write32(bytes, FACE_PROTO_MAGIC);
+  bytes[4] = FACE_PROTO_VERSION;
+  bytes[5] = 0;
+  write16(bytes + 6, (uint16_t)pose->count);
+  write32(bytes + 8, sequence);
+  write32(bytes + 12, 0);
+  write64(bytes + 16, captureNs);
+  write64(bytes + 24, sendNs);
+  float *floats = (float *)(bytes + FACE_PROTO_HEADER);
+  for (int i = 0; i < pose->count; i++){
+    floats[i * 3 + 0] = pose->points[i].x;
+    floats[i * 3 + 1] = pose->points[i].y;
+    floats[i * 3 + 2] = pose->points[i].z;
+  }
+  floats[pose->count * 3]     = pose->yaw;
+  floats[pose->count * 3 + 1] = pose->pitch;
+  return len;
+}
@@ -0,0 +1,60 @@
+#ifndef FACEPROTO_H
+#define FACEPROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "facerecv.h"
+
+/*
+ * The face tracking datagram. Version 1 starts with a 32 byte header,
+ * all fields little endian:
+ *
+ *   0  uint32  magic, the bytes "FTRK"
+ *   4  uint8   version
+ *   5  uint8   flags, none defined yet
+ *   6  uint16  landmark count
+ *   8  uint32  sequence, one up per pose, wrapping
+ *   12 uint32  reserved, zero
+ *   16 uint64  capture time, nanoseconds on the sender's monotonic clock
+ *   24 uint64  send time, on the same clock
+ *   32 float   x, y, z per landmark, then yaw and pitch in radians
+ *
+ * The capture and send times share the sender's clock, so send - capture
+ * is the tracker's own delay even when the two machines' clocks differ.
+ *
+ * Datagrams that do not start with the magic are read as version 0, the
+ * bare floats the tracker first sent: (length / 4 - 2) / 3 landmarks,
+ * then yaw and pitch. A landmark x is never near the magic read as a float.
+ *
+ * The landmark count field goes up to 65535, but a UDP datagram carries
+ * at most 65507 bytes, so no more than 5455 landmarks arrive in one.
+ * FACE_PROTO_MAX_DATAGRAM holds any datagram, so a receiver with a buffer
+ * that big never cuts one short.
+ */
+#define FACE_PROTO_MAGIC   0x4b525446u   // "FTRK"
+#define FACE_PROTO_VERSION 1
+#define FACE_PROTO_HEADER  32
+#define FACE_PROTO_MAX_DATAGRAM 65536
+
+typedef struct {
+  int version;
+  uint32_t sequence;        // 0 for version 0
+  uint64_t captureNs;       // 0 for version 0
+  uint64_t sendNs;
+  int landmarks;            // in the datagram, may be more than FACE_MAX_POINTS
+  const float *floats;      // the landmarks, yaw and pitch, inside the datagram
+} faceDatagram;
+
+// false when the datagram is not a whole pose of a version we read.
+// data must be aligned for floats
+extern bool faceProtoCheck(const void *data, int len, faceDatagram *d);
+// copies the points, yaw and pitch out of a checked datagram
+extern void faceProtoPose(const faceDatagram *d, facePose *pose);
+// rewrites the times of a version 1 datagram in place
+extern void faceProtoRestamp(void *data, uint64_t captureNs, uint64_t sendNs);
+// the size of a version 1 datagram for the pose, 0 when size is too small
+extern int faceProtoEncode(const facePose *pose, uint32_t sequence,
+                           uint64_t captureNs, uint64_t sendNs, void *data, int size);
+
+#endif
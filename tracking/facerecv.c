@@ -0,0 +1,342 @@
+#define _GNU_SOURCE   // recvmmsg
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "facerecv.h"
+#include "faceshm.h"
+#include "faceproto.h"
+
+#define BATCH         16    // datagrams taken from the socket per call
+#define WAKE_SECONDS  0.1   // how often a blocked receive looks for quit
+#define FRESH         4     // set on the mailbox while the reader has not taken it
+#define SHM_RETRY     1.0   // seconds between looks for a shared memory producer
+#define SHM_STALE     0.5   // seconds without a pose before it is given up on
+#define OFFSET_WINDOW 10.0  // seconds over which the sender's clock offset is found
+#define RESTART_GAP   64    // a sequence this far back means the sender started over
+
+struct facereceiver {
+  int sockfd;
+  pthread_t thread;
+  atomic_bool quit;
+  // Triple buffering: the thread writes slots[back], swaps it into the
+  // mailbox, and the reader swaps its own front slot with the mailbox
+  // when FRESH is set. Nobody ever waits on anyone.
+  facePose slots[3];
+  atomic_int mailbox;
+  int back;             // receiver thread only
+  int front;            // reader only
+  // counters written by the thread
+  atomic_ulong received;
+  atomic_ulong invalid;
+  atomic_ulong superseded;
+  atomic_ulong kernelDropped;
+  atomic_ulong batches;
+  atomic_ulong valid;
+  atomic_ulong late;
+  atomic_ulong lost;
+  // reader only
+  double age, maxAge;
+  unsigned long lastValid;
+  double lastStatsTime;
+  // the shared memory transport, preferred while its producer is writing
+  char *shmName;
+  faceshm shm;
+  double shmAttempt;    // when the segment was last looked for
+  double shmPoseTime;   // when it last gave a pose
+  unsigned long shmPoses;
+  unsigned long readerSuperseded;   // poses the reader passed over
+  bool fromShm;         // where the last pose read came from
+  // receiver thread only
+  bool haveSequence;
+  uint32_t newestSequence;
+  double offsetCurrent, offsetPrevious, offsetStart;
+  float buffers[BATCH][FACE_PROTO_MAX_DATAGRAM / sizeof(float)];
+#ifdef SO_RXQ_OVFL
+  char controls[BATCH][CMSG_SPACE(sizeof(uint32_t))];
+#endif
+};
+
+double faceClockSeconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Our clock minus the sender's is taken as the smallest gap seen between
+// a datagram being sent and arriving, over the last two windows so the
+// estimate follows the clocks drifting apart.
+static double senderOffset(facereceiver r, double now, uint64_t sendNs){
+  double gap = now - sendNs * 1e-9;
+  if (now - r->offsetStart > OFFSET_WINDOW){
+    r->offsetPrevious = r->offsetCurrent;
+    r->offsetCurrent  = gap;
+    r->offsetStart    = now;
+  } else if (gap < r->offsetCurrent){
+    r->offsetCurrent = gap;
+  }
+  return r->offsetCurrent < r->offsetPrevious ? r->offsetCurrent : r->offsetPrevious;
+}
+
+// true when a datagram with this sequence is newer than any before it
+static bool sequenceNewer(facereceiver r, uint32_t sequence, unsigned long *lost){
+  int32_t ahead = (int32_t)(sequence - r->newestSequence);
+  if (r->haveSequence && ahead <= 0 && ahead > -RESTART_GAP) return false;
+  if (r->haveSequence && ahead > 1 && ahead < RESTART_GAP) *lost += ahead - 1;
+  r->haveSequence = true;
+  r->newestSequence = sequence;
+  return true;
+}
+
+static void *receiveLoop(void *arg){
+  facereceiver r = arg;
+  struct mmsghdr msgs[BATCH];
+  struct iovec iovs[BATCH];
+
+  while (!atomic_load(&r->quit)){
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < BATCH; i++){
+      iovs[i].iov_base = r->buffers[i];
+      iovs[i].iov_len  = sizeof(r->buffers[i]);
+      msgs[i].msg_hdr.msg_iov    = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef SO_RXQ_OVFL
+      msgs[i].msg_hdr.msg_control    = r->controls[i];
+      msgs[i].msg_hdr.msg_controllen = sizeof(r->controls[i]);
+#endif
+    }
+    // blocks for the first datagram, then takes whatever else is queued
+    int n = recvmmsg(r->sockfd, msgs, BATCH, MSG_WAITFORONE, NULL);
+    if (n <= 0) continue;   // timed out, look at quit again
+    double now = faceClockSeconds();
+    atomic_fetch_add_explicit(&r->batches, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&r->received, n, memory_order_relaxed);
+
+#ifdef SO_RXQ_OVFL
+    // the kernel's running count of datagrams it had no room for
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msgs[n - 1].msg_hdr);
+    for (; cm != NULL; cm = CMSG_NXTHDR(&msgs[n - 1].msg_hdr, cm)){
+      if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL){
+        uint32_t dropped;
+        memcpy(&dropped, CMSG_DATA(cm), sizeof(dropped));
+        atomic_store_explicit(&r->kernelDropped, dropped, memory_order_relaxed);
+      }
+    }
+#endif
+
+    // only the newest valid datagram of the batch is kept
+    int kept = -1;
+    faceDatagram keptDatagram;
+    unsigned long invalid = 0, late = 0, lost = 0;
+    for (int i = 0; i < n; i++){
+      faceDatagram d;
+      // cannot happen with buffers this size, but would not be a whole pose
+      bool truncated = msgs[i].msg_hdr.msg_flags & MSG_TRUNC;
+      if (truncated || !faceProtoCheck(r->buffers[i], msgs[i].msg_len, &d)){
+        invalid++;
+      } else if (d.version > 0 && !sequenceNewer(r, d.sequence, &lost)){
+        late++;   // overtaken on the way here
+      } else {
+        kept = i;
+        keptDatagram = d;
+      }
+    }
+    if (invalid > 0) atomic_fetch_add_explicit(&r->invalid, invalid, memory_order_relaxed);
+    if (late > 0) atomic_fetch_add_explicit(&r->late, late, memory_order_relaxed);
+    if (lost > 0) atomic_fetch_add_explicit(&r->lost, lost, memory_order_relaxed);
+    if (kept < 0) continue;
+
+    unsigned long valid = n - invalid - late;
+    if (valid > 1) atomic_fetch_add_explicit(&r->superseded, valid - 1, memory_order_relaxed);
+    unsigned long count = atomic_fetch_add_explicit(&r->valid, valid, memory_order_relaxed) + valid;
+
+    facePose *pose = &r->slots[r->back];
+    faceProtoPose(&keptDatagram, pose);
+    if (keptDatagram.version > 0){
+      pose->captured = keptDatagram.captureNs * 1e-9 + senderOffset(r, now, keptDatagram.sendNs);
+      pose->sequence = keptDatagram.sequence;
+    } else {
+      pose->captured = now;
+      pose->sequence = count;
+    }
+    int old = atomic_exchange(&r->mailbox, r->back | FRESH);
+    if (old & FRESH) atomic_fetch_add_explicit(&r->superseded, 1, memory_order_relaxed);
+    r->back = old & ~FRESH;
+  }
+  return NULL;
+}
+
+// -1 when the port cannot be bound
+static int openSocket(int port){
+  int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sockfd < 0){
+    perror("face receiver socket");
+    return -1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = INADDR_ANY;
+  if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    fprintf(stderr, "Face poses over UDP off, cannot bind port %d\n", port);
+    close(sockfd);
+    return -1;
+  }
+  struct timeval wake = { 0, (long)(WAKE_SECONDS * 1e6) };
+  setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &wake, sizeof(wake));
+#ifdef SO_RXQ_OVFL
+  int on = 1;
+  setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+#endif
+  return sockfd;
+}
+
+facereceiver createFaceReceiver(int port, const char *shmName){
+  int sockfd = openSocket(port);
+  if (sockfd < 0 && shmName == NULL) return NULL;
+
+  facereceiver new = malloc(sizeof(struct facereceiver));
+  assert(new != NULL);
+  memset(new->slots, 0, sizeof(new->slots));
+  new->sockfd = sockfd;
+  atomic_init(&new->quit, false);
+  atomic_init(&new->mailbox, 0);
+  new->back  = 1;
+  new->front = 2;
+  atomic_init(&new->received, 0);
+  atomic_init(&new->invalid, 0);
+  atomic_init(&new->superseded, 0);
+  atomic_init(&new->kernelDropped, 0);
+  atomic_init(&new->batches, 0);
+  atomic_init(&new->valid, 0);
+  atomic_init(&new->late, 0);
+  atomic_init(&new->lost, 0);
+  new->haveSequence = false;
+  new->newestSequence = 0;
+  new->offsetCurrent = new->offsetPrevious = INFINITY;
+  new->offsetStart = faceClockSeconds();
+  new->age = 0.0;
+  new->maxAge = 0.0;
+  new->lastValid = 0;
+  new->lastStatsTime = faceClockSeconds();
+  new->shmName = shmName != NULL ? strdup(shmName) : NULL;
+  new->shm = NULL;
+  new->shmAttempt = -SHM_RETRY;
+  new->shmPoseTime = 0.0;
+  new->shmPoses = 0;
+  new->readerSuperseded = 0;
+  new->fromShm = false;
+
+  if (sockfd >= 0 && pthread_create(&new->thread, NULL, receiveLoop, new) != 0){
+    fprintf(stderr, "Face poses over UDP off, cannot start the receiver thread\n");
+    close(sockfd);
+    new->sockfd = -1;
+  }
+  if (new->sockfd < 0 && shmName == NULL){
+    free(new);
+    return NULL;
+  }
+  return new;
+}
+
+void freeFaceReceiver(facereceiver r){
+  if (r->sockfd >= 0){
+    atomic_store(&r->quit, true);
+    pthread_join(r->thread, NULL);
+    close(r->sockfd);
+  }
+  if (r->shm != NULL) closeFaceShm(r->shm);
+  free(r->shmName);
+  free(r);
+}
+
+// the newest pose from the receiver thread, if it has one we have not seen
+static bool takeMailbox(facereceiver r, facePose *pose){
+  if (r->sockfd < 0 || !(atomic_load(&r->mailbox) & FRESH)) return false;
+  // only the thread touches the mailbox besides us, and it leaves FRESH set
+  r->front = atomic_exchange(&r->mailbox, r->front) & ~FRESH;
+  *pose = r->slots[r->front];
+  return true;
+}
+
+// true when the pose came from a shared memory producer that is still
+// writing, which UDP then gives way to
+static bool takeShm(facereceiver r, facePose *pose, double now){
+  if (r->shmName == NULL) return false;
+  if (r->shm == NULL){
+    if (now - r->shmAttempt < SHM_RETRY) return false;
+    r->shmAttempt = now;
+    r->shm = openFaceShm(r->shmName);
+    if (r->shm == NULL) return false;
+    r->shmPoseTime = now;   // the producer gets a moment to write
+  }
+
+  unsigned long skipped;
+  if (faceShmLatest(r->shm, pose, &skipped)){
+    r->shmPoses += skipped + 1;
+    r->readerSuperseded += skipped;
+    r->shmPoseTime = now;
+    return true;
+  }
+  if (now - r->shmPoseTime > SHM_STALE){
+    // the producer stopped, or a new one replaced the segment
+    closeFaceShm(r->shm);
+    r->shm = NULL;
+  }
+  return false;
+}
+
+bool faceReceiverLatest(facereceiver r, facePose *pose){
+  double now = faceClockSeconds();
+  bool fresh = false;
+  if (takeShm(r, pose, now)){
+    fresh = true;
+    r->fromShm = true;
+  } else if (r->shm == NULL && takeMailbox(r, pose)){
+    fresh = true;
+    r->fromShm = false;
+  }
+  // while a shared memory producer is live, poses over UDP are only counted
+  facePose ignored;
+  if (r->shm != NULL && takeMailbox(r, &ignored)) r->readerSuperseded++;
+  if (!fresh) return false;
+
+  r->age = now - pose->captured;
+  if (r->age > r->maxAge) r->maxAge = r->age;
+  return true;
+}
+
+faceRecvStats getFaceReceiverStats(facereceiver r){
+  faceRecvStats stats;
+  stats.received      = atomic_load_explicit(&r->received, memory_order_relaxed);
+  stats.invalid       = atomic_load_explicit(&r->invalid, memory_order_relaxed);
+  stats.superseded    = atomic_load_explicit(&r->superseded, memory_order_relaxed) + r->readerSuperseded;
+  stats.kernelDropped = atomic_load_explicit(&r->kernelDropped, memory_order_relaxed);
+  stats.batches       = atomic_load_explicit(&r->batches, memory_order_relaxed);
+  stats.late          = atomic_load_explicit(&r->late, memory_order_relaxed);
+  stats.lost          = atomic_load_explicit(&r->lost, memory_order_relaxed);
+
+  double now = faceClockSeconds();
+  unsigned long valid = atomic_load_explicit(&r->valid, memory_order_relaxed) + r->shmPoses;
+  double elapsed = now - r->lastStatsTime;
+  stats.rate   = elapsed > 0.0 ? (valid - r->lastValid) / elapsed : 0.0;
+  stats.age    = r->age;
+  stats.maxAge = r->maxAge;
+  stats.shared = r->fromShm;
+  stats.retries = r->shm != NULL ? faceShmRetries(r->shm) : 0;
+  r->lastValid     = valid;
+  r->lastStatsTime = now;
+  r->maxAge        = 0.0;
+  return stats;
+}
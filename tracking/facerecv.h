@@ -0,0 +1,61 @@
+#ifndef FACERECV_H
+#define FACERECV_H
+
+#include <stdbool.h>
+
+/*
+ * Receives head poses from the face tracker (face.py) on a thread of its
+ * own. The datagrams are described in faceproto.h.
+ *
+ * The thread drains the socket in batches, so poses never queue up
+ * behind each other, and keeps only the newest valid one. It is handed
+ * over through a single slot mailbox without locks: a pose that is not
+ * read before the next one arrives is dropped, never delayed.
+ *
+ * A tracker on the same machine can write to shared memory instead (see
+ * faceshm.h), which is read without system calls. While such a producer
+ * is writing it is preferred, and UDP is the fallback.
+ */
+struct facereceiver;
+typedef struct facereceiver *facereceiver;
+
+#define FACE_MAX_POINTS 32
+
+typedef struct { float x, y, z; } Point3D;
+
+typedef struct {
+  Point3D points[FACE_MAX_POINTS];
+  int count;
+  float yaw, pitch;
+  // CLOCK_MONOTONIC seconds the camera saw it, less the smallest time in
+  // transit, or when it arrived for datagrams without a timestamp
+  double captured;
+  unsigned long sequence; // the sender's, or counting valid poses
+} facePose;
+
+typedef struct {
+  unsigned long received;      // datagrams read off the socket
+  unsigned long invalid;       // of those, not holding a pose
+  unsigned long superseded;    // valid poses replaced before they were read
+  unsigned long kernelDropped; // lost to a full socket buffer before we saw them
+  unsigned long batches;       // reads that returned at least one datagram
+  unsigned long late;          // arrived after a newer pose, and ignored
+  unsigned long lost;          // skipped in the sequence numbers, late ones included
+  double rate;                 // valid poses a second since the last call
+  double age;                  // seconds from capturing the last pose read to reading it
+  double maxAge;               // the oldest pose read since the last call
+  bool shared;                 // the last pose came through shared memory
+  unsigned long retries;       // shared memory reads that met the writer
+} faceRecvStats;
+
+// shmName is the shared memory segment to look for, NULL for UDP only.
+// NULL when there is neither, face tracking is then off
+extern facereceiver createFaceReceiver(int port, const char *shmName);
+extern void freeFaceReceiver(facereceiver r);
+// true and fills pose when a newer one arrived since the last call
+extern bool faceReceiverLatest(facereceiver r, facePose *pose);
+// rate and maxAge are measured over the time since the previous call
+extern faceRecvStats getFaceReceiverStats(facereceiver r);
+extern double faceClockSeconds(void);
+
+#endif
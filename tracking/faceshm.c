@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "faceshm.h"
+
+#define MAGIC    0x45434146u  // "FACE"
+#define VERSION  1u
+#define SLOTS    8            // the writer must lap the ring to spoil a read
+#define TRIES    4
+
+// the words of a slot: count, yaw, pitch, the stamp in two halves, points
+enum { WORD_COUNT, WORD_YAW, WORD_PITCH, WORD_STAMP_LO, WORD_STAMP_HI, WORD_POINTS };
+#define WORDS (WORD_POINTS + 3 * FACE_MAX_POINTS)
+
+// Every word is an atomic so a reader overlapping the writer is defined
+// behaviour; relaxed loads and stores compile to plain moves.
+typedef struct {
+  _Alignas(64) atomic_uint seq;   // twice the writes into the slot, odd while writing
+  atomic_uint words[WORDS];
+} slot;
+
+typedef struct {
+  atomic_uint magic;              // stored last, once the rest is ready
+  uint32_t version;
+  uint32_t slots;
+  uint32_t words;
+  _Alignas(64) _Atomic uint64_t head;   // poses written so far
+  slot ring[SLOTS];
+} segment;
+
+struct faceshm {
+  const segment *seg;
+  uint64_t lastHead;
+  unsigned long retries;
+};
+
+struct faceshmwriter {
+  segment *seg;
+  char *name;
+};
+
+static uint32_t floatBits(float f){
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+static float bitsFloat(uint32_t u){
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+static uint64_t nowNanoseconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+faceshm openFaceShm(const char *name){
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(segment)){
+    close(fd);
+    return NULL;
+  }
+  const segment *seg = mmap(NULL, sizeof(segment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (seg == MAP_FAILED) return NULL;
+  if (atomic_load_explicit(&seg->magic, memory_order_acquire) != MAGIC ||
+      seg->version != VERSION || seg->slots != SLOTS || seg->words != WORDS){
+    fprintf(stderr, "Ignoring shared memory %s, it holds a different layout\n", name);
+    munmap((void *)seg, sizeof(segment));
+    return NULL;
+  }
+
+  faceshm new = malloc(sizeof(struct faceshm));
+  assert(new != NULL);
+  new->seg = seg;
+  // only poses written from now on count
+  new->lastHead = atomic_load_explicit(&seg->head, memory_order_acquire);
+  new->retries = 0;
+  return new;
+}
+
+void closeFaceShm(faceshm s){
+  munmap((void *)s->seg, sizeof(segment));
+  free(s);
+}
+
+unsigned long faceShmRetries(faceshm s){
+  return s->retries;
+}
+
+bool faceShmLatest(faceshm s, facePose *pose, unsigned long *superseded){
+  uint32_t words[WORDS];
+  for (int t = 0; t < TRIES; t++){
+    uint64_t head = atomic_load_explicit(&s->seg->head, memory_order_acquire);
+    if (head == s->lastHead) return false;
+    uint64_t index = head - 1;
+    const slot *sl = &s->seg->ring[index % SLOTS];
+    // the count the slot has once pose index is fully written
+    uint32_t expected = (uint32_t)(2 * (index / SLOTS + 1));
+
+    uint32_t before = atomic_load_explicit(&sl->seq, memory_order_acquire);
+    if (before != expected){
+      s->retries++;
+      continue;
+    }
+    for (int i = 0; i < WORDS; i++){
+      words[i] = atomic_load_explicit(&sl->words[i], memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&sl->seq, memory_order_relaxed) != before){
+      s->retries++;
+      continue;
+    }
+
+    *superseded = (unsigned long)(head - s->lastHead - 1);
+    s->lastHead = head;
+    int count = (int)words[WORD_COUNT];
+    if (count > FACE_MAX_POINTS) count = FACE_MAX_POINTS;
+    pose->count = count;
+    pose->yaw   = bitsFloat(words[WORD_YAW]);
+    pose->pitch = bitsFloat(words[WORD_PITCH]);
+    for (int i = 0; i < count; i++){
+      pose->points[i].x = bitsFloat(words[WORD_POINTS + i * 3 + 0]);
+      pose->points[i].y = bitsFloat(words[WORD_POINTS + i * 3 + 1]);
+      pose->points[i].z = bitsFloat(words[WORD_POINTS + i * 3 + 2]);
+    }
+    uint64_t stamp = (uint64_t)words[WORD_STAMP_HI] << 32 | words[WORD_STAMP_LO];
+    pose->captured = stamp * 1e-9;
+    pose->sequence = (unsigned long)head;
+    return true;
+  }
+  // the writer kept lapping us, the next frame will do
+  return false;
+}
+
+faceshmwriter createFaceShmWriter(const char *name){
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0){
+    perror("face shared memory");
+    return NULL;
+  }
+  if (ftruncate(fd, sizeof(segment)) < 0){
+    perror("face shared memory size");
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  segment *seg = mmap(NULL, sizeof(segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (seg == MAP_FAILED){
+    perror("face shared memory map");
+    shm_unlink(name);
+    return NULL;
+  }
+  // a fresh segment is all zeros: no poses, every slot unwritten
+  seg->version = VERSION;
+  seg->slots   = SLOTS;
+  seg->words   = WORDS;
+  atomic_store_explicit(&seg->magic, MAGIC, memory_order_release);
+
+  faceshmwriter new = malloc(sizeof(struct faceshmwriter));
+  assert(new != NULL);
+  new->seg  = seg;
+  new->name = strdup(name);
+  assert(new->name != NULL);
+  return new;
+}
+
+void freeFaceShmWriter(faceshmwriter w){
+  munmap(w->seg, sizeof(segment));
+  shm_unlink(w->name);
+  free(w->name);
+  free(w);
+}
+
+void faceShmPublish(faceshmwriter w, const facePose *pose){
+  segment *seg = w->seg;
+  uint64_t head = atomic_load_explicit(&seg->head, memory_order_relaxed);
+  slot *sl = &seg->ring[head % SLOTS];
+  uint32_t seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+
+  atomic_store_explicit(&sl->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  int count = pose->count < FACE_MAX_POINTS ? pose->count : FACE_MAX_POINTS;
+  uint64_t stamp = pose->captured > 0.0 ? (uint64_t)(pose->captured * 1e9) : nowNanoseconds();
+  atomic_store_explicit(&sl->words[WORD_COUNT], (uint32_t)count, memory_order_relaxed);
+  atomic_store_explicit(&sl->words[WORD_YAW], floatBits(pose->yaw), memory_order_relaxed);
+  atomic_store_explicit(&sl->words[WORD_PITCH], floatBits(pose->pitch), memory_order_relaxed);
+  atomic_store_explicit(&sl->words[WORD_STAMP_LO], (uint32_t)stamp, memory_order_relaxed);
+  atomic_store_explicit(&sl->words[WORD_STAMP_HI], (uint32_t)(stamp >> 32), memory_order_relaxed);
+  for (int i = 0; i < count; i++){
+    atomic_store_explicit(&sl->words[WORD_POINTS + i * 3 + 0], floatBits(pose->points[i].x), memory_order_relaxed);
+    atomic_store_explicit(&sl->words[WORD_POINTS + i * 3 + 1], floatBits(pose->points[i].y), memory_order_relaxed);
+    atomic_store_explicit(&sl->words[WORD_POINTS + i * 3 + 2], floatBits(pose->points[i].z), memory_order_relaxed);
+  }
+  atomic_store_explicit(&sl->seq, seq + 2, memory_order_release);
+  atomic_store_explicit(&seg->head, head + 1, memory_order_release);
+}
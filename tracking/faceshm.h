@@ -0,0 +1,42 @@
+#ifndef FACESHM_H
+#define FACESHM_H
+
+#include <stdbool.h>
+
+#include "facerecv.h"
+
+/*
+ * Head poses passed through POSIX shared memory, for a tracker on the
+ * same machine. The segment holds a small ring of slots, each guarded by
+ * its own sequence lock: the writer makes the count odd, writes, then
+ * makes it even again, and a reader keeps a copy only when the count was
+ * even and unchanged around it. Reading the newest pose is a handful of
+ * loads with no system call, and the writer never waits for readers.
+ *
+ * Every pose carries its CLOCK_MONOTONIC capture time, or the time it was
+ * written, which both processes share, so its age needs no guessing.
+ */
+struct faceshm;
+typedef struct faceshm *faceshm;
+struct faceshmwriter;
+typedef struct faceshmwriter *faceshmwriter;
+
+#define FACE_SHM_NAME "/terrain-face"
+
+// NULL when no producer has created the segment, or it is not one of ours
+extern faceshm openFaceShm(const char *name);
+extern void closeFaceShm(faceshm s);
+// true and fills pose when a newer one was written since the last call,
+// superseded gets the poses written in between that were never read
+extern bool faceShmLatest(faceshm s, facePose *pose, unsigned long *superseded);
+// reads that met the writer in the slot and had to try again
+extern unsigned long faceShmRetries(faceshm s);
+
+// replaces any segment of that name, which readers then notice has gone stale
+extern faceshmwriter createFaceShmWriter(const char *name);
+// removes the segment
+extern void freeFaceShmWriter(faceshmwriter w);
+// pose->captured is on the reader's clock already, 0 stamps the time of writing
+extern void faceShmPublish(faceshmwriter w, const facePose *pose);
+
+#endif
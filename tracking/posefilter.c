@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <math.h>
+
+#include "posefilter.h"
+
+#define DERIVATIVE_CUTOFF 1.0f   // Hz, smoothing of the speed itself
+#define MIN_DT            0.001f // poses stamped closer than this count as this far apart
+#define STALE             0.25   // seconds without a pose before the camera is let go
+#define LEAD_RATE         0.05   // weight of each shown frame in the learnt lead
+#define PI                3.14159265f
+
+// one angle through the One-Euro filter
+typedef struct {
+  float raw;        // last sample, unwrapped to be near the one before
+  float value;      // filtered
+  float speed;      // filtered, radians a second
+} channel;
+
+struct posefilter {
+  float minCutoff, beta, maxLead;
+  channel yaw, pitch;
+  bool primed;
+  double sampleTime;   // of the newest pose
+  double lead;         // learnt time from starting a frame to showing it
+  // the frame predicted last, until it is shown
+  double predictTime, predictLead;
+  bool predicted;
+  // for jitter, the last two outputs
+  float lastYaw, lastPitch;
+  float lastYawStep, lastPitchStep;
+  int outputs;
+  // accumulated since the last stats call
+  int frames;
+  double latency, maxLatency, leadSum, jitterSum;
+  int jitterCount;
+};
+
+static float smoothing(float cutoff, float dt){
+  float tau = 1.0f / (2.0f * PI * cutoff);
+  return 1.0f / (1.0f + tau / dt);
+}
+
+static void channelReset(channel *c, float x){
+  c->raw   = x;
+  c->value = x;
+  c->speed = 0.0f;
+}
+
+static void channelAdd(channel *c, float x, float dt, float minCutoff, float beta){
+  c->raw = x;
+  float speed = (x - c->value) / dt;
+  c->speed += smoothing(DERIVATIVE_CUTOFF, dt) * (speed - c->speed);
+  float cutoff = minCutoff + beta * fabsf(c->speed);
+  c->value += smoothing(cutoff, dt) * (x - c->value);
+}
+
+posefilter createPoseFilter(float minCutoff, float beta, float maxLead){
+  posefilter new = malloc(sizeof(struct posefilter));
+  assert(new != NULL);
+  new->minCutoff = minCutoff;
+  new->beta      = beta;
+  new->maxLead   = maxLead;
+  new->primed    = false;
+  new->sampleTime = 0.0;
+  new->lead      = 1.0 / 60.0;
+  new->predicted = false;
+  new->outputs   = 0;
+  new->frames     = 0;
+  new->latency    = 0.0;
+  new->maxLatency = 0.0;
+  new->leadSum    = 0.0;
+  new->jitterSum  = 0.0;
+  new->jitterCount = 0;
+  return new;
+}
+
+void freePoseFilter(posefilter f){
+  free(f);
+}
+
+void poseFilterAdd(posefilter f, const facePose *pose){
+  float yaw = pose->yaw;
+  if (f->primed){
+    // atan2 wraps at +-pi, keep the yaw continuous
+    while (yaw - f->yaw.raw >  PI) yaw -= 2.0f * PI;
+    while (yaw - f->yaw.raw < -PI) yaw += 2.0f * PI;
+  }
+
+  double dt = pose->captured - f->sampleTime;
+  if (!f->primed || dt > STALE){
+    // nothing recent to smooth against
+    channelReset(&f->yaw, yaw);
+    channelReset(&f->pitch, pose->pitch);
+    f->primed = true;
+    f->outputs = 0;
+  } else {
+    float step = dt > MIN_DT ? (float)dt : MIN_DT;
+    channelAdd(&f->yaw, yaw, step, f->minCutoff, f->beta);
+    channelAdd(&f->pitch, pose->pitch, step, f->minCutoff, f->beta);
+  }
+  if (pose->captured > f->sampleTime) f->sampleTime = pose->captured;
+}
+
+bool poseFilterPredict(posefilter f, double now, float *yaw, float *pitch){
+  f->predicted = false;
+  if (!f->primed || now - f->sampleTime > STALE){
+    f->outputs = 0;
+    return false;
+  }
+
+  double lead = now + f->lead - f->sampleTime;
+  if (lead < 0.0) lead = 0.0;
+  if (lead > f->maxLead) lead = f->maxLead;
+  *yaw   = f->yaw.value + f->yaw.speed * (float)lead;
+  *pitch = f->pitch.value + f->pitch.speed * (float)lead;
+
+  // jitter is how much the step from one frame to the next changes
+  float yawStep = *yaw - f->lastYaw, pitchStep = *pitch - f->lastPitch;
+  if (f->outputs >= 2){
+    float dy = yawStep - f->lastYawStep, dp = pitchStep - f->lastPitchStep;
+    f->jitterSum += dy * dy + dp * dp;
+    f->jitterCount++;
+  }
+  if (f->outputs < 2) f->outputs++;
+  f->lastYaw = *yaw;
+  f->lastPitch = *pitch;
+  f->lastYawStep = yawStep;
+  f->lastPitchStep = pitchStep;
+
+  f->predicted   = true;
+  f->predictTime = now;
+  f->predictLead = lead;
+  return true;
+}
+
+void poseFilterShown(posefilter f, double when){
+  if (!f->predicted) return;
+  f->predicted = false;
+  f->lead += LEAD_RATE * ((when - f->predictTime) - f->lead);
+
+  double latency = when - f->sampleTime;
+  f->frames++;
+  f->latency += latency;
+  f->leadSum += f->predictLead;
+  if (latency > f->maxLatency) f->maxLatency = latency;
+}
+
+poseFilterStats getPoseFilterStats(posefilter f){
+  poseFilterStats stats;
+  stats.frames     = f->frames;
+  stats.latency    = f->frames > 0 ? f->latency / f->frames : 0.0;
+  stats.maxLatency = f->maxLatency;
+  stats.lead       = f->frames > 0 ? f->leadSum / f->frames : 0.0;
+  stats.jitter     = f->jitterCount > 0 ? sqrt(f->jitterSum / f->jitterCount) * 180.0 / PI : 0.0;
+  f->frames      = 0;
+  f->latency     = 0.0;
+  f->maxLatency  = 0.0;
+  f->leadSum     = 0.0;
+  f->jitterSum   = 0.0;
+  f->jitterCount = 0;
+  return stats;
+}
@@ -0,0 +1,42 @@
+#ifndef POSEFILTER_H
+#define POSEFILTER_H
+
+#include <stdbool.h>
+
+#include "facerecv.h"
+
+/*
+ * Smooths the tracker's yaw and pitch and hides some of its delay.
+ *
+ * Each angle goes through a One-Euro filter: a low pass whose cutoff
+ * rises with the speed of the head, so it removes jitter when the head
+ * is still and barely lags when it turns. The filtered speed then carries
+ * the pose forward from the time it was sampled to the time the frame is
+ * expected on screen, which is learnt from when frames were actually
+ * shown.
+ */
+struct posefilter;
+typedef struct posefilter *posefilter;
+
+typedef struct {
+  int frames;         // shown since the last call
+  double latency;     // mean seconds from a pose's timestamp to it being shown
+  double maxLatency;
+  double lead;        // mean seconds the pose was carried forward
+  double jitter;      // RMS change in angular speed between frames, degrees a frame
+} poseFilterStats;
+
+// minCutoff in Hz is the smoothing of a still head, beta how quickly the
+// cutoff rises with speed, and no pose is carried forward more than maxLead
+extern posefilter createPoseFilter(float minCutoff, float beta, float maxLead);
+extern void freePoseFilter(posefilter f);
+extern void poseFilterAdd(posefilter f, const facePose *pose);
+// the pose expected on screen for a frame started at now, in radians.
+// false when no pose arrived for a while, the camera is then left alone
+extern bool poseFilterPredict(posefilter f, double now, float *yaw, float *pitch);
+// the frame predicted last was handed to the display at when
+extern void poseFilterShown(posefilter f, double when);
+// averages since the previous call
+extern poseFilterStats getPoseFilterStats(posefilter f);
+
+#endif
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "compress.h"
+
+/*
+ * RLE: a stream of (count, byte) pairs with 1 <= count <= 255.
+ *
+ * LZ: an LZ4 style stream of sequences. Each sequence is a token byte whose
+ * high nibble is the literal length and low nibble the match length minus
+ * LZ_MIN_MATCH (15 in either means more length bytes follow, each adding up
+ * to 255), then the literals, then a 2 byte little endian match offset.
+ * The final sequence carries literals only and ends the stream.
+ */
+
+#define LZ_MIN_MATCH  4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS  12
+
+size_t compressRLE(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap){
+  size_t op = 0;
+  size_t ip = 0;
+  while (ip < n){
+    uint8_t value = src[ip];
+    size_t run = 1;
+    while (ip + run < n && run < 255 && src[ip + run] == value) run++;
+    if (op + 2 > dstCap) return 0;
+    dst[op++] = (uint8_t)run;
+    dst[op++] = value;
+    ip += run;
+  }
+  return op;
+}
+
+long decompressRLE(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap){
+  if (n % 2 != 0) return -1;
+  size_t op = 0;
+  for (size_t ip = 0; ip < n; ip += 2){
+    size_t run = src[ip];
+    if (run == 0 || op + run > dstCap) return -1;
+    memset(dst + op, src[ip + 1], run);
+    op += run;
+  }
+  return (long)op;
+}
+
+static inline uint32_t read32(const uint8_t *p){
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t lzHash(uint32_t seq){
+  return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// writes the 255-continued remainder of a length, returns false when full
+static bool writeLength(uint8_t *dst, size_t dstCap, size_t *op, size_t len){
+  while (len >= 255){
+    if (*op >= dstCap) return false;
+    dst[(*op)++] = 255;
+    len -= 255;
+  }
+  if (*op >= dstCap) return false;
+  dst[(*op)++] = (uint8_t)len;
+  return true;
+}
+
+static bool writeSequence(uint8_t *dst, size_t dstCap, size_t *op,
+                          const uint8_t *literals, size_t litLen,
+                          size_t offset, size_t matchLen){
+  if (*op >= dstCap) return false;
+  size_t litNibble   = litLen < 15 ? litLen : 15;
+  size_t matchNibble = 0;
+  if (matchLen > 0){
+    size_t m = matchLen - LZ_MIN_MATCH;
+    matchNibble = m < 15 ? m : 15;
+  }
+  dst[(*op)++] = (uint8_t)((litNibble << 4) | matchNibble);
+
+  if (litNibble == 15 && !writeLength(dst, dstCap, op, litLen - 15)) return false;
+  if (*op + litLen > dstCap) return false;
+  memcpy(dst + *op, literals, litLen);
+  *op += litLen;
+
+  if (matchLen == 0) return true;
+  if (*op + 2 > dstCap) return false;
+  dst[(*op)++] = (uint8_t)(offset & 0xFF);
+  dst[(*op)++] = (uint8_t)(offset >> 8);
+  if (matchNibble == 15 && !writeLength(dst, dstCap, op, matchLen - LZ_MIN_MATCH - 15)) return false;
+  return true;
+}
+
+size_t compressLZ(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap){
+  // positions are stored plus one so zero means empty
+  uint32_t table[1 << LZ_HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  size_t op = 0;
+  size_t ip = 0;
+  size_t anchor = 0;
+  while (ip + LZ_MIN_MATCH <= n){
+    uint32_t seq = read32(src + ip);
+    uint32_t h   = lzHash(seq);
+    size_t ref   = table[h];
+    table[h] = (uint32_t)(ip + 1);
+
+    if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || read32(src + ref - 1) != seq){
+      ip++;
+      continue;
+    }
+    ref--;
+    size_t len = LZ_MIN_MATCH;
+    while (ip + len < n && src[ref + len] == src[ip + len]) len++;
+
+    if (!writeSequence(dst, dstCap, &op, src + anchor, ip - anchor, ip - ref, len)) return 0;
+    ip += len;
+    anchor = ip;
+  }
+  if (!writeSequence(dst, dstCap, &op, src + anchor, n - anchor, 0, 0)) return 0;
+  return op;
+}
+
+// reads a 255-continued length remainder, returns false on truncation
+static bool readLength(const uint8_t *src, size_t n, size_t *ip, size_t *len){
+  uint8_t b;
+  do {
+    if (*ip >= n) return false;
+    b = src[(*ip)++];
+    *len += b;
+  } while (b == 255);
+  return true;
+}
+
+long decompressLZ(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap){
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < n){
+    uint8_t token = src[ip++];
+
+    size_t litLen = token >> 4;
+    if (litLen == 15 && !readLength(src, n, &ip, &litLen)) return -1;
+    if (litLen > n - ip || litLen > dstCap - op) return -1;
+    memcpy(dst + op, src + ip, litLen);
+    ip += litLen;
+    op += litLen;
+
+    // the last sequence has no match part
+    if (ip == n) break;
+
+    if (n - ip < 2) return -1;
+    size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op) return -1;
+
+    size_t matchLen = token & 15;
+    if (matchLen == 15 && !readLength(src, n, &ip, &matchLen)) return -1;
+    matchLen += LZ_MIN_MATCH;
+    if (matchLen > dstCap - op) return -1;
+
+    // byte by byte so overlapping matches repeat correctly
+    const uint8_t *from = dst + op - offset;
+    for (size_t i = 0; i < matchLen; i++){
+      dst[op + i] = from[i];
+    }
+    op += matchLen;
+  }
+  return (long)op;
+}
+
+size_t compressBest(const uint8_t *src, size_t n, uint8_t *dst, CODEC *codec){
+  // anything not smaller than the input is stored raw
+  size_t best = compressLZ(src, n, dst, n > 0 ? n - 1 : 0);
+  *codec = CODEC_LZ;
+
+  size_t rleCap = best > 0 ? best - 1 : (n > 0 ? n - 1 : 0);
+  if (rleCap > 0){
+    uint8_t *tmp = malloc(rleCap);
+    assert(tmp != NULL);
+    size_t rle = compressRLE(src, n, tmp, rleCap);
+    if (rle > 0){
+      memcpy(dst, tmp, rle);
+      best   = rle;
+      *codec = CODEC_RLE;
+    }
+    free(tmp);
+  }
+
+  if (best == 0){
+    memcpy(dst, src, n);
+    best   = n;
+    *codec = CODEC_RAW;
+  }
+  return best;
+}
+
+long decompress(CODEC codec, const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap){
+  switch (codec){
+    case CODEC_RAW:
+      if (n > dstCap) return -1;
+      memcpy(dst, src, n);
+      return (long)n;
+    case CODEC_RLE:
+      return decompressRLE(src, n, dst, dstCap);
+    case CODEC_LZ:
+      return decompressLZ(src, n, dst, dstCap);
+  }
+  return -1;
+}
+
+uint32_t checksum(const uint8_t *data, size_t n){
+  // Adler-32, summed in blocks short enough that the sums cannot overflow
+  uint32_t a = 1, b = 0;
+  while (n > 0){
+    size_t block = n < 5552 ? n : 5552;
+    n -= block;
+    while (block-- > 0){
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
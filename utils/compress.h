@@ -0,0 +1,32 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  CODEC_RAW,
+  CODEC_RLE,
+  CODEC_LZ
+} CODEC;
+
+// Usage - size_t size = compressRLE(blocks, 4096, out, sizeof(out));
+// Each returns the number of bytes written, or 0 when the output would not
+// fit into dstCap (the caller should then fall back to storing raw).
+extern size_t compressRLE(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap);
+extern size_t compressLZ(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap);
+
+// Runs every codec and keeps the smallest result, writing the codec used
+// into *codec. Falls back to CODEC_RAW, so dst must hold n bytes.
+extern size_t compressBest(const uint8_t *src, size_t n, uint8_t *dst, CODEC *codec);
+
+// Decoders are bounds checked on both sides. They return the number of
+// bytes written to dst, or -1 if the input is malformed.
+extern long decompressRLE(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap);
+extern long decompressLZ(const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap);
+extern long decompress(CODEC codec, const uint8_t *src, size_t n, uint8_t *dst, size_t dstCap);
+
+// Adler-32 of the given bytes
+extern uint32_t checksum(const uint8_t *data, size_t n);
+
+#endif
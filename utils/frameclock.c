@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "frameclock.h"
+
+#define FRAME_SAMPLES 8192  // frame times kept between reads, the oldest go first
+
+struct frameclock {
+  double step;
+  int maxSteps;
+  double last;          // when the previous frame started
+  double accumulator;   // time not simulated yet, under one step after a frame
+  // since the stats were last read
+  double *times;
+  int count, next;
+  double since;
+  double total, max, dropped;
+  int frames;
+  int steps[FRAME_STEP_COUNTS];
+};
+
+frameclock createFrameClock(double stepSeconds, int maxSteps, double now){
+  frameclock new = malloc(sizeof(struct frameclock));
+  assert(new != NULL);
+  new->times = malloc(FRAME_SAMPLES * sizeof(double));
+  assert(new->times != NULL);
+  new->step        = stepSeconds;
+  new->maxSteps    = maxSteps;
+  new->last        = now;
+  new->accumulator = 0.0;
+  new->since       = now;
+  new->count   = 0;
+  new->next    = 0;
+  new->total   = 0.0;
+  new->max     = 0.0;
+  new->dropped = 0.0;
+  new->frames  = 0;
+  for (int i = 0; i < FRAME_STEP_COUNTS; i++) new->steps[i] = 0;
+  return new;
+}
+
+void freeFrameClock(frameclock f){
+  free(f->times);
+  free(f);
+}
+
+int frameClockAdvance(frameclock f, double now){
+  double elapsed = now - f->last;
+  f->last = now;
+  f->accumulator += elapsed;
+  double due = floor(f->accumulator / f->step);
+  int steps = due > f->maxSteps ? f->maxSteps : (int)due;
+  f->dropped += (due - steps) * f->step;
+  f->accumulator = fmod(f->accumulator, f->step);
+
+  if (elapsed > 0.0){
+    f->times[f->next] = elapsed;
+    f->next = (f->next + 1) % FRAME_SAMPLES;
+    if (f->count < FRAME_SAMPLES) f->count++;
+    f->total += elapsed;
+    if (elapsed > f->max) f->max = elapsed;
+  }
+  f->frames++;
+  f->steps[steps < FRAME_STEP_COUNTS - 1 ? steps : FRAME_STEP_COUNTS - 1]++;
+  return steps;
+}
+
+float frameClockAlpha(frameclock f){
+  return (float)(f->accumulator / f->step);
+}
+
+static int compareTimes(const void *a, const void *b){
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int count, double p){
+  if (count == 0) return 0.0;
+  int i = (int)(p * (count - 1) + 0.5);
+  return sorted[i];
+}
+
+frameStats getFrameStats(frameclock f){
+  frameStats stats;
+  stats.frames  = f->frames;
+  stats.rate    = f->last > f->since ? f->frames / (f->last - f->since) : 0.0;
+  stats.mean    = f->frames > 0 ? f->total / f->frames : 0.0;
+  stats.max     = f->max;
+  stats.dropped = f->dropped;
+  for (int i = 0; i < FRAME_STEP_COUNTS; i++) stats.steps[i] = f->steps[i];
+  qsort(f->times, f->count, sizeof(double), &compareTimes);
+  stats.median = percentile(f->times, f->count, 0.5);
+  stats.p95    = percentile(f->times, f->count, 0.95);
+  stats.p99    = percentile(f->times, f->count, 0.99);
+
+  f->since   = f->last;
+  f->count   = 0;
+  f->next    = 0;
+  f->total   = 0.0;
+  f->max     = 0.0;
+  f->dropped = 0.0;
+  f->frames  = 0;
+  for (int i = 0; i < FRAME_STEP_COUNTS; i++) f->steps[i] = 0;
+  return stats;
+}
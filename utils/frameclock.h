@@ -0,0 +1,37 @@
+#ifndef FRAMECLOCK_H
+#define FRAMECLOCK_H
+
+/*
+ * Fixed timestep simulation under a free running renderer. Every frame
+ * the clock adds the time that passed to an accumulator and hands back
+ * how many whole steps to simulate; what is left over says how far the
+ * frame is between the last step and the next, for drawing moving things
+ * in between. After a long stall only maxSteps are run and the rest of
+ * the time is dropped, so the simulation never falls further behind.
+ *
+ * It also keeps every frame time until the stats are next read.
+ */
+struct frameclock;
+typedef struct frameclock *frameclock;
+
+// frames that ran 0, 1, 2, ... steps, the last counts that many or more
+#define FRAME_STEP_COUNTS 4
+
+typedef struct {
+  int frames;
+  double rate;          // frames a second
+  double mean, median, p95, p99, max;   // frame times in seconds
+  int steps[FRAME_STEP_COUNTS];
+  double dropped;       // seconds not simulated because of stalls
+} frameStats;
+
+extern frameclock createFrameClock(double stepSeconds, int maxSteps, double now);
+extern void freeFrameClock(frameclock f);
+// steps to simulate for a frame starting at now
+extern int frameClockAdvance(frameclock f, double now);
+// 0 right at the last step, up to 1 at the next
+extern float frameClockAlpha(frameclock f);
+// since the stats were last read, or the clock was made
+extern frameStats getFrameStats(frameclock f);
+
+#endif
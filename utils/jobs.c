@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "jobs.h"
+#include "pool.h"
+
+#define DEQUE_SIZE 64   // a power of two above MAX_JOBS, no deque ever holds more
+
+// Chase and Lev's deque: the owner pushes and takes at the bottom,
+// thieves take from the top, and only the last job is fought over
+typedef struct {
+  atomic_long top, bottom;
+  atomic_int slots[DEQUE_SIZE];
+  unsigned long steals;   // by the owner from others
+} deque;
+
+typedef struct {
+  const char *name;
+  jobfunc run;
+  void *arg;
+  bool mainThread;
+  int dependents[MAX_JOBS];
+  int dependentCount;
+  int dependencies;
+  atomic_int waiting;     // dependencies not finished this frame
+  // since the stats were last read
+  int runs;
+  double total, max;
+  int thread;
+} job;
+
+struct jobs {
+  job jobs[MAX_JOBS];
+  int count;
+  pool workers;
+  int threads;
+  deque *deques;          // one a thread, the main thread owns the first
+  atomic_int remaining;   // jobs not finished this frame
+  atomic_int available;   // in the deques, may dip below 0 while a job is taken
+  // main thread jobs that are ready, in the order they became so. Threads
+  // with nothing to do sleep on ready until a job becomes ready or the
+  // frame is over
+  pthread_mutex_t readyLock;
+  pthread_cond_t ready;
+  int mainQueue[MAX_JOBS];
+  int mainHead, mainTail;
+  // since the stats were last read
+  int frames;
+  double total, max;
+};
+
+static double nowSeconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void push(deque *d, int job){
+  long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  atomic_store_explicit(&d->slots[b & (DEQUE_SIZE - 1)], job, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+// -1 when empty
+static int take(deque *d){
+  long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+  if (t > b){
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return -1;
+  }
+  int job = atomic_load_explicit(&d->slots[b & (DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (t == b){
+    // the last one, a thief may be after it too
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)){
+      job = -1;
+    }
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+  return job;
+}
+
+// -1 when empty or another thread got there first
+static int steal(deque *d){
+  long t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+  if (t >= b) return -1;
+  int job = atomic_load_explicit(&d->slots[t & (DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                               memory_order_seq_cst, memory_order_relaxed)){
+    return -1;
+  }
+  return job;
+}
+
+static void makeReady(jobs js, int self, int index){
+  pthread_mutex_lock(&js->readyLock);
+  if (js->jobs[index].mainThread){
+    js->mainQueue[js->mainTail++] = index;
+  } else {
+    push(&js->deques[self], index);
+    atomic_fetch_add(&js->available, 1);
+  }
+  pthread_cond_broadcast(&js->ready);
+  pthread_mutex_unlock(&js->readyLock);
+}
+
+static int takeMain(jobs js){
+  int index = -1;
+  pthread_mutex_lock(&js->readyLock);
+  if (js->mainHead < js->mainTail) index = js->mainQueue[js->mainHead++];
+  pthread_mutex_unlock(&js->readyLock);
+  return index;
+}
+
+// sleeps while there is nothing the thread could run
+static void waitForJob(jobs js, int self){
+  pthread_mutex_lock(&js->readyLock);
+  while (atomic_load(&js->remaining) > 0 && atomic_load(&js->available) <= 0 &&
+         (self != 0 || js->mainHead == js->mainTail)){
+    pthread_cond_wait(&js->ready, &js->readyLock);
+  }
+  pthread_mutex_unlock(&js->readyLock);
+}
+
+static void runJob(jobs js, int self, int index){
+  job *j = &js->jobs[index];
+  double start = nowSeconds();
+  j->run(j->arg);
+  double took = nowSeconds() - start;
+  j->runs++;
+  j->total += took;
+  if (took > j->max) j->max = took;
+  j->thread = self;
+  // whoever finishes a job's last dependency readies it
+  for (int i = 0; i < j->dependentCount; i++){
+    int d = j->dependents[i];
+    if (atomic_fetch_sub(&js->jobs[d].waiting, 1) == 1) makeReady(js, self, d);
+  }
+  if (atomic_fetch_sub(&js->remaining, 1) == 1){
+    // the last one, wake everyone sleeping so they see the frame is over
+    pthread_mutex_lock(&js->readyLock);
+    pthread_cond_broadcast(&js->ready);
+    pthread_mutex_unlock(&js->readyLock);
+  }
+}
+
+// keep finding jobs until none are left this frame
+static void work(jobs js, int self){
+  while (atomic_load(&js->remaining) > 0){
+    int index = self == 0 ? takeMain(js) : -1;
+    if (index < 0) index = take(&js->deques[self]);
+    for (int i = 1; index < 0 && i < js->threads; i++){
+      index = steal(&js->deques[(self + i) % js->threads]);
+      if (index >= 0) js->deques[self].steals++;
+    }
+    if (index < 0){
+      // what is left is running elsewhere or waiting on it
+      waitForJob(js, self);
+      continue;
+    }
+    if (!js->jobs[index].mainThread) atomic_fetch_sub(&js->available, 1);
+    runJob(js, self, index);
+  }
+}
+
+static void workFrame(void *arg, int index, int count){
+  (void)count;
+  work(arg, index);
+}
+
+jobs createJobs(int workers){
+  jobs new = malloc(sizeof(struct jobs));
+  assert(new != NULL);
+  new->count    = 0;
+  new->mainHead = 0;
+  new->mainTail = 0;
+  new->frames   = 0;
+  new->total    = 0.0;
+  new->max      = 0.0;
+  atomic_init(&new->remaining, 0);
+  atomic_init(&new->available, 0);
+  pthread_mutex_init(&new->readyLock, NULL);
+  pthread_cond_init(&new->ready, NULL);
+
+  new->workers = createPool("job", workers);
+  new->threads = poolThreads(new->workers);
+  new->deques  = malloc(new->threads * sizeof(deque));
+  assert(new->deques != NULL);
+  for (int i = 0; i < new->threads; i++){
+    atomic_init(&new->deques[i].top, 0);
+    atomic_init(&new->deques[i].bottom, 0);
+    for (int s = 0; s < DEQUE_SIZE; s++) atomic_init(&new->deques[i].slots[s], -1);
+    new->deques[i].steals = 0;
+  }
+  return new;
+}
+
+void freeJobs(jobs js){
+  freePool(js->workers);
+  pthread_mutex_destroy(&js->readyLock);
+  pthread_cond_destroy(&js->ready);
+  free(js->deques);
+  free(js);
+}
+
+int jobsAdd(jobs js, const char *name, jobfunc run, void *arg, bool mainThread){
+  if (js->count == MAX_JOBS) return -1;
+  job *j = &js->jobs[js->count];
+  j->name           = name;
+  j->run            = run;
+  j->arg            = arg;
+  j->mainThread     = mainThread;
+  j->dependentCount = 0;
+  j->dependencies   = 0;
+  atomic_init(&j->waiting, 0);
+  j->runs   = 0;
+  j->total  = 0.0;
+  j->max    = 0.0;
+  j->thread = 0;
+  return js->count++;
+}
+
+void jobsDepend(jobs js, int job, int before){
+  // only depending on earlier jobs keeps the graph free of cycles
+  assert(before >= 0 && before < job && job < js->count);
+  js->jobs[before].dependents[js->jobs[before].dependentCount++] = job;
+  js->jobs[job].dependencies++;
+}
+
+void jobsRun(jobs js){
+  if (js->count == 0) return;
+  double start = nowSeconds();
+  js->mainHead = 0;
+  js->mainTail = 0;
+  atomic_store(&js->remaining, js->count);
+  for (int i = 0; i < js->count; i++){
+    atomic_store(&js->jobs[i].waiting, js->jobs[i].dependencies);
+    if (js->jobs[i].dependencies == 0) makeReady(js, 0, i);
+  }
+
+  // every thread works until the frame is over, and the run only returns
+  // once they all stopped looking at the graph, which is reset next frame
+  poolRun(js->workers, &workFrame, js);
+
+  double took = nowSeconds() - start;
+  js->frames++;
+  js->total += took;
+  if (took > js->max) js->max = took;
+}
+
+jobStats getJobStats(jobs js){
+  jobStats stats;
+  stats.threads = js->threads;
+  stats.frames  = js->frames;
+  stats.mean    = js->frames > 0 ? js->total / js->frames : 0.0;
+  stats.max     = js->max;
+  stats.steals  = 0;
+  for (int i = 0; i < js->threads; i++){
+    stats.steals += js->deques[i].steals;
+    js->deques[i].steals = 0;
+  }
+  stats.count = js->count;
+  for (int i = 0; i < js->count; i++){
+    job *j = &js->jobs[i];
+    stats.jobs[i] = (jobTiming){ j->name, j->runs, j->runs > 0 ? j->total / j->runs : 0.0, j->max, j->thread };
+    j->runs  = 0;
+    j->total = 0.0;
+    j->max   = 0.0;
+  }
+  js->frames = 0;
+  js->total  = 0.0;
+  js->max    = 0.0;
+  return stats;
+}
@@ -0,0 +1,54 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+
+/*
+ * A small job system for the work done every frame. The frame is built
+ * once as a graph of jobs, each run after the ones it depends on, and
+ * then run as a whole every frame.
+ *
+ * Every thread has a deque of jobs ready to run. A thread pushes the
+ * jobs it makes ready onto its own and takes them back newest first,
+ * and a thread with nothing left steals the oldest from another. Jobs
+ * marked for the main thread, anything touching GL, only ever run on
+ * the thread calling jobsRun, which also works through the rest.
+ */
+struct jobs;
+typedef struct jobs *jobs;
+
+typedef void (*jobfunc)(void *arg);
+
+// jobs in a graph
+#define MAX_JOBS 32
+
+typedef struct {
+  const char *name;
+  int runs;
+  double mean, max;     // seconds a run
+  int thread;           // that ran it last, 0 is the main thread
+} jobTiming;
+
+typedef struct {
+  int threads;          // workers + the main thread
+  int frames;
+  double mean, max;     // seconds a whole graph takes
+  unsigned long steals;
+  int count;
+  jobTiming jobs[MAX_JOBS];
+} jobStats;
+
+// workers threads are started besides the calling one, 0 for none
+extern jobs createJobs(int workers);
+extern void freeJobs(jobs js);
+// index of the new job, or -1 when the graph is full. The name is kept,
+// not copied
+extern int jobsAdd(jobs js, const char *name, jobfunc run, void *arg, bool mainThread);
+// job runs only once before has finished, which must have been added first
+extern void jobsDepend(jobs js, int job, int before);
+// runs every job once and returns when they have all finished
+extern void jobsRun(jobs js);
+// since the stats were last read
+extern jobStats getJobStats(jobs js);
+
+#endif
@@ -3,6 +3,10 @@
 #include "math.h"
 #include <math.h>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 mat4x4 constructMat4x4(float initialValue){
   mat4x4 matrix = malloc(sizeof(struct mat4x4));
   assert(matrix != NULL);
@@ -16,12 +20,9 @@ mat4x4 constructMat4x4(float initialValue){
 
 // REMEMBER to free matrix after use 
 mat4x4 identity(){
-  mat4x4 matrix = constructMat4x4(0.0f);
+  mat4x4 matrix = malloc(sizeof(struct mat4x4));
   assert(matrix != NULL);
-  matrix->m[0][0] = 1.0f;
-  matrix->m[1][1] = 1.0f;
-  matrix->m[2][2] = 1.0f;
-  matrix->m[3][3] = 1.0f;
+  *matrix = mat4Identity();
   return matrix;
 }
 
@@ -43,50 +44,23 @@ void multiplyMatrixVector(vec3d i, vec3d o, mat4x4 m){
 }  
 
 mat4x4 constructRotationY(float theta) {
-  mat4x4 mat = constructMat4x4(0.0f);  // Zero matrix
-
-  float c = cosf(theta);
-  float s = sinf(theta);
-
-  mat->m[0][0] =  c;
-  mat->m[0][2] =  s;
-  mat->m[1][1] =  1.0f;
-  mat->m[2][0] = -s;
-  mat->m[2][2] =  c;
-  mat->m[3][3] =  1.0f;
-
+  mat4x4 mat = malloc(sizeof(struct mat4x4));
+  assert(mat != NULL);
+  *mat = mat4RotationY(theta);
   return mat;
 }
 
 mat4x4 constructRotationZ(float theta){
-  mat4x4 mat = constructMat4x4(0.0f);
-
-  float c = cosf(theta);
-  float s = sinf(theta);
-
-  mat->m[0][0] = c;
-  mat->m[0][1] = -s;
-  mat->m[1][0] = s;
-  mat->m[1][1] = c;
-  mat->m[2][2] = 1.0f;
-  mat->m[3][3] = 1.0f;
-
+  mat4x4 mat = malloc(sizeof(struct mat4x4));
+  assert(mat != NULL);
+  *mat = mat4RotationZ(theta);
   return mat;
 }
 
 mat4x4 constructRotationX(float theta){
-  mat4x4 mat = constructMat4x4(0.0f);
-
-  float c = cosf(theta);
-  float s = sinf(theta);
-
-  mat->m[0][0] = 1.0f;
-  mat->m[1][1] = c;
-  mat->m[1][2] = -s;
-  mat->m[2][1] = s;
-  mat->m[2][2] = c;
-  mat->m[3][3] = 1.0f;
-
+  mat4x4 mat = malloc(sizeof(struct mat4x4));
+  assert(mat != NULL);
+  *mat = mat4RotationX(theta);
   return mat;
 }
 
@@ -97,18 +71,9 @@ void translate(mat4x4 m, vec3d v){
 }
 
 mat4x4 constructTranslationMatrix(float x, float y, float z){
-  mat4x4 mat = constructMat4x4(0.0f);
-
-  // identitit 
-  for (int i = 0; i < 4; i++){
-    mat->m[i][i] = 1.0f;
-  }
-
-  // Set translation
-  mat->m[0][3] = x;
-  mat->m[1][3] = y;
-  mat->m[2][3] = z;
-
+  mat4x4 mat = malloc(sizeof(struct mat4x4));
+  assert(mat != NULL);
+  *mat = mat4Translation(x, y, z);
   return mat;
 }
 
@@ -118,10 +83,8 @@ float dot(vec3d u, vec3d v){
 
 // REMEMBER to free
 vec3d cross(vec3d u, vec3d v){
-  float x = u->y * v->z - u->z * v->y;
-  float y = u->z * v->x - u->x * v->z;
-  float z = u->x * v->y - u->y * v->x;
-  return constructVec3d(x, y, z);
+  vec3 r = vec3Cross(*u, *v);
+  return constructVec3d(r.x, r.y, r.z);
 }
 
 // does it inplace 
@@ -185,3 +148,214 @@ float getY(vec3d v){
 float getZ(vec3d v){
   return v->z;
 }
+
+vec3 vec3Make(float x, float y, float z){
+  vec3 v = { x, y, z };
+  return v;
+}
+
+vec3 vec3Add(vec3 u, vec3 v){
+  return vec3Make(u.x + v.x, u.y + v.y, u.z + v.z);
+}
+
+vec3 vec3Sub(vec3 u, vec3 v){
+  return vec3Make(u.x - v.x, u.y - v.y, u.z - v.z);
+}
+
+vec3 vec3Scale(vec3 v, float scalar){
+  return vec3Make(v.x * scalar, v.y * scalar, v.z * scalar);
+}
+
+vec3 vec3Cross(vec3 u, vec3 v){
+  return vec3Make(u.y * v.z - u.z * v.y,
+                  u.z * v.x - u.x * v.z,
+                  u.x * v.y - u.y * v.x);
+}
+
+float vec3Dot(vec3 u, vec3 v){
+  return u.x * v.x + u.y * v.y + u.z * v.z;
+}
+
+float vec3Length(vec3 v){
+  return sqrtf(vec3Dot(v, v));
+}
+
+vec3 vec3Normalise(vec3 v){
+  float len = vec3Length(v);
+  if (len == 0.0f) return v;
+  return vec3Scale(v, 1.0f / len);
+}
+
+vec3 vec3Lerp(vec3 u, vec3 v, float t){
+  return vec3Make(u.x + (v.x - u.x) * t, u.y + (v.y - u.y) * t, u.z + (v.z - u.z) * t);
+}
+
+mat4 mat4Identity(void){
+  mat4 mat = {{{ 0.0f }}};
+  for (int i = 0; i < 4; i++){
+    mat.m[i][i] = 1.0f;
+  }
+  return mat;
+}
+
+mat4 mat4Translation(float x, float y, float z){
+  mat4 mat = mat4Identity();
+  mat.m[0][3] = x;
+  mat.m[1][3] = y;
+  mat.m[2][3] = z;
+  return mat;
+}
+
+mat4 mat4RotationX(float theta){
+  mat4 mat = mat4Identity();
+  float c = cosf(theta);
+  float s = sinf(theta);
+  mat.m[1][1] = c;
+  mat.m[1][2] = -s;
+  mat.m[2][1] = s;
+  mat.m[2][2] = c;
+  return mat;
+}
+
+mat4 mat4RotationY(float theta){
+  mat4 mat = mat4Identity();
+  float c = cosf(theta);
+  float s = sinf(theta);
+  mat.m[0][0] =  c;
+  mat.m[0][2] =  s;
+  mat.m[2][0] = -s;
+  mat.m[2][2] =  c;
+  return mat;
+}
+
+mat4 mat4RotationZ(float theta){
+  mat4 mat = mat4Identity();
+  float c = cosf(theta);
+  float s = sinf(theta);
+  mat.m[0][0] = c;
+  mat.m[0][1] = -s;
+  mat.m[1][0] = s;
+  mat.m[1][1] = c;
+  return mat;
+}
+
+mat4 mat4Multiply(const mat4 *a, const mat4 *b){
+  mat4 r;
+#if defined(__SSE__)
+  // each row of the result is a mix of the rows of b
+  __m128 b0 = _mm_loadu_ps(b->m[0]);
+  __m128 b1 = _mm_loadu_ps(b->m[1]);
+  __m128 b2 = _mm_loadu_ps(b->m[2]);
+  __m128 b3 = _mm_loadu_ps(b->m[3]);
+  for (int i = 0; i < 4; i++){
+    __m128 row = _mm_mul_ps(_mm_set1_ps(a->m[i][0]), b0);
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a->m[i][1]), b1));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a->m[i][2]), b2));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a->m[i][3]), b3));
+    _mm_storeu_ps(r.m[i], row);
+  }
+#else
+  for (int i = 0; i < 4; i++){
+    for (int j = 0; j < 4; j++){
+      r.m[i][j] = a->m[i][0] * b->m[0][j] + a->m[i][1] * b->m[1][j]
+                + a->m[i][2] * b->m[2][j] + a->m[i][3] * b->m[3][j];
+    }
+  }
+#endif
+  return r;
+}
+
+vec3 mat4TransformPoint(const mat4 *m, vec3 v){
+  // a single point is cheaper in scalar code than shuffling it into SSE
+  return vec3Make(
+    m->m[0][0] * v.x + m->m[0][1] * v.y + m->m[0][2] * v.z + m->m[0][3],
+    m->m[1][0] * v.x + m->m[1][1] * v.y + m->m[1][2] * v.z + m->m[1][3],
+    m->m[2][0] * v.x + m->m[2][1] * v.y + m->m[2][2] * v.z + m->m[2][3]);
+}
+
+void mat4TransformPoints(const mat4 *m, const vec3 *in, vec3 *out, int n){
+#if defined(__SSE__)
+  // transpose once, then each point is three multiply-adds of columns
+  __m128 c0 = _mm_loadu_ps(m->m[0]);
+  __m128 c1 = _mm_loadu_ps(m->m[1]);
+  __m128 c2 = _mm_loadu_ps(m->m[2]);
+  __m128 c3 = _mm_loadu_ps(m->m[3]);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  for (int i = 0; i < n; i++){
+    __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[i].x)), c3);
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[i].y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[i].z)));
+    float p[4];
+    _mm_storeu_ps(p, r);
+    out[i] = vec3Make(p[0], p[1], p[2]);
+  }
+#else
+  for (int i = 0; i < n; i++){
+    out[i] = mat4TransformPoint(m, in[i]);
+  }
+#endif
+}
+
+mat4 mat4LookAt(vec3 eye, vec3 target, vec3 up){
+  vec3 zaxis = vec3Normalise(vec3Sub(eye, target));
+  vec3 xaxis = vec3Normalise(vec3Cross(up, zaxis));
+  vec3 yaxis = vec3Cross(zaxis, xaxis);
+
+  mat4 view = mat4Identity();
+  view.m[0][0] = xaxis.x;
+  view.m[0][1] = xaxis.y;
+  view.m[0][2] = xaxis.z;
+  view.m[0][3] = -vec3Dot(xaxis, eye);
+
+  view.m[1][0] = yaxis.x;
+  view.m[1][1] = yaxis.y;
+  view.m[1][2] = yaxis.z;
+  view.m[1][3] = -vec3Dot(yaxis, eye);
+
+  view.m[2][0] = zaxis.x;
+  view.m[2][1] = zaxis.y;
+  view.m[2][2] = zaxis.z;
+  view.m[2][3] = -vec3Dot(zaxis, eye);
+  return view;
+}
+
+static plane combineRows(const mat4 *m, int row, float sign){
+  plane p = {
+    m->m[3][0] + sign * m->m[row][0],
+    m->m[3][1] + sign * m->m[row][1],
+    m->m[3][2] + sign * m->m[row][2],
+    m->m[3][3] + sign * m->m[row][3]
+  };
+  float len = sqrtf(p.a * p.a + p.b * p.b + p.c * p.c);
+  if (len > 0.0f){
+    p.a /= len;
+    p.b /= len;
+    p.c /= len;
+    p.d /= len;
+  }
+  return p;
+}
+
+frustum frustumFromMatrix(const mat4 *viewProj){
+  // -w <= x, y, z <= w in clip space, one plane per inequality
+  frustum f;
+  f.planes[0] = combineRows(viewProj, 0,  1.0f);
+  f.planes[1] = combineRows(viewProj, 0, -1.0f);
+  f.planes[2] = combineRows(viewProj, 1,  1.0f);
+  f.planes[3] = combineRows(viewProj, 1, -1.0f);
+  f.planes[4] = combineRows(viewProj, 2,  1.0f);
+  f.planes[5] = combineRows(viewProj, 2, -1.0f);
+  return f;
+}
+
+bool frustumTestBox(const frustum *f, vec3 min, vec3 max){
+  for (int i = 0; i < 6; i++){
+    const plane *p = &f->planes[i];
+    // the corner furthest along the plane normal
+    float x = p->a >= 0.0f ? max.x : min.x;
+    float y = p->b >= 0.0f ? max.y : min.y;
+    float z = p->c >= 0.0f ? max.z : min.z;
+    if (p->a * x + p->b * y + p->c * z + p->d < 0.0f) return false;
+  }
+  return true;
+}
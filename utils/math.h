@@ -1,6 +1,8 @@
 #ifndef MATH_H
 #define MATH_H
 
+#include <stdbool.h>
+
 struct vec3d{
   float x;
   float y;
@@ -41,4 +43,49 @@ extern float getZ(vec3d v);
 extern void normalise(vec3d u);
 extern float radians(float deg);
 
+// Value types: passed and returned by value, nothing to free. &v gives
+// the pointer types above for code that still wants them.
+typedef struct vec3d vec3;
+typedef struct mat4x4 mat4;
+
+extern vec3 vec3Make(float x, float y, float z);
+extern vec3 vec3Add(vec3 u, vec3 v);
+extern vec3 vec3Sub(vec3 u, vec3 v);
+extern vec3 vec3Scale(vec3 v, float scalar);
+extern vec3 vec3Cross(vec3 u, vec3 v);
+extern float vec3Dot(vec3 u, vec3 v);
+extern float vec3Length(vec3 v);
+// a zero vector is returned unchanged
+extern vec3 vec3Normalise(vec3 v);
+// u at t = 0, v at t = 1
+extern vec3 vec3Lerp(vec3 u, vec3 v, float t);
+
+extern mat4 mat4Identity(void);
+extern mat4 mat4Translation(float x, float y, float z);
+extern mat4 mat4RotationX(float theta);
+extern mat4 mat4RotationY(float theta);
+extern mat4 mat4RotationZ(float theta);
+// a * b, using SSE where available
+extern mat4 mat4Multiply(const mat4 *a, const mat4 *b);
+// m * (v, 1)
+extern vec3 mat4TransformPoint(const mat4 *m, vec3 v);
+// m * (in[i], 1) for n points, using SSE where available; in may be out
+extern void mat4TransformPoints(const mat4 *m, const vec3 *in, vec3 *out, int n);
+extern mat4 mat4LookAt(vec3 eye, vec3 target, vec3 up);
+
+// plane a*x + b*y + c*z + d = 0, the inside is where it is positive
+typedef struct {
+  float a, b, c, d;
+} plane;
+
+// left, right, bottom, top, near, far
+typedef struct {
+  plane planes[6];
+} frustum;
+
+// planes of the clip volume of proj * view, in world space
+extern frustum frustumFromMatrix(const mat4 *viewProj);
+// false only when the box is entirely outside one of the planes
+extern bool frustumTestBox(const frustum *f, vec3 min, vec3 max);
+
 #endif
\ No newline at end of file
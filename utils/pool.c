@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+struct pool;
+
+typedef struct {
+  pool p;
+  int index;
+} member;
+
+struct pool {
+  int threads;          // workers + 1, the caller runs index 0
+  pthread_t *handles;
+  member *members;
+  // one run at a time
+  pthread_mutex_t runLock;
+  // workers sleep on start until frame changes, the last one out signals done
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned frame;
+  int running;
+  bool quit;
+  // the run, only written while the workers sleep
+  poolfunc run;
+  void *arg;
+};
+
+static void *workerThread(void *arg){
+  member *m = arg;
+  pool p = m->p;
+  unsigned seen = 0;
+  pthread_mutex_lock(&p->lock);
+  for (;;){
+    while (!p->quit && p->frame == seen) pthread_cond_wait(&p->start, &p->lock);
+    if (p->quit) break;
+    seen = p->frame;
+    pthread_mutex_unlock(&p->lock);
+    p->run(p->arg, m->index, p->threads);
+    pthread_mutex_lock(&p->lock);
+    if (--p->running == 0) pthread_cond_signal(&p->done);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+pool createPool(const char *name, int workers){
+  pool new = malloc(sizeof(struct pool));
+  assert(new != NULL);
+  new->frame   = 0;
+  new->running = 0;
+  new->quit    = false;
+  new->run     = NULL;
+  new->arg     = NULL;
+  pthread_mutex_init(&new->runLock, NULL);
+  pthread_mutex_init(&new->lock, NULL);
+  pthread_cond_init(&new->start, NULL);
+  pthread_cond_init(&new->done, NULL);
+
+  new->threads = 1;
+  new->handles = malloc((workers + 1) * sizeof(pthread_t));
+  new->members = malloc((workers + 1) * sizeof(member));
+  assert(new->handles != NULL && new->members != NULL);
+  for (int i = 1; i <= workers; i++){
+    new->members[i] = (member){ new, i };
+    if (pthread_create(&new->handles[i], NULL, &workerThread, &new->members[i]) != 0){
+      fprintf(stderr, "Could not start %s worker %d, continuing with %d\n", name, i, new->threads - 1);
+      break;
+    }
+    new->threads++;
+  }
+  return new;
+}
+
+void freePool(pool p){
+  pthread_mutex_lock(&p->lock);
+  p->quit = true;
+  pthread_cond_broadcast(&p->start);
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 1; i < p->threads; i++) pthread_join(p->handles[i], NULL);
+  pthread_mutex_destroy(&p->runLock);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->start);
+  pthread_cond_destroy(&p->done);
+  free(p->handles);
+  free(p->members);
+  free(p);
+}
+
+int poolThreads(pool p){
+  return p->threads;
+}
+
+void poolRun(pool p, poolfunc run, void *arg){
+  pthread_mutex_lock(&p->runLock);
+  pthread_mutex_lock(&p->lock);
+  p->run     = run;
+  p->arg     = arg;
+  p->running = p->threads - 1;
+  p->frame++;
+  pthread_cond_broadcast(&p->start);
+  pthread_mutex_unlock(&p->lock);
+
+  run(arg, 0, p->threads);
+
+  pthread_mutex_lock(&p->lock);
+  while (p->running > 0) pthread_cond_wait(&p->done, &p->lock);
+  pthread_mutex_unlock(&p->lock);
+  pthread_mutex_unlock(&p->runLock);
+}
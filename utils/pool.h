@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * A pool of threads for splitting one piece of work between them. Every
+ * run calls the same function once on each thread, the calling one
+ * included, with that thread's index, and returns once all of them have
+ * finished. Threads sleep between runs.
+ *
+ * Runs from several threads at once take turns, so one pool can be
+ * shared by everything that splits work this way. A run must not start
+ * another on the same pool.
+ */
+struct pool;
+typedef struct pool *pool;
+
+// index is 0 on the calling thread, count is poolThreads
+typedef void (*poolfunc)(void *arg, int index, int count);
+
+// workers threads are started besides the calling one, 0 for none. name
+// is what the threads are called in messages
+extern pool createPool(const char *name, int workers);
+extern void freePool(pool p);
+// workers + the caller
+extern int poolThreads(pool p);
+extern void poolRun(pool p, poolfunc run, void *arg);
+
+#endif
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "session.h"
+
+#define SESSION_MAGIC   0x53534553u   // "SESS"
+#define SESSION_VERSION 1
+
+// what follows a record's tag
+#define SESSION_FRAME 1
+#define SESSION_END   2
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seed;
+  int32_t  maxSteps;
+  double   start;
+  double   step;
+} sessionHeader;
+
+// then cursorCount cursor samples, the face pose if there is one and the
+// body after the frame
+typedef struct {
+  uint32_t tag;
+  uint32_t keys;
+  uint32_t hasFace;
+  uint32_t cursorCount;
+  double now, faceNow, shownAt;
+} frameRecord;
+
+// the last record
+typedef struct {
+  uint32_t tag;
+  uint32_t frames;
+  uint64_t worldSum;
+} endRecord;
+
+struct session {
+  FILE *file;
+  const char *path;
+  bool replaying;
+  bool failed;          // stopped writing, or the recording is cut short
+  sessionHeader header;
+  int frames;
+  // replaying
+  sessionBody expected; // of the frame being replayed
+  bool ended;           // got to the end record
+  endRecord end;
+  int diverged;         // frames the body ended up elsewhere
+  int firstDiverged;
+  float firstDistance;
+};
+
+static session openSession(const char *path, const char *mode){
+  FILE *file = fopen(path, mode);
+  if (file == NULL){
+    perror(path);
+    return NULL;
+  }
+  session new = malloc(sizeof(struct session));
+  assert(new != NULL);
+  new->file          = file;
+  new->path          = path;
+  new->failed        = false;
+  new->frames        = 0;
+  new->ended         = false;
+  new->diverged      = 0;
+  new->firstDiverged = -1;
+  new->firstDistance = 0.0f;
+  return new;
+}
+
+session recordSession(const char *path, unsigned seed, double start, double step, int maxSteps){
+  session new = openSession(path, "wb");
+  if (new == NULL) return NULL;
+  new->replaying = false;
+  new->header = (sessionHeader){ SESSION_MAGIC, SESSION_VERSION, seed, maxSteps, start, step };
+  if (fwrite(&new->header, sizeof(sessionHeader), 1, new->file) != 1){
+    fprintf(stderr, "Cannot write %s\n", path);
+    fclose(new->file);
+    free(new);
+    return NULL;
+  }
+  return new;
+}
+
+session replaySession(const char *path, double step, int maxSteps){
+  session new = openSession(path, "rb");
+  if (new == NULL) return NULL;
+  new->replaying = true;
+  const char *problem = NULL;
+  if (fread(&new->header, sizeof(sessionHeader), 1, new->file) != 1 ||
+      new->header.magic != SESSION_MAGIC){
+    problem = "is not a session recording";
+  } else if (new->header.version != SESSION_VERSION){
+    problem = "is from another version";
+  } else if (new->header.step != step || new->header.maxSteps != maxSteps){
+    problem = "was recorded with another simulation rate";
+  }
+  if (problem != NULL){
+    fprintf(stderr, "%s %s\n", path, problem);
+    fclose(new->file);
+    free(new);
+    return NULL;
+  }
+  return new;
+}
+
+bool sessionReplaying(session s){
+  return s->replaying;
+}
+
+unsigned sessionSeed(session s){
+  return s->header.seed;
+}
+
+double sessionStart(session s){
+  return s->header.start;
+}
+
+void sessionAddCursor(sessionInput *in, double x, double y){
+  // only the newest position counts once the buffer is full, and the
+  // mouse is turned by the distance between positions
+  if (in->cursorCount == SESSION_MAX_CURSOR) in->cursorCount--;
+  in->cursor[in->cursorCount++] = (cursorSample){ x, y };
+}
+
+bool sessionNextInput(session s, sessionInput *in){
+  if (!s->replaying || s->failed || s->ended) return false;
+  uint32_t tag;
+  if (fread(&tag, sizeof(tag), 1, s->file) != 1){
+    s->failed = true;
+    return false;
+  }
+  if (tag == SESSION_END){
+    s->end.tag = tag;
+    if (fread(&s->end.frames, sizeof(endRecord) - sizeof(tag), 1, s->file) != 1){
+      s->failed = true;
+      return false;
+    }
+    s->ended = true;
+    return false;
+  }
+
+  frameRecord record;
+  record.tag = tag;
+  bool ok = tag == SESSION_FRAME &&
+            fread(&record.keys, sizeof(frameRecord) - sizeof(tag), 1, s->file) == 1 &&
+            record.cursorCount <= SESSION_MAX_CURSOR;
+  if (ok){
+    in->now         = record.now;
+    in->faceNow     = record.faceNow;
+    in->shownAt     = record.shownAt;
+    in->keys        = (uint8_t)record.keys;
+    in->hasFace     = record.hasFace != 0;
+    in->cursorCount = (int)record.cursorCount;
+    ok = fread(in->cursor, sizeof(cursorSample), in->cursorCount, s->file) == (size_t)in->cursorCount &&
+         (!in->hasFace || fread(&in->face, sizeof(facePose), 1, s->file) == 1) &&
+         fread(&s->expected, sizeof(sessionBody), 1, s->file) == 1;
+  }
+  if (!ok){
+    fprintf(stderr, "%s is damaged after frame %d\n", s->path, s->frames);
+    s->failed = true;
+  }
+  return ok;
+}
+
+void sessionEndFrame(session s, const sessionInput *in, const sessionBody *body){
+  if (s->failed) return;
+  if (s->replaying){
+    const sessionBody *e = &s->expected;
+    if (body->position.x != e->position.x || body->position.y != e->position.y ||
+        body->position.z != e->position.z || body->velocity.x != e->velocity.x ||
+        body->velocity.y != e->velocity.y || body->velocity.z != e->velocity.z ||
+        body->yaw != e->yaw || body->pitch != e->pitch){
+      if (s->diverged++ == 0){
+        s->firstDiverged = s->frames;
+        s->firstDistance = vec3Length(vec3Sub(body->position, e->position));
+      }
+    }
+    s->frames++;
+    return;
+  }
+
+  frameRecord record;
+  memset(&record, 0, sizeof(record));
+  record.tag         = SESSION_FRAME;
+  record.keys        = in->keys;
+  record.hasFace     = in->hasFace;
+  record.cursorCount = (uint32_t)in->cursorCount;
+  record.now         = in->now;
+  record.faceNow     = in->faceNow;
+  record.shownAt     = in->shownAt;
+  bool ok = fwrite(&record, sizeof(record), 1, s->file) == 1 &&
+            fwrite(in->cursor, sizeof(cursorSample), in->cursorCount, s->file) == (size_t)in->cursorCount &&
+            (!in->hasFace || fwrite(&in->face, sizeof(facePose), 1, s->file) == 1) &&
+            fwrite(body, sizeof(sessionBody), 1, s->file) == 1;
+  if (!ok){
+    fprintf(stderr, "Cannot write %s, stopped recording after frame %d\n", s->path, s->frames);
+    s->failed = true;
+    return;
+  }
+  s->frames++;
+}
+
+bool closeSession(session s, uint64_t worldSum){
+  bool same = true;
+  if (!s->replaying){
+    endRecord end = { SESSION_END, (uint32_t)s->frames, worldSum };
+    if (!s->failed && fwrite(&end, sizeof(end), 1, s->file) != 1){
+      fprintf(stderr, "Cannot write %s\n", s->path);
+    }
+    printf("Recorded %d frames to %s\n", s->frames, s->path);
+  } else {
+    if (s->diverged == 0){
+      printf("Replay: the body matched the recording on all %d frames\n", s->frames);
+    } else {
+      printf("Replay: the body went differently on %d of %d frames, first on frame %d by %.6f blocks\n",
+             s->diverged, s->frames, s->firstDiverged, s->firstDistance);
+      same = false;
+    }
+    if (!s->ended){
+      printf("Replay: stopped before the end of the recording, the world was not compared\n");
+      if (s->failed) same = false;
+    } else if (s->end.frames != (uint32_t)s->frames || s->end.worldSum != worldSum){
+      printf("Replay: the world differs from the recording's\n");
+      same = false;
+    } else {
+      printf("Replay: the world matches the recording's\n");
+    }
+  }
+  fclose(s->file);
+  free(s);
+  return same;
+}
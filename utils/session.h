@@ -0,0 +1,74 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "math.h"
+#include "../tracking/facerecv.h"
+
+/*
+ * Records everything a session fed into the simulation and plays it back
+ * frame for frame: when each frame started, the keys held, every cursor
+ * sample, the face pose read and the face clock readings the head filter
+ * saw. Together with the world seed that is all the simulation depends
+ * on, so a replay by the same build moves the body exactly as before.
+ *
+ * Each frame also records where the body ended up, and the recording
+ * ends with a checksum of the world, so a replay can say whether and
+ * where it went differently. All in the byte order of the machine that
+ * recorded it.
+ */
+struct session;
+typedef struct session *session;
+
+// cursor samples kept a frame, more are merged into the last one
+#define SESSION_MAX_CURSOR 32
+
+// the keys held during a frame
+#define SESSION_KEY_FORWARD 0x01
+#define SESSION_KEY_BACK    0x02
+#define SESSION_KEY_LEFT    0x04
+#define SESSION_KEY_RIGHT   0x08
+#define SESSION_KEY_JUMP    0x10
+
+typedef struct { double x, y; } cursorSample;
+
+typedef struct {
+  double now;           // when the frame started, on the frame clock
+  double faceNow;       // when the head pose was predicted, on the face clock
+  double shownAt;       // when the frame was handed to the display, ditto
+  uint8_t keys;
+  bool hasFace;         // a new pose was read this frame
+  int cursorCount;
+  cursorSample cursor[SESSION_MAX_CURSOR];
+  facePose face;
+} sessionInput;
+
+// the state a replay has to reproduce after every frame
+typedef struct {
+  vec3 position, velocity;
+  float yaw, pitch;
+} sessionBody;
+
+// step and maxSteps are the frame clock's, a replay needs the same ones.
+// NULL if the file cannot be written
+extern session recordSession(const char *path, unsigned seed, double start,
+                             double step, int maxSteps);
+// NULL if the file cannot be read or was recorded with another clock
+extern session replaySession(const char *path, double step, int maxSteps);
+extern bool sessionReplaying(session s);
+// of the world and the frame clock when recording started
+extern unsigned sessionSeed(session s);
+extern double sessionStart(session s);
+// adds a cursor sample to the frame's input
+extern void sessionAddCursor(sessionInput *in, double x, double y);
+// replaying, the input of the next frame, false once there are no more
+extern bool sessionNextInput(session s, sessionInput *in);
+// after the frame; recording writes it down, replaying checks the body
+extern void sessionEndFrame(session s, const sessionInput *in, const sessionBody *body);
+// writes or checks the world checksum, then reports on a replay. False
+// when the replay went differently from the recording
+extern bool closeSession(session s, uint64_t worldSum);
+
+#endif
@@ -2,8 +2,9 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
-#include <time.h>
+#include <stdatomic.h>
 
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
@@ -12,22 +13,64 @@
 #include "../utils/math.h"
 #include "../utils/shader.h"
 #include "../utils/perlin.h"
+#include "../utils/compress.h"
+#include "../adts/slab.h"
 
 #define STB_PERLIN_IMPLEMENTATION
 #include "../libs/stb_perlin.h"
 
-struct chunk{
+// Block data is reference counted so snapshots can share it. Writers call
+// uniqueBlocks first, which copies the data if anyone else holds it.
+struct blockdata{
+  atomic_int refs;
+  atomic_int coldRefs;  // of those, held by the cold tier's compressor
   uint8_t blocks[CHUNK_SIZE_X][CHUNK_SIZE_Y][CHUNK_SIZE_Z];
-  vec3d position; 
+};
+
+// total bytes duplicated by copy-on-write since startup, for snapshots
+// and for the compressor
+static atomic_ulong copiedBytes;
+static atomic_ulong coldCopiedBytes;
+
+// frame counter used to find chunks whose blocks nobody has looked at
+static unsigned currentFrame;
+static chunkTierStats tierStats;
+
+// every struct chunk lives in this pool, created on first use
+static slabpool chunkPool;
+
+struct chunk{
+  blockdata data;       // NULL while the chunk is cold
+  uint8_t *compressed;  // cold copy of the blocks
+  uint32_t compressedSize;
+  CODEC codec;
+  unsigned lastAccess;  // frame the blocks were last read or written
+  bool incompressible;  // came out no smaller, not tried again until written
+  int originX, originY, originZ;  // block coordinates of the chunk corner
+  struct chunk *neighbours[4];    // indexed by BACK, FRONT, LEFT, RIGHT
+  uint8_t minHeight, maxHeight;   // y range holding anything but air
+  uint8_t faceLinks[FACE_COUNT];  // per FACE, the faces it sees through the chunk
+  // per OCCLUDER_CELL square of columns, a y range that is opaque throughout
+  uint8_t occluderLow[OCCLUDER_CELLS][OCCLUDER_CELLS];
+  uint8_t occluderHigh[OCCLUDER_CELLS][OCCLUDER_CELLS];
   GLuint vao, vbo;
   GLuint waterVao, waterVbo;
   int numOfVertices;
   int numOfWaterVertices; 
   bool dirty; 
+  bool modified;
 };
 
 typedef struct chunk *chunk;
 
+static void thawBlocks(chunk c);
+
+// every access to the blocks goes through here, cold chunks are thawed
+static inline void touchBlocks(chunk c){
+  c->lastAccess = currentFrame;
+  if (c->data == NULL) thawBlocks(c);
+}
+
 typedef struct {
   float *data;
   int count; 
@@ -197,7 +240,61 @@ static void addAllFaces(mesh_buffer *mesh, int bx, int by, int bz, BLOCK_TYPE ty
   }
 }
 
+static bool blockIsOpaque(uint8_t block){
+  return block == BLOCK_DIRT || block == BLOCK_GRASS || block == BLOCK_OAK || block == BLOCK_LEAF;
+}
+
+#define ALL_FACES ((1 << FACE_COUNT) - 1)
+
+// Flood fills the air and water of the chunk. Faces touched by the same
+// open region can see each other through the chunk. Only the render
+// thread meshes, so the scratch space can be static.
+static void measureConnectivity(chunk c){
+  static uint8_t seen[CHUNK_BLOCK_BYTES];
+  static uint16_t stack[CHUNK_BLOCK_BYTES];
+  memset(seen, 0, sizeof(seen));
+  for (int i = 0; i < FACE_COUNT; i++) c->faceLinks[i] = 0;
+
+  const uint8_t *blocks = &c->data->blocks[0][0][0];
+  for (int start = 0; start < CHUNK_BLOCK_BYTES; start++){
+    if (seen[start] || blockIsOpaque(blocks[start])) continue;
+    int top = 0, faces = 0;
+    seen[start] = 1;
+    stack[top++] = start;
+    while (top > 0){
+      int i = stack[--top];
+      // blocks are [x][y][z], z varies fastest
+      int x = i / (CHUNK_SIZE_Y * CHUNK_SIZE_Z);
+      int y = (i / CHUNK_SIZE_Z) % CHUNK_SIZE_Y;
+      int z = i % CHUNK_SIZE_Z;
+      int next[6], n = 0;
+      if (x == 0) faces |= 1 << LEFT;   else next[n++] = i - CHUNK_SIZE_Y * CHUNK_SIZE_Z;
+      if (x == CHUNK_SIZE_X - 1) faces |= 1 << RIGHT; else next[n++] = i + CHUNK_SIZE_Y * CHUNK_SIZE_Z;
+      if (y == 0) faces |= 1 << BOTTOM; else next[n++] = i - CHUNK_SIZE_Z;
+      if (y == CHUNK_SIZE_Y - 1) faces |= 1 << TOP; else next[n++] = i + CHUNK_SIZE_Z;
+      if (z == 0) faces |= 1 << BACK;   else next[n++] = i - 1;
+      if (z == CHUNK_SIZE_Z - 1) faces |= 1 << FRONT; else next[n++] = i + 1;
+      for (int k = 0; k < n; k++){
+        if (seen[next[k]] || blockIsOpaque(blocks[next[k]])) continue;
+        seen[next[k]] = 1;
+        stack[top++] = next[k];
+      }
+    }
+    for (int f = 0; f < FACE_COUNT; f++){
+      if (faces & (1 << f)) c->faceLinks[f] |= faces;
+    }
+  }
+}
+
+// faces on the chunk border are hidden by solid blocks in a loaded neighbour
+static bool borderExposed(chunk c, int x, int y, int z){
+  BLOCK_TYPE type = getChunkBlockAt(c, x, y, z);
+  return type == BLOCK_AIR || type == BLOCK_NULL;
+}
+
 static void rebuildChunkMesh(chunk c){
+  touchBlocks(c);
+  measureConnectivity(c);
   mesh_buffer mesh;
   mesh_buffer waterMesh; 
   initMeshBuffer(&mesh);
@@ -207,9 +304,9 @@ static void rebuildChunkMesh(chunk c){
     for (int y = 0; y < CHUNK_SIZE_Y; y++) {
       for (int z = 0; z < CHUNK_SIZE_Z; z++) {
 
-        BLOCK_TYPE type = c->blocks[x][y][z];
+        BLOCK_TYPE type = c->data->blocks[x][y][z];
 
-        if (c->blocks[x][y][z] == BLOCK_AIR) continue;
+        if (c->data->blocks[x][y][z] == BLOCK_AIR) continue;
 
         mesh_buffer *targetMesh = (type == BLOCK_WATER) ? &waterMesh : &mesh;
         // if (type == BLOCK_WATER){
@@ -218,32 +315,32 @@ static void rebuildChunkMesh(chunk c){
         // mesh_buffer *targetMesh = &mesh;
 
         // LEFT
-        if (x == 0 || c->blocks[x-1][y][z] == BLOCK_AIR){
+        if (x == 0 ? borderExposed(c, x-1, y, z) : c->data->blocks[x-1][y][z] == BLOCK_AIR){
           addFace(targetMesh, faceVertices[LEFT], x, y, z, type, LEFT);
         }
 
         // RIGHT
-        if (x == CHUNK_SIZE_X - 1 || c->blocks[x+1][y][z] == BLOCK_AIR){
+        if (x == CHUNK_SIZE_X - 1 ? borderExposed(c, x+1, y, z) : c->data->blocks[x+1][y][z] == BLOCK_AIR){
           addFace(targetMesh, faceVertices[RIGHT], x, y, z, type, RIGHT);
         }
 
         // FRONT
-        if (z == CHUNK_SIZE_Z - 1 || c->blocks[x][y][z+1] == BLOCK_AIR){
+        if (z == CHUNK_SIZE_Z - 1 ? borderExposed(c, x, y, z+1) : c->data->blocks[x][y][z+1] == BLOCK_AIR){
           addFace(targetMesh, faceVertices[FRONT], x, y, z, type, FRONT);
         }
 
         // BACK
-        if (z == 0 || c->blocks[x][y][z-1] == BLOCK_AIR){
+        if (z == 0 ? borderExposed(c, x, y, z-1) : c->data->blocks[x][y][z-1] == BLOCK_AIR){
           addFace(targetMesh, faceVertices[BACK], x, y, z, type, BACK);
         }
 
         // TOP
-        if (y == CHUNK_SIZE_Y - 1 || c->blocks[x][y+1][z] == BLOCK_AIR){
+        if (y == CHUNK_SIZE_Y - 1 || c->data->blocks[x][y+1][z] == BLOCK_AIR){
           addFace(targetMesh, faceVertices[TOP], x, y, z, type, TOP);
         }
 
         // BOTTOM
-        if (y == 0 || c->blocks[x][y-1][z] == BLOCK_AIR){
+        if (y == 0 || c->data->blocks[x][y-1][z] == BLOCK_AIR){
           addFace(targetMesh, faceVertices[BOTTOM], x, y, z, type, BOTTOM);
         }
       }
@@ -311,7 +408,8 @@ static float octaveNoise(float x, float y, float z) {
 }
 
 bool chunkBlockIsSolid(chunk c, int x, int y, int z){
-  uint8_t block = c->blocks[x][y][z];
+  touchBlocks(c);
+  uint8_t block = c->data->blocks[x][y][z];
   return block == BLOCK_DIRT || block == BLOCK_OAK || block == BLOCK_GRASS || block == BLOCK_LEAF || block == BLOCK_WATER;
 }
 
@@ -344,17 +442,166 @@ float islandHeight(int x, int y, int size) {
   return elevation;
 }
 
-chunk createChunk(float x, float y, float z) {
-  chunk new = malloc(sizeof(struct chunk));
+static blockdata allocBlocks(void){
+  blockdata new = malloc(sizeof(struct blockdata));
   assert(new != NULL);
+  atomic_init(&new->refs, 1);
+  atomic_init(&new->coldRefs, 0);
+  return new;
+}
+
+blockdata shareChunkBlocks(chunk c){
+  touchBlocks(c);
+  atomic_fetch_add(&c->data->refs, 1);
+  return c->data;
+}
 
-  new->position = constructVec3d(x, y, z);
+blockdata shareChunkBlocksCold(chunk c){
+  blockdata b = shareChunkBlocks(c);
+  atomic_fetch_add(&b->coldRefs, 1);
+  return b;
+}
+
+void releaseBlocksCold(blockdata b){
+  atomic_fetch_sub(&b->coldRefs, 1);
+  releaseBlocks(b);
+}
+
+void releaseBlocks(blockdata b){
+  if (atomic_fetch_sub(&b->refs, 1) == 1){
+    free(b);
+  }
+}
+
+const uint8_t *getBlockDataBytes(blockdata b){
+  return &b->blocks[0][0][0];
+}
+
+unsigned long getCopyOnWriteBytes(void){
+  return atomic_load(&copiedBytes);
+}
+
+// make sure nobody else can see the writes we are about to do
+static void uniqueBlocks(chunk c){
+  int refs = atomic_load(&c->data->refs);
+  if (refs == 1) return;
+  // only the compressor is in the way, it is not a snapshot's copy
+  bool cold = atomic_load(&c->data->coldRefs) == refs - 1;
+  blockdata copy = allocBlocks();
+  memcpy(copy->blocks, c->data->blocks, CHUNK_BLOCK_BYTES);
+  releaseBlocks(c->data);
+  c->data = copy;
+  atomic_fetch_add(cold ? &coldCopiedBytes : &copiedBytes, CHUNK_BLOCK_BYTES);
+}
+
+// the lowest run of opaque blocks in each column, intersected over the cell
+static void measureOccluder(chunk c, int cellX, int cellZ){
+  int low = 0, high = CHUNK_SIZE_Y;
+  for (int x = cellX * OCCLUDER_CELL; x < (cellX + 1) * OCCLUDER_CELL; x++){
+    for (int z = cellZ * OCCLUDER_CELL; z < (cellZ + 1) * OCCLUDER_CELL; z++){
+      int y = 0;
+      while (y < CHUNK_SIZE_Y && !blockIsOpaque(c->data->blocks[x][y][z])) y++;
+      int top = y;
+      while (top < CHUNK_SIZE_Y && blockIsOpaque(c->data->blocks[x][top][z])) top++;
+      if (y > low) low = y;
+      if (top < high) high = top;
+    }
+  }
+  if (low >= high) low = high = 0;
+  c->occluderLow[cellX][cellZ]  = low;
+  c->occluderHigh[cellX][cellZ] = high;
+}
+
+// bumped whenever a chunk's height range grows
+static unsigned heightGeneration;
+
+// trees grow where the hash of a grass block and the seed says so
+static unsigned chunkSeed;
+
+void setChunkSeed(unsigned seed){
+  chunkSeed = seed;
+}
+
+unsigned getChunkSeed(void){
+  return chunkSeed;
+}
+
+static uint32_t blockHash(int x, int y, int z){
+  uint32_t h = chunkSeed;
+  h ^= (uint32_t)x * 0x8da6b343u;
+  h ^= (uint32_t)y * 0xd8163841u;
+  h ^= (uint32_t)z * 0xcb1ab31fu;
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+static void measureHeight(chunk c){
+  c->minHeight = CHUNK_SIZE_Y;
+  c->maxHeight = 0;
+  for (int x = 0; x < CHUNK_SIZE_X; x++){
+    for (int y = 0; y < CHUNK_SIZE_Y; y++){
+      for (int z = 0; z < CHUNK_SIZE_Z; z++){
+        if (c->data->blocks[x][y][z] == BLOCK_AIR) continue;
+        if (y < c->minHeight) c->minHeight = y;
+        if (y + 1 > c->maxHeight) c->maxHeight = y + 1;
+      }
+    }
+  }
+  for (int x = 0; x < OCCLUDER_CELLS; x++){
+    for (int z = 0; z < OCCLUDER_CELLS; z++){
+      measureOccluder(c, x, z);
+    }
+  }
+}
+
+static chunk allocChunk(float x, float y, float z){
+  if (chunkPool == NULL) chunkPool = slabPoolCreate(sizeof(struct chunk));
+  chunk new = slabAlloc(chunkPool);
+
+  new->data           = allocBlocks();
+  new->compressed     = NULL;
+  new->compressedSize = 0;
+  new->codec          = CODEC_RAW;
+  new->lastAccess     = currentFrame;
+  new->incompressible = false;
+
+  new->originX = (int)floorf(x);
+  new->originY = (int)floorf(y);
+  new->originZ = (int)floorf(z);
+  for (int i = 0; i < 4; i++) new->neighbours[i] = NULL;
+  // not known until the chunk is meshed
+  for (int i = 0; i < FACE_COUNT; i++) new->faceLinks[i] = ALL_FACES;
+
+  new->vao                = 0;
+  new->vbo                = 0;
+  new->numOfVertices      = 0;
+  new->waterVao           = 0;
+  new->waterVbo           = 0;
+  new->numOfWaterVertices = 0;
+  new->dirty              = true;
+  new->modified           = false;
+  return new;
+}
+
+chunk createChunkFromBlocks(float x, float y, float z, const uint8_t *blocks){
+  chunk new = allocChunk(x, y, z);
+  memcpy(new->data->blocks, blocks, CHUNK_BLOCK_BYTES);
+  measureHeight(new);
+  return new;
+}
+
+chunk createChunk(float x, float y, float z) {
+  chunk new = allocChunk(x, y, z);
 
   for (int cx = 0; cx < CHUNK_SIZE_X; cx++) {
     for (int cz = 0; cz < CHUNK_SIZE_Z; cz++) {
       // Calculate world coordinates for noise sampling
-      float worldX = new->position->x + (float)cx;
-      float worldZ = new->position->z + (float)cz;
+      float worldX = (float)(new->originX + cx);
+      float worldZ = (float)(new->originZ + cz);
 
       float noiseVal = octaveNoise(worldX * 0.1f, 0.0f, worldZ * 0.1f);
 
@@ -368,37 +615,35 @@ chunk createChunk(float x, float y, float z) {
 
       for (int cy = 0; cy < CHUNK_SIZE_Y; cy++) {
         if (cy < 3){
-          new->blocks[cx][cy][cz] = BLOCK_WATER;
+          new->data->blocks[cx][cy][cz] = BLOCK_WATER;
         }
         else if (cy < maxHeight - 1) {
-            new->blocks[cx][cy][cz] = BLOCK_DIRT;
+            new->data->blocks[cx][cy][cz] = BLOCK_DIRT;
         }
         else if (cy == maxHeight - 1) {
-            new->blocks[cx][cy][cz] = BLOCK_GRASS;
+            new->data->blocks[cx][cy][cz] = BLOCK_GRASS;
         }
         else {
-            new->blocks[cx][cy][cz] = BLOCK_AIR;
+            new->data->blocks[cx][cy][cz] = BLOCK_AIR;
         }
       }
 
     }
   }
 
-  srand(time(NULL));
-
   for (int cx = 1; cx < CHUNK_SIZE_X - 1; cx++){
     for (int cz = 1; cz < CHUNK_SIZE_Z - 1; cz++){
       for (int cy = 0; cy < CHUNK_SIZE_Y - 7; cy++){
-        if ( rand() % 63 == 0 && new->blocks[cx][cy][cz] == BLOCK_GRASS){
+        if ( blockHash(new->originX + cx, cy, new->originZ + cz) % 63 == 0 && new->data->blocks[cx][cy][cz] == BLOCK_GRASS){
 
           // add a tree
-          new->blocks[cx][cy+1][cz] = BLOCK_OAK;
-          new->blocks[cx][cy+2][cz] = BLOCK_OAK;
-          new->blocks[cx][cy+3][cz] = BLOCK_OAK;
+          new->data->blocks[cx][cy+1][cz] = BLOCK_OAK;
+          new->data->blocks[cx][cy+2][cz] = BLOCK_OAK;
+          new->data->blocks[cx][cy+3][cz] = BLOCK_OAK;
 
 
           // 2 layers of leaves
-          #define CURRBLOCK new->blocks[cx + xoffset][cy+yoffset][cz + zoffset]
+          #define CURRBLOCK new->data->blocks[cx + xoffset][cy+yoffset][cz + zoffset]
           for (int yoffset = 4; yoffset < 5; yoffset++){
             for (int xoffset = -1; xoffset < 2; xoffset++){
               for (int zoffset = -1; zoffset < 2; zoffset++){
@@ -409,41 +654,262 @@ chunk createChunk(float x, float y, float z) {
             }
           }
 
-          #define CURRBLOCK new->blocks[cx + xoffset][cy + 5][cz]
+          #define CURRBLOCK new->data->blocks[cx + xoffset][cy + 5][cz]
           for (int xoffset = -1; xoffset < 2; xoffset++){
             if (CURRBLOCK == BLOCK_AIR){
               CURRBLOCK = BLOCK_LEAF;
             }
           }
 
-          #define CURRBLOCK new->blocks[cx][cy + 5][cz + zoffset]
+          #define CURRBLOCK new->data->blocks[cx][cy + 5][cz + zoffset]
           for (int zoffset = -1; zoffset < 2; zoffset++){
             if (CURRBLOCK == BLOCK_AIR){
               CURRBLOCK = BLOCK_LEAF;
             }
           }
 
-          new->blocks[cx][cy+6][cz] = BLOCK_LEAF;
+          new->data->blocks[cx][cy+6][cz] = BLOCK_LEAF;
 
         }
       }
     }
   }
 
-  new->vao           = 0;
-  new->vbo           = 0;
-  new->numOfVertices = 0;
-  new->waterVao      = 0;
-  new->waterVbo      = 0;
-  new->dirty         = true;
-
+  measureHeight(new);
   return new;
 }
 
 
+void chunkHeightRange(chunk c, int *minY, int *maxY){
+  *minY = c->originY + c->minHeight;
+  *maxY = c->originY + c->maxHeight;
+}
+
+unsigned getChunkHeightGeneration(void){
+  return heightGeneration;
+}
+
+bool chunkFacesConnected(chunk c, FACE a, FACE b){
+  return (c->faceLinks[a] & (1 << b)) != 0;
+}
+
+bool chunkOccluder(chunk c, int cellX, int cellZ, vec3 *min, vec3 *max){
+  int low  = c->occluderLow[cellX][cellZ];
+  int high = c->occluderHigh[cellX][cellZ];
+  if (low >= high) return false;
+  float x = (float)(c->originX + cellX * OCCLUDER_CELL);
+  float z = (float)(c->originZ + cellZ * OCCLUDER_CELL);
+  *min = vec3Make(x, (float)(c->originY + low), z);
+  *max = vec3Make(x + OCCLUDER_CELL, (float)(c->originY + high), z + OCCLUDER_CELL);
+  return true;
+}
+
 void freeChunk(chunk c){
-  free(c->position);
-  free(c);
+  unlinkChunk(c);
+  if (c->vao != 0) glDeleteVertexArrays(1, &c->vao);
+  if (c->vbo != 0) glDeleteBuffers(1, &c->vbo);
+  if (c->waterVao != 0) glDeleteVertexArrays(1, &c->waterVao);
+  if (c->waterVbo != 0) glDeleteBuffers(1, &c->waterVbo);
+  if (c->data != NULL){
+    releaseBlocks(c->data);
+  } else {
+    tierStats.bytesSaved -= CHUNK_BLOCK_BYTES - c->compressedSize;
+    tierStats.coldChunks--;
+  }
+  free(c->compressed);
+  slabRelease(chunkPool, c);
+}
+
+size_t chunkMemoryBytes(chunk c){
+  size_t meshBytes  = (size_t)(c->numOfVertices + c->numOfWaterVertices) * 8 * sizeof(float);
+  size_t blockBytes = c->data != NULL ? sizeof(struct blockdata) : c->compressedSize;
+  return sizeof(struct chunk) + blockBytes + meshBytes;
+}
+
+void advanceChunkFrame(void){
+  currentFrame++;
+}
+
+unsigned getChunkFrame(void){
+  return currentFrame;
+}
+
+unsigned chunkIdleFrames(chunk c){
+  return currentFrame - c->lastAccess;
+}
+
+bool chunkIsCold(chunk c){
+  return c->data == NULL;
+}
+
+bool chunkIsIncompressible(chunk c){
+  return c->incompressible;
+}
+
+bool freezeChunk(chunk c, blockdata source, unsigned queuedFrame,
+                 const uint8_t *data, size_t size, CODEC codec){
+  // written to (new blocks) or read since the job was queued
+  if (c->data != source){
+    return false;
+  }
+  // the blocks are what was compressed, even if read since
+  if (size >= CHUNK_BLOCK_BYTES){
+    c->incompressible = true;
+    tierStats.incompressible++;
+    return false;
+  }
+  if ((int)(c->lastAccess - queuedFrame) > 0) return false;
+
+  c->compressed = malloc(size > 0 ? size : 1);
+  assert(c->compressed != NULL);
+  memcpy(c->compressed, data, size);
+  c->compressedSize = (uint32_t)size;
+  c->codec          = codec;
+  releaseBlocks(c->data);
+  c->data = NULL;
+
+  tierStats.compressions++;
+  tierStats.coldChunks++;
+  tierStats.bytesSaved += CHUNK_BLOCK_BYTES - size;
+  return true;
+}
+
+static void thawBlocks(chunk c){
+  blockdata b = allocBlocks();
+  long n = decompress(c->codec, c->compressed, c->compressedSize,
+                      &b->blocks[0][0][0], CHUNK_BLOCK_BYTES);
+  // we produced this data ourselves, so anything else is a bug
+  assert(n == CHUNK_BLOCK_BYTES);
+  (void) n;
+  free(c->compressed);
+  c->compressed = NULL;
+  c->data = b;
+
+  tierStats.decompressions++;
+  tierStats.coldChunks--;
+  tierStats.bytesSaved -= CHUNK_BLOCK_BYTES - c->compressedSize;
+  c->compressedSize = 0;
+}
+
+chunkTierStats getChunkTierStats(void){
+  chunkTierStats stats = tierStats;
+  stats.copiedBytes = atomic_load(&coldCopiedBytes);
+  return stats;
+}
+
+slabStats getChunkPoolStats(void){
+  if (chunkPool == NULL) chunkPool = slabPoolCreate(sizeof(struct chunk));
+  return slabPoolStats(chunkPool);
+}
+
+void reportChunkPool(FILE *out){
+  if (chunkPool == NULL) chunkPool = slabPoolCreate(sizeof(struct chunk));
+  slabPoolReport(out, chunkPool);
+}
+
+void releaseChunkPool(void){
+  if (chunkPool == NULL || slabPoolStats(chunkPool).inUse > 0) return;
+  slabPoolFree(chunkPool);
+  chunkPool = NULL;
+}
+
+const uint8_t *getChunkBlocks(chunk c){
+  touchBlocks(c);
+  return &c->data->blocks[0][0][0];
+}
+
+const uint8_t *peekChunkBlocks(chunk c){
+  return c->data != NULL ? &c->data->blocks[0][0][0] : NULL;
+}
+
+BLOCK_TYPE getChunkBlock(chunk c, int x, int y, int z){
+  touchBlocks(c);
+  return c->data->blocks[x][y][z];
+}
+
+void setChunkBlock(chunk c, int x, int y, int z, BLOCK_TYPE type){
+  touchBlocks(c);
+  if (c->data->blocks[x][y][z] == type) return;
+  uniqueBlocks(c);
+  c->data->blocks[x][y][z] = type;
+  c->dirty          = true;
+  c->modified       = true;
+  c->incompressible = false;
+  if (type != BLOCK_AIR && (y < c->minHeight || y + 1 > c->maxHeight)){
+    if (y < c->minHeight) c->minHeight = y;
+    if (y + 1 > c->maxHeight) c->maxHeight = y + 1;
+    heightGeneration++;
+  }
+  measureOccluder(c, x / OCCLUDER_CELL, z / OCCLUDER_CELL);
+  // until the remesh works it out again
+  for (int i = 0; i < FACE_COUNT; i++) c->faceLinks[i] = ALL_FACES;
+  // the neighbour's border faces may have changed too
+  if (x == 0 && c->neighbours[LEFT] != NULL) c->neighbours[LEFT]->dirty = true;
+  if (x == CHUNK_SIZE_X - 1 && c->neighbours[RIGHT] != NULL) c->neighbours[RIGHT]->dirty = true;
+  if (z == 0 && c->neighbours[BACK] != NULL) c->neighbours[BACK]->dirty = true;
+  if (z == CHUNK_SIZE_Z - 1 && c->neighbours[FRONT] != NULL) c->neighbours[FRONT]->dirty = true;
+}
+
+// BACK/FRONT and LEFT/RIGHT are adjacent in FACE
+static FACE oppositeSide(FACE side){
+  return (FACE)(side ^ 1);
+}
+
+chunk getChunkNeighbour(chunk c, FACE side){
+  return c->neighbours[side];
+}
+
+void linkChunks(chunk a, FACE side, chunk b){
+  a->neighbours[side] = b;
+  a->dirty = true;
+  if (b != NULL){
+    b->neighbours[oppositeSide(side)] = a;
+    b->dirty = true;
+  }
+}
+
+void unlinkChunk(chunk c){
+  for (int side = 0; side < 4; side++){
+    chunk n = c->neighbours[side];
+    if (n == NULL) continue;
+    n->neighbours[oppositeSide(side)] = NULL;
+    n->dirty = true;
+    c->neighbours[side] = NULL;
+  }
+}
+
+BLOCK_TYPE getChunkBlockAt(chunk c, int x, int y, int z){
+  if (y < 0 || y >= CHUNK_SIZE_Y) return BLOCK_NULL;
+  while (x < 0){
+    c = c->neighbours[LEFT];
+    if (c == NULL) return BLOCK_NULL;
+    x += CHUNK_SIZE_X;
+  }
+  while (x >= CHUNK_SIZE_X){
+    c = c->neighbours[RIGHT];
+    if (c == NULL) return BLOCK_NULL;
+    x -= CHUNK_SIZE_X;
+  }
+  while (z < 0){
+    c = c->neighbours[BACK];
+    if (c == NULL) return BLOCK_NULL;
+    z += CHUNK_SIZE_Z;
+  }
+  while (z >= CHUNK_SIZE_Z){
+    c = c->neighbours[FRONT];
+    if (c == NULL) return BLOCK_NULL;
+    z -= CHUNK_SIZE_Z;
+  }
+  touchBlocks(c);
+  return c->data->blocks[x][y][z];
+}
+
+bool chunkIsModified(chunk c){
+  return c->modified;
+}
+
+void setChunkModified(chunk c, bool modified){
+  c->modified = modified;
 }
 
 void renderChunk(
@@ -465,14 +931,14 @@ void renderChunk(
     c->dirty = false;
   }
 
-  mat4x4 model = constructTranslationMatrix(c->position->x, c->position->y, c->position->z);
+  mat4 model = mat4Translation((float)c->originX, (float)c->originY, (float)c->originZ);
   
-  useShader(program, model, view, proj, lightPos, viewPos, time, texture, reflectedTex, dudvTex, normalTex);
+  useShader(program, &model, view, proj, lightPos, viewPos, time, texture, reflectedTex, dudvTex, normalTex);
   glBindVertexArray(c->vao);
   glDrawArrays(GL_TRIANGLES, 0, c->numOfVertices);
 
   if (!fake){
-    useShader(waterShader, model, view, proj, lightPos, viewPos, time, texture, reflectedTex, dudvTex, normalTex);
+    useShader(waterShader, &model, view, proj, lightPos, viewPos, time, texture, reflectedTex, dudvTex, normalTex);
     glBindVertexArray(c->waterVao);
     glDrawArrays(GL_TRIANGLES, 0, c->numOfWaterVertices);
   }
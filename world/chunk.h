@@ -1,22 +1,36 @@
 #ifndef CHUNK_H
 #define CHUNK_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "../utils/math.h"
+#include "../utils/compress.h"
+#include "../adts/slab.h"
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 
 #define CHUNK_SIZE_X 16
 #define CHUNK_SIZE_Y 16
 #define CHUNK_SIZE_Z 16
+#define CHUNK_BLOCK_BYTES (CHUNK_SIZE_X * CHUNK_SIZE_Y * CHUNK_SIZE_Z)
 #define VERTEX_COUNT 48
 #define FACE_COUNT   6
 
 #define INITIAL_CAPACITY 1024
 
+// occluders are kept per OCCLUDER_CELL x OCCLUDER_CELL square of columns
+#define OCCLUDER_CELL  4
+#define OCCLUDER_CELLS (CHUNK_SIZE_X / OCCLUDER_CELL)
+
 struct chunk;
 
 typedef struct chunk *chunk;
 
+// a chunk's block array, shared copy-on-write with snapshots
+struct blockdata;
+typedef struct blockdata *blockdata;
+
 typedef enum {
   BLOCK_AIR,
   BLOCK_DIRT,
@@ -42,10 +56,89 @@ typedef struct{
   int value;
 } textureMap; 
 
+typedef struct {
+  unsigned long compressions;   // chunks moved to the cold tier
+  unsigned long decompressions; // cold chunks thawed on access
+  int coldChunks;
+  long bytesSaved;              // block bytes not resident right now
+  unsigned long incompressible; // compressed no smaller, left hot until written
+  unsigned long copiedBytes;    // copied on write while being compressed
+} chunkTierStats;
+
 // functions provided
 extern bool chunkBlockIsSolid(chunk c, int x, int y, int z);
 extern chunk createChunk(float x, float y, float z);
+// chunks generated under the same seed grow the same trees
+extern void setChunkSeed(unsigned seed);
+extern unsigned getChunkSeed(void);
+// builds a chunk from CHUNK_BLOCK_BYTES of saved block data (x major, z minor)
+extern chunk createChunkFromBlocks(float x, float y, float z, const uint8_t *blocks);
 extern void freeChunk(chunk c);
+extern const uint8_t *getChunkBlocks(chunk c);
+// the blocks without touching them, NULL while the chunk is cold. Several
+// threads may peek at once as long as none changes or touches the chunk.
+extern const uint8_t *peekChunkBlocks(chunk c);
+extern BLOCK_TYPE getChunkBlock(chunk c, int x, int y, int z);
+// Neighbours across the BACK (-z), FRONT (+z), LEFT (-x) and RIGHT (+x)
+// faces, NULL when not loaded. The world keeps the links up to date.
+extern chunk getChunkNeighbour(chunk c, FACE side);
+// links a and b both ways, b may be NULL to clear that side of a
+extern void linkChunks(chunk a, FACE side, chunk b);
+// drops every link to and from c, freeChunk does this itself
+extern void unlinkChunk(chunk c);
+// x and z may lie outside the chunk, the lookup follows neighbour links.
+// BLOCK_NULL when that chunk is not loaded or y is out of range.
+extern BLOCK_TYPE getChunkBlockAt(chunk c, int x, int y, int z);
+// marks the chunk for remeshing and saving
+extern void setChunkBlock(chunk c, int x, int y, int z, BLOCK_TYPE type);
+// block y range [minY, maxY) of everything but air, empty when the chunk
+// is all air. Removing blocks does not shrink it.
+extern void chunkHeightRange(chunk c, int *minY, int *maxY);
+// changes whenever some chunk's height range grows
+extern unsigned getChunkHeightGeneration(void);
+// whether air or water joins faces a and b inside the chunk, worked out
+// when it is meshed. Until then every pair counts as joined.
+extern bool chunkFacesConnected(chunk c, FACE a, FACE b);
+// a box of opaque blocks in the given cell, false when there is none.
+// Anything behind it is hidden, so it can be used for occlusion culling.
+extern bool chunkOccluder(chunk c, int cellX, int cellZ, vec3 *min, vec3 *max);
+// modified chunks differ from what is in the save
+extern bool chunkIsModified(chunk c);
+extern void setChunkModified(chunk c, bool modified);
+// take a reference to the chunk's current blocks, they will not change
+// under you: the next write to the chunk copies them instead
+extern blockdata shareChunkBlocks(chunk c);
+extern void releaseBlocks(blockdata b);
+// the same for the cold tier's compressor, whose copies on write are
+// counted in its stats rather than in getCopyOnWriteBytes
+extern blockdata shareChunkBlocksCold(chunk c);
+extern void releaseBlocksCold(blockdata b);
+extern const uint8_t *getBlockDataBytes(blockdata b);
+// total bytes copied because a chunk shared with a snapshot was written to
+extern unsigned long getCopyOnWriteBytes(void);
+// Cold tier: blocks of chunks nobody touches are kept compressed and
+// thawed transparently by any accessor below.
+extern void advanceChunkFrame(void);
+extern unsigned getChunkFrame(void);
+// frames since the blocks were last read or written
+extern unsigned chunkIdleFrames(chunk c);
+extern bool chunkIsCold(chunk c);
+// compressing it did not help, and it has not been written to since
+extern bool chunkIsIncompressible(chunk c);
+// swap in a compressed copy of source made by a worker. Fails, leaving the
+// chunk hot, if the blocks were touched since queuedFrame or the copy is
+// no smaller, which marks the chunk incompressible.
+extern bool freezeChunk(chunk c, blockdata source, unsigned queuedFrame,
+                        const uint8_t *data, size_t size, CODEC codec);
+extern chunkTierStats getChunkTierStats(void);
+// chunks come from a slab pool, these describe how well it is packed
+extern slabStats getChunkPoolStats(void);
+extern void reportChunkPool(FILE *out);
+// gives the pool's memory back once every chunk has been freed, it is
+// made again by the next chunk
+extern void releaseChunkPool(void);
+// bytes held by the chunk: block data plus its meshes on the GPU
+extern size_t chunkMemoryBytes(chunk c);
 extern void renderChunk(
   chunk c, 
   GLuint program, 
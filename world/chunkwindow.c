@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "chunkwindow.h"
+#include "../adts/chunkmap.h"
+#include "chunk.h"
+
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define WINDOW_HALF (WINDOW_SIZE / 2)
+
+struct chunkwindow {
+  // lowest chunk coordinate covered on each axis
+  int minX, minZ;
+  bool centred;
+  chunk slots[WINDOW_SIZE][WINDOW_SIZE];
+};
+
+chunkwindow createChunkWindow(void){
+  chunkwindow new = malloc(sizeof(struct chunkwindow));
+  assert(new != NULL);
+  new->minX    = 0;
+  new->minZ    = 0;
+  new->centred = false;
+  for (int i = 0; i < WINDOW_SIZE; i++){
+    for (int j = 0; j < WINDOW_SIZE; j++){
+      new->slots[i][j] = NULL;
+    }
+  }
+  return new;
+}
+
+void freeChunkWindow(chunkwindow win){
+  // the chunks themselves are owned by the world's chunk map
+  free(win);
+}
+
+// the unique coordinate in [min, min + WINDOW_SIZE) that maps onto slot i
+static inline int slotCoord(int min, int i){
+  return min + ((i - min) & WINDOW_MASK);
+}
+
+void recentreChunkWindow(chunkwindow win, chunkmap map, int centreX, int centreZ){
+  int minX = centreX - WINDOW_HALF;
+  int minZ = centreZ - WINDOW_HALF;
+  if (win->centred && minX == win->minX && minZ == win->minZ){
+    return;
+  }
+
+  for (int i = 0; i < WINDOW_SIZE; i++){
+    int x = slotCoord(minX, i);
+    bool rowValid = win->centred && x == slotCoord(win->minX, i);
+    for (int j = 0; j < WINDOW_SIZE; j++){
+      int z = slotCoord(minZ, j);
+      if (rowValid && z == slotCoord(win->minZ, j)){
+        continue;
+      }
+      win->slots[i][j] = chunkMapFind(map, x, z);
+    }
+  }
+
+  win->minX    = minX;
+  win->minZ    = minZ;
+  win->centred = true;
+}
+
+bool chunkWindowContains(chunkwindow win, int x, int z){
+  // unsigned compare folds both bounds checks into one
+  return win->centred
+    && (unsigned)(x - win->minX) < WINDOW_SIZE
+    && (unsigned)(z - win->minZ) < WINDOW_SIZE;
+}
+
+chunk chunkWindowFind(chunkwindow win, chunkmap map, int x, int z){
+  if (chunkWindowContains(win, x, z)){
+    return win->slots[x & WINDOW_MASK][z & WINDOW_MASK];
+  }
+  return chunkMapFind(map, x, z);
+}
+
+void chunkWindowUpdate(chunkwindow win, int x, int z, chunk c){
+  if (chunkWindowContains(win, x, z)){
+    win->slots[x & WINDOW_MASK][z & WINDOW_MASK] = c;
+  }
+}
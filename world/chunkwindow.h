@@ -0,0 +1,31 @@
+#ifndef CHUNKWINDOW_H
+#define CHUNKWINDOW_H
+
+#include "../adts/chunkmap.h"
+#include "chunk.h"
+
+// Side length of the window in chunks. Must be a power of two and cover
+// the render distance on both sides of the camera chunk.
+#define WINDOW_SIZE 16
+
+/*
+ * A toroidal ring buffer of chunk slots around the camera. The chunk at
+ * (x, z) lives in slot [x mod WINDOW_SIZE][z mod WINDOW_SIZE] so looking
+ * up a nearby chunk is an index, not a hash. Recentring only refreshes
+ * the rows/columns whose coordinates changed.
+ */
+struct chunkwindow;
+typedef struct chunkwindow *chunkwindow;
+
+extern chunkwindow createChunkWindow(void);
+extern void freeChunkWindow(chunkwindow win);
+// move the window so (centreX, centreZ) is in the middle, refilling from map
+extern void recentreChunkWindow(chunkwindow win, chunkmap map, int centreX, int centreZ);
+// true when (x, z) is covered by the window
+extern bool chunkWindowContains(chunkwindow win, int x, int z);
+// window lookup, falling back to the map for chunks outside the window
+extern chunk chunkWindowFind(chunkwindow win, chunkmap map, int x, int z);
+// keep the window in sync when the map gains or loses (x, z), c may be NULL
+extern void chunkWindowUpdate(chunkwindow win, int x, int z, chunk c);
+
+#endif
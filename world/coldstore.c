@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "coldstore.h"
+#include "chunk.h"
+#include "../adts/chunkmap.h"
+#include "../utils/compress.h"
+
+#define SCAN_INTERVAL 30  // frames between looks for idle chunks
+
+typedef struct coldJob {
+  int x, z;
+  blockdata source;     // reference held until the job is finished
+  unsigned queuedFrame;
+  uint8_t *data;        // filled in by the worker
+  size_t size;
+  CODEC codec;
+  struct coldJob *next;
+} coldJob;
+
+struct coldstore {
+  unsigned idleFrames;
+  unsigned framesSinceScan;
+  chunkmap queued;      // chunks with a job in flight, main thread only
+
+  pthread_t worker;
+  bool running;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  coldJob *todo;
+  coldJob *done;
+  bool quit;
+};
+
+static void freeJob(coldJob *job){
+  releaseBlocksCold(job->source);
+  free(job->data);
+  free(job);
+}
+
+static void *workerThread(void *arg){
+  coldstore s = arg;
+  pthread_mutex_lock(&s->lock);
+  for (;;){
+    while (s->todo == NULL && !s->quit){
+      pthread_cond_wait(&s->wake, &s->lock);
+    }
+    if (s->quit) break;
+
+    coldJob *job = s->todo;
+    s->todo = job->next;
+    pthread_mutex_unlock(&s->lock);
+
+    uint8_t buffer[CHUNK_BLOCK_BYTES];
+    job->size = compressBest(getBlockDataBytes(job->source), CHUNK_BLOCK_BYTES, buffer, &job->codec);
+    job->data = malloc(job->size > 0 ? job->size : 1);
+    assert(job->data != NULL);
+    memcpy(job->data, buffer, job->size);
+
+    pthread_mutex_lock(&s->lock);
+    job->next = s->done;
+    s->done = job;
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+coldstore createColdStore(unsigned idleFrames){
+  coldstore new = malloc(sizeof(struct coldstore));
+  assert(new != NULL);
+  new->idleFrames      = idleFrames;
+  new->framesSinceScan = 0;
+  new->queued          = chunkMapCreate(NULL);
+  new->todo            = NULL;
+  new->done            = NULL;
+  new->quit            = false;
+  pthread_mutex_init(&new->lock, NULL);
+  pthread_cond_init(&new->wake, NULL);
+  new->running = pthread_create(&new->worker, NULL, &workerThread, new) == 0;
+  return new;
+}
+
+static void freeJobList(coldJob *job){
+  while (job != NULL){
+    coldJob *next = job->next;
+    freeJob(job);
+    job = next;
+  }
+}
+
+void freeColdStore(coldstore s){
+  if (s->running){
+    pthread_mutex_lock(&s->lock);
+    s->quit = true;
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->worker, NULL);
+  }
+  freeJobList(s->todo);
+  freeJobList(s->done);
+  chunkMapFree(s->queued);
+  pthread_mutex_destroy(&s->lock);
+  pthread_cond_destroy(&s->wake);
+  free(s);
+}
+
+void setColdStoreIdleFrames(coldstore s, unsigned idleFrames){
+  s->idleFrames = idleFrames;
+}
+
+typedef struct {
+  coldstore s;
+  coldJob *jobs;
+} scanArg;
+
+static void scanCallback(int x, int z, void *el, void *arg){
+  chunk c = el;
+  scanArg *scan = arg;
+  if (chunkIsCold(c) || chunkIsIncompressible(c) || chunkIdleFrames(c) < scan->s->idleFrames) return;
+  if (chunkMapFind(scan->s->queued, x, z) != NULL) return;
+
+  coldJob *job = malloc(sizeof(coldJob));
+  assert(job != NULL);
+  job->x           = x;
+  job->z           = z;
+  job->source      = shareChunkBlocksCold(c);
+  job->queuedFrame = getChunkFrame();
+  job->data        = NULL;
+  job->size        = 0;
+  job->next        = scan->jobs;
+  scan->jobs = job;
+  chunkMapSet(scan->s->queued, x, z, job);
+}
+
+void coldStoreUpdate(coldstore s, chunkmap chunks){
+  if (!s->running) return;
+
+  pthread_mutex_lock(&s->lock);
+  coldJob *done = s->done;
+  s->done = NULL;
+  pthread_mutex_unlock(&s->lock);
+
+  while (done != NULL){
+    coldJob *next = done->next;
+    // the chunk may have been evicted while we were busy
+    chunk c = chunkMapFind(chunks, done->x, done->z);
+    if (c != NULL){
+      freezeChunk(c, done->source, done->queuedFrame, done->data, done->size, done->codec);
+    }
+    chunkMapRemove(s->queued, done->x, done->z);
+    freeJob(done);
+    done = next;
+  }
+
+  if (s->idleFrames == 0 || ++s->framesSinceScan < SCAN_INTERVAL) return;
+  s->framesSinceScan = 0;
+
+  scanArg scan = { s, NULL };
+  chunkMapForeach(chunks, &scanCallback, &scan);
+  if (scan.jobs == NULL) return;
+
+  coldJob *last = scan.jobs;
+  while (last->next != NULL) last = last->next;
+
+  pthread_mutex_lock(&s->lock);
+  last->next = s->todo;
+  s->todo = scan.jobs;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+}
@@ -0,0 +1,22 @@
+#ifndef COLDSTORE_H
+#define COLDSTORE_H
+
+#include "../adts/chunkmap.h"
+
+/*
+ * Moves chunks whose blocks have not been touched for a number of frames
+ * into the compressed cold tier. Compression runs on a worker thread; the
+ * results are swapped in on the main thread by coldStoreUpdate, and only
+ * if the chunk was left alone in the meantime.
+ */
+struct coldstore;
+typedef struct coldstore *coldstore;
+
+// idleFrames of 0 disables the cold tier
+extern coldstore createColdStore(unsigned idleFrames);
+extern void freeColdStore(coldstore s);
+extern void setColdStoreIdleFrames(coldstore s, unsigned idleFrames);
+// once per frame on the main thread: install finished work, queue new work
+extern void coldStoreUpdate(coldstore s, chunkmap chunks);
+
+#endif
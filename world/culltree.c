@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <float.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "culltree.h"
+#include "chunk.h"
+
+#define MAX_DEPTH   16
+#define STACK_SIZE  (3 * MAX_DEPTH + 4)
+#define ALL_PLANES  0x3f
+
+// One level of the tree. Node i covers the columns whose Morton code
+// shifted down to this level is i, so the children of node i are
+// 4i .. 4i+3 on the level below.
+typedef struct {
+  float *minX, *minY, *minZ;
+  float *maxX, *maxY, *maxZ;
+} level;
+
+struct culltree {
+  int width, height;
+  int depth;               // leaves are on level depth
+  level levels[MAX_DEPTH + 1];
+};
+
+// a group of four nodes still to be tested and the planes they may cross
+typedef struct {
+  int level;
+  int first;
+  int planes;
+} pending;
+
+static uint32_t spreadBits(uint32_t v){
+  v &= 0xffff;
+  v = (v | (v << 8)) & 0x00ff00ff;
+  v = (v | (v << 4)) & 0x0f0f0f0f;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+static uint32_t compactBits(uint32_t v){
+  v &= 0x55555555;
+  v = (v | (v >> 1)) & 0x33333333;
+  v = (v | (v >> 2)) & 0x0f0f0f0f;
+  v = (v | (v >> 4)) & 0x00ff00ff;
+  v = (v | (v >> 8)) & 0x0000ffff;
+  return v;
+}
+
+static inline uint32_t morton(int x, int z){
+  return spreadBits((uint32_t)x) | (spreadBits((uint32_t)z) << 1);
+}
+
+static inline bool nodeEmpty(const level *l, int i){
+  return l->minY[i] > l->maxY[i];
+}
+
+static float *allocFloats(int n){
+  // 16 byte aligned so four siblings load as one vector
+  float *new = aligned_alloc(16, (size_t)n * sizeof(float));
+  assert(new != NULL);
+  return new;
+}
+
+culltree createCullTree(int width, int height){
+  culltree new = malloc(sizeof(struct culltree));
+  assert(new != NULL);
+  new->width  = width;
+  new->height = height;
+  new->depth  = 0;
+  while ((1 << new->depth) < width || (1 << new->depth) < height) new->depth++;
+  assert(new->depth <= MAX_DEPTH);
+
+  for (int l = 0; l <= new->depth; l++){
+    level *lv = &new->levels[l];
+    int nodes = 1 << (2 * l);
+    int alloc = nodes < 4 ? 4 : nodes;
+    lv->minX = allocFloats(alloc);
+    lv->minY = allocFloats(alloc);
+    lv->minZ = allocFloats(alloc);
+    lv->maxX = allocFloats(alloc);
+    lv->maxY = allocFloats(alloc);
+    lv->maxZ = allocFloats(alloc);
+    int span = 1 << (new->depth - l);
+    for (int i = 0; i < alloc; i++){
+      int x0 = (int)compactBits(i) * span;
+      int z0 = (int)compactBits(i >> 1) * span;
+      int x1 = x0 + span < width  ? x0 + span : width;
+      int z1 = z0 + span < height ? z0 + span : height;
+      lv->minX[i] = (float)(x0 * CHUNK_SIZE_X);
+      lv->minZ[i] = (float)(z0 * CHUNK_SIZE_Z);
+      lv->maxX[i] = (float)(x1 * CHUNK_SIZE_X);
+      lv->maxZ[i] = (float)(z1 * CHUNK_SIZE_Z);
+      if (i < nodes && x0 < width && z0 < height){
+        // nothing is known about these columns yet
+        lv->minY[i] = 0.0f;
+        lv->maxY[i] = (float)CHUNK_SIZE_Y;
+      } else {
+        lv->minY[i] = FLT_MAX;
+        lv->maxY[i] = -FLT_MAX;
+      }
+    }
+  }
+  return new;
+}
+
+void freeCullTree(culltree t){
+  for (int l = 0; l <= t->depth; l++){
+    level *lv = &t->levels[l];
+    free(lv->minX);
+    free(lv->minY);
+    free(lv->minZ);
+    free(lv->maxX);
+    free(lv->maxY);
+    free(lv->maxZ);
+  }
+  free(t);
+}
+
+static void setLeaf(culltree t, int x, int z, float minY, float maxY){
+  if (x < 0 || x >= t->width || z < 0 || z >= t->height) return;
+  uint32_t i = morton(x, z);
+  level *leaf = &t->levels[t->depth];
+  if (minY >= maxY){
+    minY = FLT_MAX;
+    maxY = -FLT_MAX;
+  }
+  if (leaf->minY[i] == minY && leaf->maxY[i] == maxY) return;
+  leaf->minY[i] = minY;
+  leaf->maxY[i] = maxY;
+
+  // the heights of every ancestor are the union of their children
+  for (int l = t->depth - 1; l >= 0; l--){
+    const level *below = &t->levels[l + 1];
+    level *lv = &t->levels[l];
+    uint32_t first = i & ~3u;
+    i >>= 2;
+    float lo = below->minY[first];
+    float hi = below->maxY[first];
+    for (int c = 1; c < 4; c++){
+      if (below->minY[first + c] < lo) lo = below->minY[first + c];
+      if (below->maxY[first + c] > hi) hi = below->maxY[first + c];
+    }
+    if (lv->minY[i] == lo && lv->maxY[i] == hi) break;
+    lv->minY[i] = lo;
+    lv->maxY[i] = hi;
+  }
+}
+
+void cullTreeSetColumn(culltree t, int x, int z, float minY, float maxY){
+  setLeaf(t, x, z, minY, maxY);
+}
+
+void cullTreeResetColumn(culltree t, int x, int z){
+  setLeaf(t, x, z, 0.0f, (float)CHUNK_SIZE_Y);
+}
+
+// Tests four siblings against the planes in mask. Bit l of the result is
+// set when node first + l is at least partly inside, and crossing[l] gets
+// the planes it straddles, the only ones its children need testing against.
+static int testSiblings(const level *lv, int first, const frustum *f, int mask, int crossing[4]){
+  int visible = 0xf;
+  for (int c = 0; c < 4; c++) crossing[c] = 0;
+#if defined(__SSE__)
+  __m128 minX = _mm_load_ps(lv->minX + first);
+  __m128 minY = _mm_load_ps(lv->minY + first);
+  __m128 minZ = _mm_load_ps(lv->minZ + first);
+  __m128 maxX = _mm_load_ps(lv->maxX + first);
+  __m128 maxY = _mm_load_ps(lv->maxY + first);
+  __m128 maxZ = _mm_load_ps(lv->maxZ + first);
+  visible &= _mm_movemask_ps(_mm_cmple_ps(minY, maxY));
+  for (int p = 0; p < 6 && visible != 0; p++){
+    if (!(mask & (1 << p))) continue;
+    const plane *pl = &f->planes[p];
+    // the corner furthest along the normal is the same for all four
+    bool ax = pl->a >= 0.0f, by = pl->b >= 0.0f, cz = pl->c >= 0.0f;
+    __m128 a = _mm_set1_ps(pl->a), b = _mm_set1_ps(pl->b);
+    __m128 c = _mm_set1_ps(pl->c), d = _mm_set1_ps(pl->d);
+    // summed in the same order as frustumTestBox so both agree exactly
+    __m128 far = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, ax ? maxX : minX),
+                                                  _mm_mul_ps(b, by ? maxY : minY)),
+                                       _mm_mul_ps(c, cz ? maxZ : minZ)), d);
+    __m128 near = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, ax ? minX : maxX),
+                                                   _mm_mul_ps(b, by ? minY : maxY)),
+                                        _mm_mul_ps(c, cz ? minZ : maxZ)), d);
+    __m128 zero = _mm_setzero_ps();
+    visible &= ~_mm_movemask_ps(_mm_cmplt_ps(far, zero));
+    int straddles = _mm_movemask_ps(_mm_cmplt_ps(near, zero));
+    for (int l = 0; l < 4; l++){
+      if (straddles & (1 << l)) crossing[l] |= 1 << p;
+    }
+  }
+#else
+  for (int l = 0; l < 4; l++){
+    int i = first + l;
+    if (nodeEmpty(lv, i)){
+      visible &= ~(1 << l);
+      continue;
+    }
+    for (int p = 0; p < 6; p++){
+      if (!(mask & (1 << p))) continue;
+      const plane *pl = &f->planes[p];
+      float fx = pl->a >= 0.0f ? lv->maxX[i] : lv->minX[i];
+      float fy = pl->b >= 0.0f ? lv->maxY[i] : lv->minY[i];
+      float fz = pl->c >= 0.0f ? lv->maxZ[i] : lv->minZ[i];
+      float nx = pl->a >= 0.0f ? lv->minX[i] : lv->maxX[i];
+      float ny = pl->b >= 0.0f ? lv->minY[i] : lv->maxY[i];
+      float nz = pl->c >= 0.0f ? lv->minZ[i] : lv->maxZ[i];
+      if (pl->a * fx + pl->b * fy + pl->c * fz + pl->d < 0.0f){
+        visible &= ~(1 << l);
+        break;
+      }
+      if (pl->a * nx + pl->b * ny + pl->c * nz + pl->d < 0.0f){
+        crossing[l] |= 1 << p;
+      }
+    }
+  }
+#endif
+  return visible;
+}
+
+// visit every non-empty column of the subtree that lies in the rectangle
+static void visitSubtree(culltree t, int lv, int i, int minX, int minZ, int maxX, int maxZ,
+                         cullvisitfunc visit, void *arg){
+  int span = 1 << (t->depth - lv);
+  int x0 = (int)compactBits(i) * span;
+  int z0 = (int)compactBits(i >> 1) * span;
+  int x1 = x0 + span - 1, z1 = z0 + span - 1;
+  if (x0 < minX) x0 = minX;
+  if (z0 < minZ) z0 = minZ;
+  if (x1 > maxX) x1 = maxX;
+  if (z1 > maxZ) z1 = maxZ;
+  const level *leaf = &t->levels[t->depth];
+  for (int x = x0; x <= x1; x++){
+    for (int z = z0; z <= z1; z++){
+      if (!nodeEmpty(leaf, morton(x, z))) visit(x, z, arg);
+    }
+  }
+}
+
+int cullTreeQuery(culltree t, const frustum *f,
+                  int minX, int minZ, int maxX, int maxZ,
+                  cullvisitfunc visit, void *arg){
+  if (minX < 0) minX = 0;
+  if (minZ < 0) minZ = 0;
+  if (maxX > t->width - 1)  maxX = t->width - 1;
+  if (maxZ > t->height - 1) maxZ = t->height - 1;
+  if (minX > maxX || minZ > maxZ) return 0;
+
+  pending stack[STACK_SIZE];
+  int top = 0;
+  int tests = 0;
+  // the root sits alone in the first group of level 0
+  stack[top++] = (pending){ 0, 0, ALL_PLANES };
+  while (top > 0){
+    pending g = stack[--top];
+    const level *lv = &t->levels[g.level];
+    int span = 1 << (t->depth - g.level);
+    int crossing[4];
+    int visible = testSiblings(lv, g.first, f, g.planes, crossing);
+    tests += 4;
+    for (int l = 0; l < 4; l++){
+      if (!(visible & (1 << l))) continue;
+      int i  = g.first + l;
+      int x0 = (int)compactBits(i) * span;
+      int z0 = (int)compactBits(i >> 1) * span;
+      if (x0 > maxX || z0 > maxZ || x0 + span - 1 < minX || z0 + span - 1 < minZ) continue;
+      if (g.level == t->depth || crossing[l] == 0){
+        // a leaf, or entirely inside: no need to look any closer
+        visitSubtree(t, g.level, i, minX, minZ, maxX, maxZ, visit, arg);
+      } else {
+        assert(top < STACK_SIZE);
+        stack[top++] = (pending){ g.level + 1, 4 * i, crossing[l] };
+      }
+    }
+  }
+  return tests;
+}
@@ -0,0 +1,33 @@
+#ifndef CULLTREE_H
+#define CULLTREE_H
+
+#include "../utils/math.h"
+
+/*
+ * Quadtree of bounding boxes over the chunk columns of a world, used to
+ * reject whole groups of chunks against the view frustum at once. Each
+ * level is stored as separate arrays of min/max coordinates with the
+ * four children of a node next to each other, so one node's children
+ * are tested against a plane in a single SIMD step. A subtree entirely
+ * inside the frustum is accepted without testing its leaves.
+ */
+struct culltree;
+typedef struct culltree *culltree;
+
+typedef void (*cullvisitfunc)(int x, int z, void *arg);
+
+// covers chunk columns [0, width) x [0, height)
+extern culltree createCullTree(int width, int height);
+extern void freeCullTree(culltree t);
+// block y range [minY, maxY) holding anything in column (x, z); an
+// empty range means there is nothing there to draw
+extern void cullTreeSetColumn(culltree t, int x, int z, float minY, float maxY);
+// the contents of the column are unknown (not loaded), keep it a full chunk tall
+extern void cullTreeResetColumn(culltree t, int x, int z);
+// calls visit for every column in [minX, maxX] x [minZ, maxZ] that may
+// be inside f, returns the number of boxes tested
+extern int cullTreeQuery(culltree t, const frustum *f,
+                         int minX, int minZ, int maxX, int maxZ,
+                         cullvisitfunc visit, void *arg);
+
+#endif
@@ -0,0 +1,386 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+
+#include "entities.h"
+#include "chunk.h"
+#include "physics.h"
+#include "../utils/pool.h"
+
+#define GRAVITY 9.81f   // blocks a second, each second
+
+typedef enum {
+  PHASE_SWEEP,      // gravity, then through the blocks
+  PHASE_CONTACTS,   // how far each body should move out of the others
+  PHASE_SEPARATE    // moving them that far, again through the blocks
+} PHASE;
+
+struct entities {
+  int count, capacity;
+  float *x, *y, *z;         // middle of the bottom face
+  float *vx, *vy, *vz;
+  float *sx, *sy, *sz;      // full size of the box
+  bool *grounded;
+  float *px, *py, *pz;      // out of the other bodies, this step
+  float *dvx, *dvy, *dvz;
+  float largest;            // edge of the biggest body ever added
+  // the grid: bodies sorted by the bucket their cell hashes to, with
+  // copies of what the overlap tests read in that order, so bodies near
+  // each other are near each other in memory
+  int *bucketOf;
+  int *sorted;
+  float *cx, *cy, *cz;      // middle of the box
+  float *hx, *hy, *hz;      // half its size
+  float *gvx, *gvy, *gvz;
+  int *bucketStart;         // buckets + 1 offsets into sorted
+  int maxBuckets, buckets;  // powers of two
+  float cell;
+  // counted per slice so workers share nothing they write
+  unsigned long *candidates, *contacts;
+  int *groundedCount;
+  pool workers;
+  int slices;               // one a thread, the caller takes slice 0
+  // the phase being run, only written between runs
+  PHASE phase;
+  world w;
+  float dt;
+  entityStats stats;
+};
+
+static double nowSeconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int nextPowerOfTwo(int n){
+  int p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+static float *floats(int n){
+  float *new = malloc(n * sizeof(float));
+  assert(new != NULL);
+  return new;
+}
+
+static int cellCoord(float v, float cell){
+  return (int)floorf(v / cell);
+}
+
+static int bucket(entities e, int cx, int cy, int cz){
+  unsigned h = (unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u ^ (unsigned)cz * 83492791u;
+  return (int)(h & (unsigned)(e->buckets - 1));
+}
+
+static void boxOf(entities e, int i, vec3 *min, vec3 *max){
+  *min = vec3Make(e->x[i] - e->sx[i] / 2.0f, e->y[i], e->z[i] - e->sz[i] / 2.0f);
+  *max = vec3Make(e->x[i] + e->sx[i] / 2.0f, e->y[i] + e->sy[i], e->z[i] + e->sz[i] / 2.0f);
+}
+
+static void sweepBodies(entities e, int index, int from, int to){
+  float dt = e->dt;
+  int grounded = 0;
+  for (int i = from; i < to; i++){
+    e->vy[i] -= GRAVITY * dt;
+    vec3 min, max;
+    boxOf(e, i, &min, &max);
+    sweepResult s = sweepBoxShared(e->w, min, max, vec3Make(e->vx[i] * dt, e->vy[i] * dt, e->vz[i] * dt));
+    e->x[i] += s.moved.x;
+    e->y[i] += s.moved.y;
+    e->z[i] += s.moved.z;
+    e->grounded[i] = s.hit[1] && e->vy[i] < 0.0f;
+    if (s.hit[0]) e->vx[i] = 0.0f;
+    if (s.hit[1]) e->vy[i] = 0.0f;
+    if (s.hit[2]) e->vz[i] = 0.0f;
+    grounded += e->grounded[i];
+  }
+  e->groundedCount[index] = grounded;
+}
+
+// Each body works out only its own half of every overlap, from copies
+// nobody writes in this phase, so slices need no locking and the result
+// does not depend on how bodies are split between threads. Slices are
+// taken in grid order, so bodies in a row look at the same buckets.
+static void findContacts(entities e, int index, int from, int to){
+  unsigned long candidates = 0, contacts = 0;
+  for (int k = from; k < to; k++){
+    int i = e->sorted[k];
+    float push[3] = { 0.0f, 0.0f, 0.0f };
+    float dv[3] = { 0.0f, 0.0f, 0.0f };
+    float mine[3] = { e->cx[k], e->cy[k], e->cz[k] };
+    float half[3] = { e->hx[k], e->hy[k], e->hz[k] };
+    float v[3] = { e->gvx[k], e->gvy[k], e->gvz[k] };
+    // Cells are twice the largest body, so anything touching this one has
+    // its middle less than half a cell away: in this cell or the one on
+    // the nearer side, on each axis. Eight cells instead of 27.
+    int cell[3], side[3];
+    for (int a = 0; a < 3; a++){
+      float at = mine[a] / e->cell;
+      cell[a] = (int)floorf(at);
+      side[a] = at - cell[a] < 0.5f ? -1 : 1;
+    }
+    int seen[8], seenCount = 0;
+    for (int n = 0; n < 8; n++){
+      int b = bucket(e, cell[0] + (n & 1 ? side[0] : 0), cell[1] + (n & 2 ? side[1] : 0),
+                     cell[2] + (n & 4 ? side[2] : 0));
+      // neighbouring cells can share a bucket, visit each bucket once
+      bool visited = false;
+      for (int m = 0; m < seenCount && !visited; m++) visited = seen[m] == b;
+      if (visited) continue;
+      seen[seenCount++] = b;
+
+      for (int o = e->bucketStart[b]; o < e->bucketStart[b + 1]; o++){
+        if (o == k) continue;
+        candidates++;
+        float theirs[3] = { e->cx[o], e->cy[o], e->cz[o] };
+        float other[3] = { e->hx[o], e->hy[o], e->hz[o] };
+        float depth[3];
+        bool overlap = true;
+        for (int a = 0; a < 3 && overlap; a++){
+          depth[a] = half[a] + other[a] - fabsf(mine[a] - theirs[a]);
+          overlap = depth[a] > 0.0f;
+        }
+        if (!overlap) continue;
+        contacts++;
+
+        // out along the shallowest axis, half the way each
+        float w[3] = { e->gvx[o], e->gvy[o], e->gvz[o] };
+        int a = depth[0] < depth[1] ? (depth[0] < depth[2] ? 0 : 2) : (depth[1] < depth[2] ? 1 : 2);
+        float away = mine[a] > theirs[a] ? 1.0f : mine[a] < theirs[a] ? -1.0f
+                   : (i < e->sorted[o] ? -1.0f : 1.0f);
+        push[a] += away * depth[a] / 2.0f;
+        // and stop closing in, meeting the other halfway
+        float closing = (v[a] - w[a]) * away;
+        if (closing < 0.0f) dv[a] -= closing * away / 2.0f;
+      }
+    }
+    // never more than half the body in one step, so it cannot be shoved
+    // past what the step touched of the world
+    for (int a = 0; a < 3; a++){
+      if (push[a] >  half[a]) push[a] =  half[a];
+      if (push[a] < -half[a]) push[a] = -half[a];
+    }
+    e->px[i] = push[0];  e->py[i] = push[1];  e->pz[i] = push[2];
+    e->dvx[i] = dv[0];   e->dvy[i] = dv[1];   e->dvz[i] = dv[2];
+  }
+  e->candidates[index] = candidates;
+  e->contacts[index] = contacts;
+}
+
+static void separateBodies(entities e, int index, int from, int to){
+  int grounded = 0;
+  for (int i = from; i < to; i++){
+    e->vx[i] += e->dvx[i];
+    e->vy[i] += e->dvy[i];
+    e->vz[i] += e->dvz[i];
+    if (e->px[i] != 0.0f || e->py[i] != 0.0f || e->pz[i] != 0.0f){
+      vec3 min, max;
+      boxOf(e, i, &min, &max);
+      sweepResult s = sweepBoxShared(e->w, min, max, vec3Make(e->px[i], e->py[i], e->pz[i]));
+      e->x[i] += s.moved.x;
+      e->y[i] += s.moved.y;
+      e->z[i] += s.moved.z;
+      // pushed up out of another body is standing on it
+      if (e->py[i] > 0.0f && e->vy[i] <= 0.0f) e->grounded[i] = true;
+    }
+    grounded += e->grounded[i];
+  }
+  e->groundedCount[index] = grounded;
+}
+
+static void runSlice(void *arg, int index, int count){
+  entities e = arg;
+  int from = (int)((long)e->count * index / count);
+  int to   = (int)((long)e->count * (index + 1) / count);
+  switch (e->phase){
+    case PHASE_SWEEP:    sweepBodies(e, index, from, to); break;
+    case PHASE_CONTACTS: findContacts(e, index, from, to); break;
+    case PHASE_SEPARATE: separateBodies(e, index, from, to); break;
+  }
+}
+
+static void runPhase(entities e, PHASE phase){
+  e->phase = phase;
+  poolRun(e->workers, &runSlice, e);
+}
+
+entities createEntities(int capacity, int workers){
+  entities new = malloc(sizeof(struct entities));
+  assert(new != NULL);
+  new->count    = 0;
+  new->capacity = capacity;
+  new->x  = floats(capacity);  new->y  = floats(capacity);  new->z  = floats(capacity);
+  new->vx = floats(capacity);  new->vy = floats(capacity);  new->vz = floats(capacity);
+  new->sx = floats(capacity);  new->sy = floats(capacity);  new->sz = floats(capacity);
+  new->px = floats(capacity);  new->py = floats(capacity);  new->pz = floats(capacity);
+  new->dvx = floats(capacity); new->dvy = floats(capacity); new->dvz = floats(capacity);
+  new->grounded = malloc(capacity * sizeof(bool));
+  new->largest  = 0.0f;
+  new->maxBuckets  = nextPowerOfTwo(2 * capacity);
+  new->buckets     = 1;
+  new->cell        = 1.0f;
+  new->bucketOf    = malloc(capacity * sizeof(int));
+  new->sorted      = malloc(capacity * sizeof(int));
+  new->bucketStart = malloc((new->maxBuckets + 1) * sizeof(int));
+  new->cx  = floats(capacity); new->cy  = floats(capacity); new->cz  = floats(capacity);
+  new->hx  = floats(capacity); new->hy  = floats(capacity); new->hz  = floats(capacity);
+  new->gvx = floats(capacity); new->gvy = floats(capacity); new->gvz = floats(capacity);
+  assert(new->grounded != NULL && new->bucketOf != NULL && new->sorted != NULL && new->bucketStart != NULL);
+  new->w       = NULL;
+  new->dt      = 0.0f;
+  new->stats   = (entityStats){ 0, 0, 1, 0, 0, 0.0, 0.0, 0.0, 0.0 };
+
+  new->workers = createPool("entity", workers);
+  new->slices  = poolThreads(new->workers);
+  new->candidates    = calloc(new->slices, sizeof(unsigned long));
+  new->contacts      = calloc(new->slices, sizeof(unsigned long));
+  new->groundedCount = calloc(new->slices, sizeof(int));
+  assert(new->candidates != NULL && new->contacts != NULL && new->groundedCount != NULL);
+  return new;
+}
+
+void freeEntities(entities e){
+  freePool(e->workers);
+  float *fields[] = { e->x, e->y, e->z, e->vx, e->vy, e->vz, e->sx, e->sy, e->sz,
+                      e->px, e->py, e->pz, e->dvx, e->dvy, e->dvz,
+                      e->cx, e->cy, e->cz, e->hx, e->hy, e->hz, e->gvx, e->gvy, e->gvz };
+  for (int i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i++) free(fields[i]);
+  free(e->grounded);
+  free(e->bucketOf);
+  free(e->sorted);
+  free(e->bucketStart);
+  free(e->candidates);
+  free(e->contacts);
+  free(e->groundedCount);
+  free(e);
+}
+
+int addEntity(entities e, vec3 position, vec3 size, vec3 velocity){
+  if (e->count == e->capacity) return -1;
+  int i = e->count++;
+  e->x[i]  = position.x;  e->y[i]  = position.y;  e->z[i]  = position.z;
+  e->sx[i] = size.x;      e->sy[i] = size.y;      e->sz[i] = size.z;
+  e->vx[i] = velocity.x;  e->vy[i] = velocity.y;  e->vz[i] = velocity.z;
+  e->grounded[i] = false;
+  float edge = fmaxf(size.x, fmaxf(size.y, size.z));
+  if (edge > e->largest) e->largest = edge;
+  return i;
+}
+
+void removeEntity(entities e, int index){
+  int last = --e->count;
+  e->x[index]  = e->x[last];   e->y[index]  = e->y[last];   e->z[index]  = e->z[last];
+  e->vx[index] = e->vx[last];  e->vy[index] = e->vy[last];  e->vz[index] = e->vz[last];
+  e->sx[index] = e->sx[last];  e->sy[index] = e->sy[last];  e->sz[index] = e->sz[last];
+  e->grounded[index] = e->grounded[last];
+}
+
+int entityCount(entities e){
+  return e->count;
+}
+
+vec3 getEntityPosition(entities e, int index){
+  return vec3Make(e->x[index], e->y[index], e->z[index]);
+}
+
+vec3 getEntityVelocity(entities e, int index){
+  return vec3Make(e->vx[index], e->vy[index], e->vz[index]);
+}
+
+void setEntityVelocity(entities e, int index, vec3 velocity){
+  e->vx[index] = velocity.x;
+  e->vy[index] = velocity.y;
+  e->vz[index] = velocity.z;
+}
+
+bool entityGrounded(entities e, int index){
+  return e->grounded[index];
+}
+
+// Workers only peek at blocks, so touch every chunk a body could reach
+// this step first: its box, where gravity and velocity take it, and up to
+// half its size further for being pushed out of other bodies.
+static void touchReachableChunks(entities e, world w, float dt){
+  int lastX = 0, lastZ = 0;
+  bool any = false;
+  for (int i = 0; i < e->count; i++){
+    float reachX = fabsf(e->vx[i] * dt) + e->sx[i];
+    float reachZ = fabsf(e->vz[i] * dt) + e->sz[i];
+    int x0 = (int)floorf((e->x[i] - reachX) / CHUNK_SIZE_X);
+    int x1 = (int)floorf((e->x[i] + reachX) / CHUNK_SIZE_X);
+    int z0 = (int)floorf((e->z[i] - reachZ) / CHUNK_SIZE_Z);
+    int z1 = (int)floorf((e->z[i] + reachZ) / CHUNK_SIZE_Z);
+    for (int cx = x0; cx <= x1; cx++){
+      for (int cz = z0; cz <= z1; cz++){
+        // neighbours in the arrays tend to be neighbours in the world
+        if (any && cx == lastX && cz == lastZ) continue;
+        chunk c = getChunk(w, cx, cz);
+        if (c != NULL) getChunkBlocks(c);
+        lastX = cx;
+        lastZ = cz;
+        any = true;
+      }
+    }
+  }
+}
+
+static void buildGrid(entities e){
+  e->cell = e->largest > 0.0f ? 2.0f * e->largest : 1.0f;
+  e->buckets = nextPowerOfTwo(2 * e->count);
+  if (e->buckets > e->maxBuckets) e->buckets = e->maxBuckets;
+  for (int b = 0; b <= e->buckets; b++) e->bucketStart[b] = 0;
+  for (int i = 0; i < e->count; i++){
+    int b = bucket(e, cellCoord(e->x[i], e->cell), cellCoord(e->y[i] + e->sy[i] / 2.0f, e->cell),
+                   cellCoord(e->z[i], e->cell));
+    e->bucketOf[i] = b;
+    e->bucketStart[b]++;
+  }
+  // to the end of each bucket, then fill backwards to its start, so
+  // bodies keep their order within a bucket
+  for (int b = 1; b <= e->buckets; b++) e->bucketStart[b] += e->bucketStart[b - 1];
+  for (int i = e->count - 1; i >= 0; i--) e->sorted[--e->bucketStart[e->bucketOf[i]]] = i;
+  e->bucketStart[e->buckets] = e->count;
+  for (int k = 0; k < e->count; k++){
+    int i = e->sorted[k];
+    e->hx[k] = e->sx[i] / 2.0f;
+    e->hy[k] = e->sy[i] / 2.0f;
+    e->hz[k] = e->sz[i] / 2.0f;
+    e->cx[k] = e->x[i];
+    e->cy[k] = e->y[i] + e->hy[k];
+    e->cz[k] = e->z[i];
+    e->gvx[k] = e->vx[i];
+    e->gvy[k] = e->vy[i];
+    e->gvz[k] = e->vz[i];
+  }
+}
+
+void stepEntities(entities e, world w, float dt){
+  double start = nowSeconds();
+  e->w  = w;
+  e->dt = dt;
+  touchReachableChunks(e, w, dt);
+  runPhase(e, PHASE_SWEEP);
+  double swept = nowSeconds();
+  buildGrid(e);
+  double gridded = nowSeconds();
+  runPhase(e, PHASE_CONTACTS);
+  runPhase(e, PHASE_SEPARATE);
+  double end = nowSeconds();
+
+  entityStats stats = { e->count, 0, e->slices, 0, 0, swept - start, gridded - swept,
+                        end - gridded, end - start };
+  for (int i = 0; i < e->slices; i++){
+    stats.grounded   += e->groundedCount[i];
+    stats.candidates += e->candidates[i];
+    stats.contacts   += e->contacts[i];
+  }
+  e->stats = stats;
+}
+
+entityStats getEntityStats(entities e){
+  return e->stats;
+}
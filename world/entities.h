@@ -0,0 +1,50 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <stdbool.h>
+
+#include "../utils/math.h"
+#include "world.h"
+
+/*
+ * Many small bodies falling, sliding and bumping into each other. Bodies
+ * are kept as arrays of each field, so a step streams through memory, and
+ * are boxes standing on their position like the player does.
+ *
+ * A step sweeps every body through the blocks, then bins bodies into a
+ * uniform grid hashed into a table, so each only meets the bodies in the
+ * cells around it, and pushes overlapping ones apart. Both run on the
+ * calling thread and the workers, each on its own slice of the bodies.
+ */
+struct entities;
+typedef struct entities *entities;
+
+typedef struct {
+  int bodies;
+  int grounded;
+  int threads;              // workers + the caller
+  unsigned long candidates; // pairs the grid put together
+  unsigned long contacts;   // of those, overlapping
+  double worldSeconds;      // sweeping through the blocks
+  double gridSeconds;       // binning bodies into the grid
+  double contactSeconds;    // finding and resolving overlaps
+  double stepSeconds;       // the whole step
+} entityStats;
+
+extern entities createEntities(int capacity, int workers);
+extern void freeEntities(entities e);
+// index of the new body, or -1 when there is no room for it
+extern int addEntity(entities e, vec3 position, vec3 size, vec3 velocity);
+// the last body takes over the index
+extern void removeEntity(entities e, int index);
+extern int entityCount(entities e);
+extern vec3 getEntityPosition(entities e, int index);
+extern vec3 getEntityVelocity(entities e, int index);
+extern void setEntityVelocity(entities e, int index, vec3 velocity);
+extern bool entityGrounded(entities e, int index);
+// chunks in reach of a body must not be changed during the step
+extern void stepEntities(entities e, world w, float dt);
+// of the last step
+extern entityStats getEntityStats(entities e);
+
+#endif
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "occlusion.h"
+#include "../utils/pool.h"
+
+#define BUFFER_WIDTH  128   // must be a multiple of 4
+#define BUFFER_HEIGHT 64
+#define NEAR_W        0.1f  // corners closer than this are not projected
+#define CHECK_EVERY   8     // occluders between looks at the clock
+
+struct occlusion {
+  float *depth;         // 1 / distance to the nearest occluder, 0 where none
+  pool workers;         // may be shared with other occlusions
+  int bands;            // one a thread, the caller rasterises band 0
+  int *finished;        // occluders each band got through last frame
+  double budget;
+  // the frame being rasterised, only written between runs
+  mat4 viewProj;
+  vec3 eye;
+  const occluder *occluders;
+  int count;
+  double began;         // when band 0 started
+  occlusionStats stats;
+};
+
+// a corner in buffer pixels, w is its distance in front of the eye
+typedef struct {
+  float x, y, w;
+} projected;
+
+static double nowSeconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static projected project(const mat4 *m, float x, float y, float z){
+  projected p;
+  float cx = m->m[0][0] * x + m->m[0][1] * y + m->m[0][2] * z + m->m[0][3];
+  float cy = m->m[1][0] * x + m->m[1][1] * y + m->m[1][2] * z + m->m[1][3];
+  p.w = m->m[3][0] * x + m->m[3][1] * y + m->m[3][2] * z + m->m[3][3];
+  if (p.w < NEAR_W) return p;
+  p.x = (cx / p.w * 0.5f + 0.5f) * BUFFER_WIDTH;
+  p.y = (cy / p.w * 0.5f + 0.5f) * BUFFER_HEIGHT;
+  return p;
+}
+
+// bit 0 picks max.x, bit 1 max.y, bit 2 max.z
+static void projectBox(const mat4 *m, vec3 min, vec3 max, projected corners[8]){
+  for (int k = 0; k < 8; k++){
+    corners[k] = project(m, k & 1 ? max.x : min.x, k & 2 ? max.y : min.y, k & 4 ? max.z : min.z);
+  }
+}
+
+// Fills the pixels of rows [y0, y1) lying entirely inside the convex quad
+// q. 1 / w is linear across the screen, so each pixel gets it at the
+// pixel's furthest corner, never less than at the quad's furthest corner,
+// and keeps whichever of that and what is already there is nearer.
+static void rasteriseQuad(float *buffer, const projected *q[4], int y0, int y1){
+  float area = 0.0f;
+  float minX = q[0]->x, maxX = q[0]->x, minY = q[0]->y, maxY = q[0]->y;
+  float furthest = 1.0f / q[0]->w;
+  for (int i = 0; i < 4; i++){
+    const projected *a = q[i], *b = q[(i + 1) & 3];
+    area += a->x * b->y - b->x * a->y;
+    if (a->x < minX) minX = a->x;
+    if (a->x > maxX) maxX = a->x;
+    if (a->y < minY) minY = a->y;
+    if (a->y > maxY) maxY = a->y;
+    if (1.0f / a->w < furthest) furthest = 1.0f / a->w;
+  }
+  if (fabsf(area) < 1e-6f) return;
+
+  int px0 = (int)ceilf(minX), px1 = (int)floorf(maxX) - 1;
+  int py0 = (int)ceilf(minY), py1 = (int)floorf(maxY) - 1;
+  if (px0 < 0) px0 = 0;
+  if (px1 > BUFFER_WIDTH - 1) px1 = BUFFER_WIDTH - 1;
+  if (py0 < y0) py0 = y0;
+  if (py1 > y1 - 1) py1 = y1 - 1;
+  if (px0 > px1 || py0 > py1) return;
+
+  // e(x, y) = A x + B y + C is positive inside each edge. Moving C in by
+  // half a pixel along the gradient makes e at a pixel centre positive
+  // only when the whole pixel is inside.
+  float sign = area > 0.0f ? 1.0f : -1.0f;
+  float A[4], B[4], C[4];
+  for (int i = 0; i < 4; i++){
+    const projected *a = q[i], *b = q[(i + 1) & 3];
+    float dx = b->x - a->x, dy = b->y - a->y;
+    A[i] = -dy * sign;
+    B[i] =  dx * sign;
+    C[i] = (dy * a->x - dx * a->y) * sign - 0.5f * (fabsf(A[i]) + fabsf(B[i]));
+  }
+
+  // the plane of 1 / w through the corners of the larger half of the quad
+  int base = 0;
+  float half = (q[1]->x - q[0]->x) * (q[2]->y - q[0]->y) - (q[2]->x - q[0]->x) * (q[1]->y - q[0]->y);
+  float other = (q[2]->x - q[0]->x) * (q[3]->y - q[0]->y) - (q[3]->x - q[0]->x) * (q[2]->y - q[0]->y);
+  if (fabsf(other) > fabsf(half)){
+    base = 1;
+    half = other;
+  }
+  const projected *p0 = q[0], *p1 = q[1 + base], *p2 = q[2 + base];
+  float z0 = 1.0f / p0->w, z1 = 1.0f / p1->w - z0, z2 = 1.0f / p2->w - z0;
+  float zx = (z1 * (p2->y - p0->y) - z2 * (p1->y - p0->y)) / half;
+  float zy = (z2 * (p1->x - p0->x) - z1 * (p2->x - p0->x)) / half;
+  float zc = z0 - zx * p0->x - zy * p0->y - 0.5f * (fabsf(zx) + fabsf(zy));
+
+#if defined(__SSE__)
+  // whole aligned groups of four, the edge tests reject the extra pixels
+  px0 &= ~3;
+  __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  __m128 floorZ = _mm_set1_ps(furthest);
+  __m128 stepZ = _mm_set1_ps(zx);
+  __m128 zero = _mm_setzero_ps();
+  __m128 a[4], rowE[4];
+  for (int i = 0; i < 4; i++) a[i] = _mm_set1_ps(A[i]);
+  for (int y = py0; y <= py1; y++){
+    float *row = buffer + y * BUFFER_WIDTH;
+    for (int i = 0; i < 4; i++) rowE[i] = _mm_set1_ps(B[i] * (y + 0.5f) + C[i]);
+    __m128 rowZ = _mm_set1_ps(zy * (y + 0.5f) + zc);
+    for (int x = px0; x <= px1; x += 4){
+      __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+      __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], xs), rowE[0]), zero);
+      for (int i = 1; i < 4; i++){
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[i], xs), rowE[i]), zero));
+      }
+      __m128 z = _mm_max_ps(_mm_add_ps(_mm_mul_ps(stepZ, xs), rowZ), floorZ);
+      __m128 old = _mm_load_ps(row + x);
+      __m128 nearer = _mm_max_ps(old, z);
+      _mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+    }
+  }
+#else
+  for (int y = py0; y <= py1; y++){
+    float *row = buffer + y * BUFFER_WIDTH;
+    for (int x = px0; x <= px1; x++){
+      bool inside = true;
+      for (int i = 0; i < 4 && inside; i++){
+        inside = A[i] * (x + 0.5f) + B[i] * (y + 0.5f) + C[i] >= 0.0f;
+      }
+      if (!inside) continue;
+      float z = zx * (x + 0.5f) + zy * (y + 0.5f) + zc;
+      if (z < furthest) z = furthest;
+      if (z > row[x]) row[x] = z;
+    }
+  }
+#endif
+}
+
+// corner indices of each face, in order around it
+static const int faces[6][4] = {
+  { 0, 2, 6, 4 },  // -x
+  { 1, 3, 7, 5 },  // +x
+  { 0, 1, 5, 4 },  // -y
+  { 2, 3, 7, 6 },  // +y
+  { 0, 1, 3, 2 },  // -z
+  { 4, 5, 7, 6 },  // +z
+};
+
+static void rasteriseOccluder(occlusion o, const occluder *occ, int y0, int y1){
+  projected corners[8];
+  projectBox(&o->viewProj, occ->min, occ->max, corners);
+  // only the faces turned towards the eye can be seen
+  bool facing[6] = {
+    o->eye.x < occ->min.x, o->eye.x > occ->max.x,
+    o->eye.y < occ->min.y, o->eye.y > occ->max.y,
+    o->eye.z < occ->min.z, o->eye.z > occ->max.z,
+  };
+  for (int f = 0; f < 6; f++){
+    if (!facing[f]) continue;
+    const projected *q[4];
+    bool clipped = false;
+    for (int i = 0; i < 4; i++){
+      q[i] = &corners[faces[f][i]];
+      if (q[i]->w < NEAR_W) clipped = true;
+    }
+    // a face through the near plane would need clipping, just leave it out
+    if (clipped) continue;
+    rasteriseQuad(o->depth, q, y0, y1);
+  }
+}
+
+static void rasteriseBand(void *arg, int index, int count){
+  occlusion o = arg;
+  (void)count;
+  // more threads than rows leaves some without a band
+  if (index >= o->bands) return;
+  // timed from when the band starts, not from when the run was asked for,
+  // so waiting for the pool to be free costs no budget
+  double deadline = nowSeconds() + o->budget;
+  if (index == 0) o->began = deadline - o->budget;
+  int y0 = index * BUFFER_HEIGHT / o->bands;
+  int y1 = (index + 1) * BUFFER_HEIGHT / o->bands;
+  for (int i = y0 * BUFFER_WIDTH; i < y1 * BUFFER_WIDTH; i++) o->depth[i] = 0.0f;
+
+  int i;
+  for (i = 0; i < o->count; i++){
+    if (i % CHECK_EVERY == 0 && nowSeconds() > deadline) break;
+    rasteriseOccluder(o, &o->occluders[i], y0, y1);
+  }
+  o->finished[index] = i;
+}
+
+occlusion createOcclusion(pool workers, double budgetSeconds){
+  occlusion new = malloc(sizeof(struct occlusion));
+  assert(new != NULL);
+  new->depth = aligned_alloc(16, BUFFER_WIDTH * BUFFER_HEIGHT * sizeof(float));
+  assert(new->depth != NULL);
+  for (int i = 0; i < BUFFER_WIDTH * BUFFER_HEIGHT; i++) new->depth[i] = 0.0f;
+  new->budget    = budgetSeconds;
+  new->occluders = NULL;
+  new->count     = 0;
+  new->began     = 0.0;
+  new->stats     = (occlusionStats){ 0, 0, 0, 0, 0.0 };
+  new->workers   = workers;
+  new->bands     = poolThreads(workers) < BUFFER_HEIGHT ? poolThreads(workers) : BUFFER_HEIGHT;
+  new->finished = calloc(new->bands, sizeof(int));
+  assert(new->finished != NULL);
+  return new;
+}
+
+void freeOcclusion(occlusion o){
+  free(o->finished);
+  free(o->depth);
+  free(o);
+}
+
+void occlusionRasterise(occlusion o, const mat4 *viewProj, vec3 eye,
+                        const occluder *occluders, int count){
+  o->viewProj  = *viewProj;
+  o->eye       = eye;
+  o->occluders = occluders;
+  o->count     = count;
+
+  poolRun(o->workers, &rasteriseBand, o);
+
+  int rasterised = count;
+  for (int i = 0; i < o->bands; i++){
+    if (o->finished[i] < rasterised) rasterised = o->finished[i];
+  }
+  o->stats = (occlusionStats){ count, rasterised, 0, 0, nowSeconds() - o->began };
+}
+
+bool occlusionTestBox(occlusion o, vec3 min, vec3 max){
+  o->stats.tested++;
+  projected corners[8];
+  projectBox(&o->viewProj, min, max, corners);
+  float nearest = 0.0f;  // 1 / w of the nearest corner
+  float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+  for (int k = 0; k < 8; k++){
+    // the eye is in or right next to the box
+    if (corners[k].w < NEAR_W) return true;
+    if (1.0f / corners[k].w > nearest) nearest = 1.0f / corners[k].w;
+    if (corners[k].x < minX) minX = corners[k].x;
+    if (corners[k].x > maxX) maxX = corners[k].x;
+    if (corners[k].y < minY) minY = corners[k].y;
+    if (corners[k].y > maxY) maxY = corners[k].y;
+  }
+
+  // every pixel the box touches
+  int px0 = (int)floorf(minX), px1 = (int)ceilf(maxX) - 1;
+  int py0 = (int)floorf(minY), py1 = (int)ceilf(maxY) - 1;
+  if (px0 < 0) px0 = 0;
+  if (px1 > BUFFER_WIDTH - 1) px1 = BUFFER_WIDTH - 1;
+  if (py0 < 0) py0 = 0;
+  if (py1 > BUFFER_HEIGHT - 1) py1 = BUFFER_HEIGHT - 1;
+  if (px0 > px1 || py0 > py1) return true;  // off screen, leave it to the frustum
+
+  // visible as soon as one pixel has nothing in front of the box
+#if defined(__SSE__)
+  __m128 boxDepth = _mm_set1_ps(nearest);
+  __m128 first = _mm_set1_ps((float)px0), last = _mm_set1_ps((float)px1);
+  __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  for (int y = py0; y <= py1; y++){
+    const float *row = o->depth + y * BUFFER_WIDTH;
+    for (int x = px0 & ~3; x <= px1; x += 4){
+      __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+      __m128 inRange = _mm_and_ps(_mm_cmpge_ps(xs, first), _mm_cmple_ps(xs, last));
+      __m128 open = _mm_cmple_ps(_mm_load_ps(row + x), boxDepth);
+      if (_mm_movemask_ps(_mm_and_ps(inRange, open)) != 0) return true;
+    }
+  }
+#else
+  for (int y = py0; y <= py1; y++){
+    const float *row = o->depth + y * BUFFER_WIDTH;
+    for (int x = px0; x <= px1; x++){
+      if (row[x] <= nearest) return true;
+    }
+  }
+#endif
+  o->stats.occluded++;
+  return false;
+}
+
+occlusionStats getOcclusionStats(occlusion o){
+  return o->stats;
+}
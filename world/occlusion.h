@@ -0,0 +1,49 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdbool.h>
+
+#include "../utils/math.h"
+#include "../utils/pool.h"
+
+/*
+ * Software occlusion culling. Boxes known to be opaque are rasterised
+ * into a small depth buffer on the CPU, and bounding boxes are then
+ * tested against it. Coverage is conservative: an occluder only writes
+ * pixels it covers entirely, at the furthest depth it has inside the
+ * pixel, so a box is never reported hidden when any part of it could be
+ * seen.
+ *
+ * The buffer is split into bands of rows, one for each thread of the
+ * pool it is given, the calling thread included. Occlusions can share a
+ * pool, one rasterising while the others wait their turn. Rasterising
+ * stops when the budget runs out, which only leaves the buffer emptier:
+ * later occluders are simply not used.
+ */
+struct occlusion;
+typedef struct occlusion *occlusion;
+
+typedef struct {
+  vec3 min, max;
+} occluder;
+
+typedef struct {
+  int occluders;        // offered in the last frame
+  int rasterised;       // of those, drawn by every band within the budget
+  int tested;
+  int occluded;
+  double rasterSeconds; // wall time spent rasterising
+} occlusionStats;
+
+// workers must outlive the occlusion. The budget is timed from when the
+// run starts on the pool, so waiting for it to be free costs none
+extern occlusion createOcclusion(pool workers, double budgetSeconds);
+extern void freeOcclusion(occlusion o);
+// occluders should be sorted near to far, so the budget cuts off the least useful
+extern void occlusionRasterise(occlusion o, const mat4 *viewProj, vec3 eye,
+                               const occluder *occluders, int count);
+// false when the box is certainly hidden behind the occluders
+extern bool occlusionTestBox(occlusion o, vec3 min, vec3 max);
+extern occlusionStats getOcclusionStats(occlusion o);
+
+#endif
@@ -7,103 +7,178 @@
 #include "../utils/math.h"
 #include "chunk.h"
 #include "world.h"
-#include "../adts/hash.h"
+#include "physics.h"
 
-#define PLAYER_WIDTH 1.0f 
+#define PLAYER_WIDTH 1.0f
 #define PLAYER_HEIGHT 2.0f
-#define CHUNK_SIZE 16.0f 
-
-static bool collisionCheck(world w, vec3d newPos) {
-  float minX = newPos->x - PLAYER_WIDTH / 2.0f;
-  float maxX = newPos->x + PLAYER_WIDTH / 2.0f;
-  float minY = newPos->y;
-  float maxY = newPos->y + PLAYER_HEIGHT;
-  float minZ = newPos->z - PLAYER_WIDTH / 2.0f;
-  float maxZ = newPos->z + PLAYER_WIDTH / 2.0f;
-
-  if (minY >= 16) {
-    return false;
+#define EPSILON 0.001f      // gap kept between a box and the block that stopped it
+#define CACHED_CHUNKS 4     // a box a few blocks across touches at most four
+
+#define BLOCK_INDEX(x, y, z) (((x) * CHUNK_SIZE_Y + (y)) * CHUNK_SIZE_Z + (z))
+
+// The blocks of the chunks a sweep has looked up, so each is found once
+// per sweep. Only kept for one call: chunks may be evicted between frames.
+typedef struct {
+  world w;
+  bool shared;        // peek at the blocks instead of touching them
+  int x[CACHED_CHUNKS], z[CACHED_CHUNKS];
+  const uint8_t *blocks[CACHED_CHUNKS];
+  int count, next;
+} chunkCache;
+
+// NULL when the chunk is not loaded
+static const uint8_t *cachedBlocks(chunkCache *cache, int chunkX, int chunkZ){
+  for (int i = 0; i < cache->count; i++){
+    if (cache->x[i] == chunkX && cache->z[i] == chunkZ) return cache->blocks[i];
   }
+  chunk c = getChunk(cache->w, chunkX, chunkZ);
+  const uint8_t *blocks = NULL;
+  if (c != NULL) blocks = cache->shared ? peekChunkBlocks(c) : getChunkBlocks(c);
+  int slot = cache->count < CACHED_CHUNKS ? cache->count++ : cache->next++ % CACHED_CHUNKS;
+  cache->x[slot] = chunkX;
+  cache->z[slot] = chunkZ;
+  cache->blocks[slot] = blocks;
+  return blocks;
+}
+
+// anything but air stops a body, even water; nothing outside the world
+// or in chunks that are not loaded does
+static bool blockSolid(chunkCache *cache, int x, int y, int z){
+  if (y < 0 || y >= CHUNK_SIZE_Y) return false;
+  int chunkX = (int)floorf((float)x / CHUNK_SIZE_X);
+  int chunkZ = (int)floorf((float)z / CHUNK_SIZE_Z);
+  const uint8_t *blocks = cachedBlocks(cache, chunkX, chunkZ);
+  if (blocks == NULL) return false;
+  uint8_t type = blocks[BLOCK_INDEX(x - chunkX * CHUNK_SIZE_X, y, z - chunkZ * CHUNK_SIZE_Z)];
+  return type != BLOCK_AIR && type != BLOCK_NULL;
+}
 
-  int minChunkX = floor(minX / CHUNK_SIZE);
-  int maxChunkX = ceil(maxX / CHUNK_SIZE);
-  int minChunkZ = floor(minZ / CHUNK_SIZE);
-  int maxChunkZ = ceil(maxZ / CHUNK_SIZE);
-
-  for (int cx = minChunkX; cx <= maxChunkX; cx++) {
-    for (int cz = minChunkZ; cz <= maxChunkZ; cz++) {
-      char key[20];
-      sprintf(key, "(%d, %d)", cx, cz);
-      chunk c = hashFind(getChunks(w), key);
-      if (!c) continue;
-
-      int startX = fmax(0, (int)(floor(minX - cx * CHUNK_SIZE)));
-      int endX   = fmin(15, (int)(ceil(maxX - cx * CHUNK_SIZE)));
-      int startY = fmax(0, (int)(floor(minY)));
-      int endY   = fmin(15, (int)(ceil(maxY)));
-      int startZ = fmax(0, (int)(floor(minZ - cz * CHUNK_SIZE)));
-      int endZ   = fmin(15, (int)(ceil(maxZ - cz * CHUNK_SIZE)));
-
-      for (int x = startX; x <= endX; x++) {
-        for (int y = startY; y <= endY; y++) {
-          for (int z = startZ; z <= endZ; z++) {
-            if (chunkBlockIsSolid(c, x, y, z)) {
-              return true;
-            }
-          }
-        }
+// whether any block in the layer the box's leading face enters on axis
+// is solid: cell on that axis, the cells the box covers on the others
+static bool layerSolid(chunkCache *cache, int axis, int cell, const float min[3], const float max[3]){
+  int lo[3], hi[3];
+  for (int i = 0; i < 3; i++){
+    lo[i] = (int)floorf(min[i]);
+    hi[i] = (int)ceilf(max[i]) - 1;
+  }
+  lo[axis] = hi[axis] = cell;
+  if (lo[1] < 0) lo[1] = 0;
+  if (hi[1] > CHUNK_SIZE_Y - 1) hi[1] = CHUNK_SIZE_Y - 1;
+  for (int x = lo[0]; x <= hi[0]; x++){
+    for (int y = lo[1]; y <= hi[1]; y++){
+      for (int z = lo[2]; z <= hi[2]; z++){
+        if (blockSolid(cache, x, y, z)) return true;
       }
     }
   }
   return false;
 }
 
+// Walks the box's leading faces across the grid along d, like a DDA ray
+// per face, and stops at the first layer of blocks with something solid
+// in it. Returns the fraction of d travelled and sets *axis to the one
+// that hit, or returns 1 and sets -1 when nothing was in the way.
+static float sweepOnce(chunkCache *cache, const float min[3], const float max[3],
+                       const float d[3], int *axis){
+  int step[3], cell[3];
+  float next[3], delta[3];
+  for (int i = 0; i < 3; i++){
+    step[i] = d[i] > 0.0f ? 1 : d[i] < 0.0f ? -1 : 0;
+    if (step[i] == 0){
+      next[i] = INFINITY;
+      delta[i] = INFINITY;
+      continue;
+    }
+    // the boundary the leading face crosses next and the cell past it
+    float boundary = step[i] > 0 ? ceilf(max[i]) : floorf(min[i]);
+    cell[i]  = step[i] > 0 ? (int)boundary : (int)boundary - 1;
+    next[i]  = (boundary - (step[i] > 0 ? max[i] : min[i])) / d[i];
+    delta[i] = 1.0f / fabsf(d[i]);
+  }
 
-#define SUBSTEPS 4
-#define EPSILON 0.001f
-
-void physics(world w, camera cam, vec3d velocity, bool* isGrounded, float dt) {
-  *isGrounded = false;
-  vec3d position = getPosition(cam);
-  vec3d stepVel = multiply(velocity, dt / SUBSTEPS);
-
-  for (int i = 0; i < SUBSTEPS; i++) {
-    vec3d newPos = copyVector(position);
-
-    // Vertical movement (Y)
-    newPos->y += stepVel->y;
-    if (collisionCheck(w, newPos)) {
-      // Try stepping just slightly off the floor
-      newPos->y = position->y;
-      if (velocity->y < 0.0f) *isGrounded = true;
-      velocity->y = 0.0f;
-    } else {
-      position->y = newPos->y;
+  for (;;){
+    int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+    float t = next[a];
+    if (t > 1.0f) break;
+    // where the box is as its face reaches the boundary
+    float atMin[3], atMax[3];
+    for (int i = 0; i < 3; i++){
+      atMin[i] = min[i] + d[i] * t;
+      atMax[i] = max[i] + d[i] * t;
+    }
+    if (layerSolid(cache, a, cell[a], atMin, atMax)){
+      *axis = a;
+      return t;
     }
+    cell[a] += step[a];
+    next[a] += delta[a];
+  }
+  *axis = -1;
+  return 1.0f;
+}
 
-    // Horizontal X
-    newPos->x = position->x + stepVel->x;
-    if (collisionCheck(w, newPos)) {
-      newPos->x = position->x;
-      velocity->x = 0.0f;
-    } else {
-      position->x = newPos->x;
+static sweepResult sweep(world w, bool shared, vec3 boxMin, vec3 boxMax, vec3 motion){
+  chunkCache cache = { .w = w, .shared = shared, .count = 0, .next = 0 };
+  float min[3] = { boxMin.x, boxMin.y, boxMin.z };
+  float max[3] = { boxMax.x, boxMax.y, boxMax.z };
+  float d[3]   = { motion.x, motion.y, motion.z };
+  float start[3] = { min[0], min[1], min[2] };
+  sweepResult result;
+  for (int i = 0; i < 3; i++){
+    result.hit[i]  = false;
+    result.time[i] = 1.0f;
+  }
+
+  // each hit takes one axis out of the motion, the rest slides on
+  float done = 0.0f;
+  for (int pass = 0; pass < 3; pass++){
+    if (d[0] == 0.0f && d[1] == 0.0f && d[2] == 0.0f) break;
+    int axis;
+    float t = sweepOnce(&cache, min, max, d, &axis);
+    for (int i = 0; i < 3; i++){
+      min[i] += d[i] * t;
+      max[i] += d[i] * t;
     }
+    if (axis < 0) break;
 
-    // Horizontal Z
-    newPos->z = position->z + stepVel->z;
-    if (collisionCheck(w, newPos)) {
-      newPos->z = position->z;
-      velocity->z = 0.0f;
+    // rest exactly against the block, a hair away from it
+    float size = max[axis] - min[axis];
+    if (d[axis] > 0.0f){
+      max[axis] = roundf(max[axis]) - EPSILON;
+      min[axis] = max[axis] - size;
     } else {
-      position->z = newPos->z;
+      min[axis] = roundf(min[axis]) + EPSILON;
+      max[axis] = min[axis] + size;
     }
-
-    free(newPos);
+    done += t * (1.0f - done);
+    result.hit[axis]  = true;
+    result.time[axis] = done;
+    for (int i = 0; i < 3; i++) d[i] *= 1.0f - t;
+    d[axis] = 0.0f;
   }
 
-  setXPosition(cam, position->x);
-  setYPosition(cam, position->y);
-  setZPosition(cam, position->z);
-  free(stepVel);
-}
\ No newline at end of file
+  result.moved = vec3Make(min[0] - start[0], min[1] - start[1], min[2] - start[2]);
+  return result;
+}
+
+sweepResult sweepBox(world w, vec3 boxMin, vec3 boxMax, vec3 motion){
+  return sweep(w, false, boxMin, boxMax, motion);
+}
+
+sweepResult sweepBoxShared(world w, vec3 boxMin, vec3 boxMax, vec3 motion){
+  return sweep(w, true, boxMin, boxMax, motion);
+}
+
+void physics(world w, camera cam, vec3d velocity, bool* isGrounded, float dt) {
+  vec3d position = getPosition(cam);
+  vec3 boxMin = vec3Make(position->x - PLAYER_WIDTH / 2.0f, position->y, position->z - PLAYER_WIDTH / 2.0f);
+  vec3 boxMax = vec3Make(position->x + PLAYER_WIDTH / 2.0f, position->y + PLAYER_HEIGHT, position->z + PLAYER_WIDTH / 2.0f);
+
+  sweepResult sweep = sweepBox(w, boxMin, boxMax, vec3Scale(*velocity, dt));
+  *position = vec3Add(*position, sweep.moved);
+
+  *isGrounded = sweep.hit[1] && velocity->y < 0.0f;
+  if (sweep.hit[0]) velocity->x = 0.0f;
+  if (sweep.hit[1]) velocity->y = 0.0f;
+  if (sweep.hit[2]) velocity->z = 0.0f;
+}
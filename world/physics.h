@@ -4,6 +4,24 @@
 #include "world.h"
 #include "camera.h"
 
+/*
+ * Collision of boxes against the block grid. A box is swept along its
+ * motion one layer of blocks at a time, so it stops at the exact block it
+ * reaches however fast it moves, and slides along what it hits.
+ */
+
+typedef struct {
+  vec3 moved;     // how far the box got, at most the motion asked for
+  bool hit[3];    // whether it was stopped on x, y and z
+  float time[3];  // fraction of the motion done when it was, 1 if not
+} sweepResult;
+
+// sweep the box from min to max through the world by motion
+extern sweepResult sweepBox(world w, vec3 min, vec3 max, vec3 motion);
+// the same for several threads sweeping at once: blocks are only read,
+// so every chunk the sweep can reach must have been touched this frame
+// and no thread may change blocks meanwhile. Cold chunks count as empty.
+extern sweepResult sweepBoxShared(world w, vec3 min, vec3 max, vec3 motion);
 extern void physics(world w, camera cam, vec3d velocity, bool *grounded, float dt);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,130 @@
+#include <math.h>
+
+#include "raycast.h"
+
+#define BLOCK_INDEX(x, y, z) (((x) * CHUNK_SIZE_Y + (y)) * CHUNK_SIZE_Z + (z))
+
+// the last chunk a ray started in, so a batch from one place looks it up once
+typedef struct {
+  bool valid;
+  int x, z;
+  chunk c;
+} startChunk;
+
+static chunk findStart(world w, startChunk *start, int chunkX, int chunkZ){
+  if (!start->valid || start->x != chunkX || start->z != chunkZ){
+    start->valid = true;
+    start->x = chunkX;
+    start->z = chunkZ;
+    start->c = getChunk(w, chunkX, chunkZ);
+  }
+  return start->c;
+}
+
+static int chunkOf(int block, int size){
+  return block >= 0 ? block / size : -((-block - 1) / size) - 1;
+}
+
+static rayHit castRay(world w, const ray *r, startChunk *start){
+  rayHit result = { .hit = false, .block = BLOCK_AIR, .x = 0, .y = 0, .z = 0,
+                    .normal = vec3Make(0.0f, 0.0f, 0.0f), .distance = r->maxDistance };
+  float length = vec3Length(r->direction);
+  if (length == 0.0f) return result;
+  vec3 d = vec3Scale(r->direction, 1.0f / length);
+  float origin[3] = { r->origin.x, r->origin.y, r->origin.z };
+  float dir[3] = { d.x, d.y, d.z };
+
+  // a ray from above or below the world starts where it comes into it
+  float t = 0.0f;
+  int cell[3], step[3];
+  float next[3], delta[3];
+  float normal[3] = { 0.0f, 0.0f, 0.0f };
+  bool entered = false;
+  if (origin[1] < 0.0f || origin[1] >= CHUNK_SIZE_Y){
+    bool below = origin[1] < 0.0f;
+    if (below ? dir[1] <= 0.0f : dir[1] >= 0.0f) return result;
+    t = ((below ? 0.0f : CHUNK_SIZE_Y) - origin[1]) / dir[1];
+    if (t > r->maxDistance) return result;
+    entered = true;
+    normal[1] = below ? -1.0f : 1.0f;
+  }
+  for (int i = 0; i < 3; i++){
+    cell[i] = (int)floorf(origin[i] + dir[i] * t);
+    step[i] = dir[i] > 0.0f ? 1 : dir[i] < 0.0f ? -1 : 0;
+  }
+  if (entered) cell[1] = origin[1] < 0.0f ? 0 : CHUNK_SIZE_Y - 1;
+  for (int i = 0; i < 3; i++){
+    if (step[i] == 0){
+      next[i]  = INFINITY;
+      delta[i] = INFINITY;
+      continue;
+    }
+    // measured from the origin so rounding does not build up
+    float boundary = (float)(step[i] > 0 ? cell[i] + 1 : cell[i]);
+    next[i]  = (boundary - origin[i]) / dir[i];
+    delta[i] = 1.0f / fabsf(dir[i]);
+  }
+
+  int chunkX = chunkOf(cell[0], CHUNK_SIZE_X);
+  int chunkZ = chunkOf(cell[2], CHUNK_SIZE_Z);
+  chunk c = findStart(w, start, chunkX, chunkZ);
+  if (c == NULL) return result;
+  int x = cell[0] - chunkX * CHUNK_SIZE_X;
+  int z = cell[2] - chunkZ * CHUNK_SIZE_Z;
+  const uint8_t *blocks = getChunkBlocks(c);
+
+  for (;;){
+    uint8_t block = blocks[BLOCK_INDEX(x, cell[1], z)];
+    if (block != BLOCK_AIR && !(r->throughWater && block == BLOCK_WATER)){
+      result.hit = true;
+      result.block = (BLOCK_TYPE)block;
+      result.x = cell[0];
+      result.y = cell[1];
+      result.z = cell[2];
+      result.normal = vec3Make(normal[0], normal[1], normal[2]);
+      result.distance = t;
+      return result;
+    }
+
+    int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+    t = next[axis];
+    if (t > r->maxDistance) return result;
+    next[axis] += delta[axis];
+    cell[axis] += step[axis];
+    normal[0] = normal[1] = normal[2] = 0.0f;
+    normal[axis] = (float)-step[axis];
+
+    // only leaving the chunk costs more than an index change
+    if (axis == 0){
+      x += step[0];
+      if (x < 0 || x >= CHUNK_SIZE_X){
+        c = getChunkNeighbour(c, x < 0 ? LEFT : RIGHT);
+        if (c == NULL) return result;
+        x -= step[0] * CHUNK_SIZE_X;
+        blocks = getChunkBlocks(c);
+      }
+    } else if (axis == 2){
+      z += step[2];
+      if (z < 0 || z >= CHUNK_SIZE_Z){
+        c = getChunkNeighbour(c, z < 0 ? BACK : FRONT);
+        if (c == NULL) return result;
+        z -= step[2] * CHUNK_SIZE_Z;
+        blocks = getChunkBlocks(c);
+      }
+    } else if (cell[1] < 0 || cell[1] >= CHUNK_SIZE_Y){
+      return result;
+    }
+  }
+}
+
+rayHit raycast(world w, const ray *r){
+  startChunk start = { .valid = false };
+  return castRay(w, r, &start);
+}
+
+void raycastBatch(world w, const ray *rays, rayHit *hits, int count){
+  startChunk start = { .valid = false };
+  for (int i = 0; i < count; i++){
+    hits[i] = castRay(w, &rays[i], &start);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <stdbool.h>
+
+#include "../utils/math.h"
+#include "chunk.h"
+#include "world.h"
+
+/*
+ * Ray queries against the blocks of the world, for picking and line of
+ * sight. A ray steps from block to block in the order it crosses their
+ * faces (Amanatides and Woo), reading each chunk's block array directly
+ * and moving to the next chunk through its neighbour links, so the world
+ * is only searched once for the chunk a ray starts in.
+ *
+ * Rays stop at the first block that is neither air nor, if they pass
+ * through water, water. They end without a hit on leaving the loaded
+ * chunks or the world's height, or after maxDistance.
+ */
+
+typedef struct {
+  vec3 origin;
+  vec3 direction;     // need not be normalised
+  float maxDistance;
+  bool throughWater;  // sight passes through water, a pick does not
+} ray;
+
+typedef struct {
+  bool hit;
+  BLOCK_TYPE block;
+  int x, y, z;        // world coordinates of the block hit
+  vec3 normal;        // out of the face the ray went in through, zero
+                      // when it started inside the block
+  float distance;     // from the origin to that face
+} rayHit;
+
+extern rayHit raycast(world w, const ray *r);
+// casts count rays, sharing the chunk lookup between rays that start in
+// the same chunk, as line of sight checks from one place do
+extern void raycastBatch(world w, const ray *rays, rayHit *hits, int count);
+
+#endif
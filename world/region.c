@@ -0,0 +1,346 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "region.h"
+#include "chunk.h"
+#include "../adts/chunkmap.h"
+#include "../utils/compress.h"
+
+#define REGION_MAGIC   "VTRG"
+#define REGION_VERSION 1
+#define REGION_CHUNKS  (REGION_SIZE * REGION_SIZE)
+#define REGION_MASK    (REGION_SIZE - 1)
+#define REGION_SHIFT   5   // log2(REGION_SIZE)
+
+// All fields are stored in host (little endian) byte order
+typedef struct {
+  uint32_t offset;    // from the start of the file, 0 when absent
+  uint32_t size;      // compressed bytes
+  uint32_t checksum;  // of the compressed bytes
+  uint8_t  codec;
+  uint8_t  pad[3];
+} regionEntry;
+
+typedef struct {
+  char     magic[4];
+  uint32_t version;
+  uint32_t chunkBytes;
+  uint32_t reserved;
+  regionEntry entries[REGION_CHUNKS];
+} regionHeader;
+
+typedef struct {
+  int rx, rz;
+  const uint8_t *map;   // whole file, NULL when there is none yet
+  size_t mapSize;
+  // compressed saves not yet written to the file
+  uint8_t *pending[REGION_CHUNKS];
+  regionEntry pendingEntry[REGION_CHUNKS];
+  // saves a flush took from pending and is writing out, loaded from here
+  // until the new file is mapped. The flush reads them outside the lock
+  uint8_t *writing[REGION_CHUNKS];
+  regionEntry writingEntry[REGION_CHUNKS];
+  bool dirty;
+} region;
+
+struct regionstore {
+  char dir[256];
+  chunkmap regions;  // keyed on region coordinates
+  // background saves share the store with the main thread
+  pthread_mutex_t lock;
+  // one flush at a time, as it writes files without holding lock
+  pthread_mutex_t flushLock;
+};
+
+static void regionPath(regionstore s, int rx, int rz, char *out, size_t n, const char *suffix){
+  snprintf(out, n, "%s/r.%d.%d.bin%s", s->dir, rx, rz, suffix);
+}
+
+static void unmapRegion(region *r){
+  if (r->map != NULL){
+    munmap((void *)r->map, r->mapSize);
+  }
+  r->map = NULL;
+  r->mapSize = 0;
+}
+
+static void mapRegion(regionstore s, region *r){
+  char path[300];
+  regionPath(s, r->rx, r->rz, path, sizeof(path), "");
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(regionHeader)){
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED){
+      const regionHeader *h = map;
+      if (memcmp(h->magic, REGION_MAGIC, 4) == 0
+          && h->version == REGION_VERSION
+          && h->chunkBytes == CHUNK_BLOCK_BYTES){
+        r->map = map;
+        r->mapSize = st.st_size;
+      } else {
+        fprintf(stderr, "Ignoring incompatible region file %s\n", path);
+        munmap(map, st.st_size);
+      }
+    }
+  }
+  close(fd);
+}
+
+static void freeRegion(void *el){
+  region *r = el;
+  unmapRegion(r);
+  for (int i = 0; i < REGION_CHUNKS; i++){
+    free(r->pending[i]);
+    free(r->writing[i]);
+  }
+  free(r);
+}
+
+static region *getRegion(regionstore s, int chunkX, int chunkZ){
+  int rx = chunkX >> REGION_SHIFT;
+  int rz = chunkZ >> REGION_SHIFT;
+  region *r = chunkMapFind(s->regions, rx, rz);
+  if (r != NULL) return r;
+
+  // missing files are cached too so we only try to open them once
+  r = calloc(1, sizeof(region));
+  assert(r != NULL);
+  r->rx = rx;
+  r->rz = rz;
+  mapRegion(s, r);
+  chunkMapSet(s->regions, rx, rz, r);
+  return r;
+}
+
+static inline int entryIndex(int chunkX, int chunkZ){
+  return (chunkX & REGION_MASK) * REGION_SIZE + (chunkZ & REGION_MASK);
+}
+
+regionstore openRegionStore(const char *dir){
+  regionstore new = malloc(sizeof(struct regionstore));
+  assert(new != NULL);
+  snprintf(new->dir, sizeof(new->dir), "%s", dir);
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST){
+    fprintf(stderr, "Could not create save directory %s\n", dir);
+  }
+  new->regions = chunkMapCreate(&freeRegion);
+  pthread_mutex_init(&new->lock, NULL);
+  pthread_mutex_init(&new->flushLock, NULL);
+  return new;
+}
+
+void closeRegionStore(regionstore s){
+  regionStoreFlush(s);
+  chunkMapFree(s->regions);
+  pthread_mutex_destroy(&s->lock);
+  pthread_mutex_destroy(&s->flushLock);
+  free(s);
+}
+
+static bool decodeEntry(const regionEntry *e, const uint8_t *data, uint8_t *blocks){
+  if (checksum(data, e->size) != e->checksum) return false;
+  return decompress(e->codec, data, e->size, blocks, CHUNK_BLOCK_BYTES) == CHUNK_BLOCK_BYTES;
+}
+
+// whether the entry lies inside the mapped file. The offset is checked
+// first so a corrupt one cannot wrap the subtraction
+static bool entryInMap(const region *r, const regionEntry *e){
+  return e->offset >= sizeof(regionHeader) && e->offset <= r->mapSize
+      && e->size <= r->mapSize - e->offset;
+}
+
+static bool loadLocked(regionstore s, int chunkX, int chunkZ, uint8_t *blocks){
+  region *r = getRegion(s, chunkX, chunkZ);
+  int i = entryIndex(chunkX, chunkZ);
+
+  if (r->pending[i] != NULL){
+    return decodeEntry(&r->pendingEntry[i], r->pending[i], blocks);
+  }
+  if (r->writing[i] != NULL){
+    return decodeEntry(&r->writingEntry[i], r->writing[i], blocks);
+  }
+  if (r->map == NULL) return false;
+
+  const regionEntry *e = &((const regionHeader *)r->map)->entries[i];
+  if (e->offset == 0) return false;
+  if (!entryInMap(r, e)){
+    fprintf(stderr, "Corrupt region entry for chunk (%d, %d)\n", chunkX, chunkZ);
+    return false;
+  }
+  if (!decodeEntry(e, r->map + e->offset, blocks)){
+    fprintf(stderr, "Bad checksum or data for chunk (%d, %d)\n", chunkX, chunkZ);
+    return false;
+  }
+  return true;
+}
+
+bool regionStoreLoad(regionstore s, int chunkX, int chunkZ, uint8_t *blocks){
+  pthread_mutex_lock(&s->lock);
+  bool found = loadLocked(s, chunkX, chunkZ, blocks);
+  pthread_mutex_unlock(&s->lock);
+  return found;
+}
+
+void regionStoreSave(regionstore s, int chunkX, int chunkZ, const uint8_t *blocks){
+  // compress outside the lock, it is the expensive part
+  uint8_t buffer[CHUNK_BLOCK_BYTES];
+  CODEC codec;
+  size_t size = compressBest(blocks, CHUNK_BLOCK_BYTES, buffer, &codec);
+  uint8_t *data = malloc(size > 0 ? size : 1);
+  assert(data != NULL);
+  memcpy(data, buffer, size);
+  uint32_t sum = checksum(buffer, size);
+
+  pthread_mutex_lock(&s->lock);
+  region *r = getRegion(s, chunkX, chunkZ);
+  int i = entryIndex(chunkX, chunkZ);
+  free(r->pending[i]);
+  r->pending[i] = data;
+
+  regionEntry *e = &r->pendingEntry[i];
+  memset(e, 0, sizeof(*e));
+  e->size     = (uint32_t)size;
+  e->checksum = sum;
+  e->codec    = (uint8_t)codec;
+  r->dirty    = true;
+  pthread_mutex_unlock(&s->lock);
+}
+
+// writes header + data to a temporary file, without the store's lock.
+// Only this flush changes the saves being written and the old mapping,
+// loads just read them
+static bool writeRegion(regionstore s, region *r){
+  regionHeader *h = calloc(1, sizeof(regionHeader));
+  assert(h != NULL);
+  memcpy(h->magic, REGION_MAGIC, 4);
+  h->version    = REGION_VERSION;
+  h->chunkBytes = CHUNK_BLOCK_BYTES;
+
+  const regionHeader *old = (const regionHeader *)r->map;
+  const uint8_t *data[REGION_CHUNKS];
+  uint32_t offset = sizeof(regionHeader);
+
+  for (int i = 0; i < REGION_CHUNKS; i++){
+    data[i] = NULL;
+    if (r->writing[i] != NULL){
+      h->entries[i] = r->writingEntry[i];
+      data[i] = r->writing[i];
+    } else if (old != NULL && old->entries[i].offset != 0 && entryInMap(r, &old->entries[i])){
+      h->entries[i] = old->entries[i];
+      data[i] = r->map + old->entries[i].offset;
+    }
+    if (data[i] != NULL){
+      h->entries[i].offset = offset;
+      offset += h->entries[i].size;
+    }
+  }
+
+  char tmp[300];
+  regionPath(s, r->rx, r->rz, tmp, sizeof(tmp), ".tmp");
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL){
+    fprintf(stderr, "Could not write region file %s\n", tmp);
+    free(h);
+    return false;
+  }
+  bool ok = fwrite(h, sizeof(regionHeader), 1, f) == 1;
+  for (int i = 0; i < REGION_CHUNKS && ok; i++){
+    if (data[i] != NULL && h->entries[i].size > 0){
+      ok = fwrite(data[i], h->entries[i].size, 1, f) == 1;
+    }
+  }
+  ok = (fclose(f) == 0) && ok;
+  free(h);
+
+  if (!ok){
+    fprintf(stderr, "Failed writing region file %s\n", tmp);
+    remove(tmp);
+  }
+  return ok;
+}
+
+// under the lock: puts the written file in place of the old one, or
+// hands the saves back to pending when that failed
+static void finishRegion(regionstore s, region *r, bool written){
+  if (written){
+    char path[300], tmp[300];
+    regionPath(s, r->rx, r->rz, path, sizeof(path), "");
+    regionPath(s, r->rx, r->rz, tmp, sizeof(tmp), ".tmp");
+    unmapRegion(r);
+    written = rename(tmp, path) == 0;
+    mapRegion(s, r);
+    if (!written){
+      fprintf(stderr, "Could not replace region file %s\n", path);
+      remove(tmp);
+    }
+  }
+  for (int i = 0; i < REGION_CHUNKS; i++){
+    if (r->writing[i] == NULL) continue;
+    if (!written && r->pending[i] == NULL){
+      // keep it for the next flush, unless a newer save replaced it
+      r->pending[i]      = r->writing[i];
+      r->pendingEntry[i] = r->writingEntry[i];
+      r->dirty = true;
+    } else {
+      free(r->writing[i]);
+    }
+    r->writing[i] = NULL;
+  }
+}
+
+typedef struct {
+  region **regions;
+  int count, capacity;
+} flushList;
+
+// moves a dirty region's pending saves to writing and lists it
+static void flushCallback(int rx, int rz, void *el, void *arg){
+  region *r = el;
+  flushList *list = arg;
+  if (!r->dirty) return;
+  for (int i = 0; i < REGION_CHUNKS; i++){
+    r->writing[i]      = r->pending[i];
+    r->writingEntry[i] = r->pendingEntry[i];
+    r->pending[i]      = NULL;
+  }
+  r->dirty = false;
+  if (list->count == list->capacity){
+    list->capacity = list->capacity > 0 ? 2 * list->capacity : 8;
+    list->regions  = realloc(list->regions, list->capacity * sizeof(region *));
+    assert(list->regions != NULL);
+  }
+  list->regions[list->count++] = r;
+}
+
+void regionStoreFlush(regionstore s){
+  pthread_mutex_lock(&s->flushLock);
+  flushList list = { NULL, 0, 0 };
+  pthread_mutex_lock(&s->lock);
+  chunkMapForeach(s->regions, &flushCallback, &list);
+  pthread_mutex_unlock(&s->lock);
+
+  // loads and saves carry on while the files are written
+  for (int i = 0; i < list.count; i++){
+    bool written = writeRegion(s, list.regions[i]);
+    pthread_mutex_lock(&s->lock);
+    finishRegion(s, list.regions[i], written);
+    pthread_mutex_unlock(&s->lock);
+  }
+  free(list.regions);
+  pthread_mutex_unlock(&s->flushLock);
+}
@@ -0,0 +1,31 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Chunks per region file along x and z
+#define REGION_SIZE 32
+
+/*
+ * Persistent chunk storage. Each region file holds REGION_SIZE x REGION_SIZE
+ * chunk columns: a fixed header table of (offset, size, checksum, codec)
+ * entries followed by the compressed block data. Files are mmapped, so
+ * loading a chunk is a bounds check, a checksum and a decompress.
+ * Saves are buffered per region and written out by regionStoreFlush.
+ * All calls are safe to make from a background saving thread.
+ */
+struct regionstore;
+typedef struct regionstore *regionstore;
+
+// Usage - regionstore s = openRegionStore("saves"); creates the directory
+extern regionstore openRegionStore(const char *dir);
+// flushes any pending saves before closing
+extern void closeRegionStore(regionstore s);
+// fills blocks (CHUNK_BLOCK_BYTES) and returns true if the chunk is stored
+extern bool regionStoreLoad(regionstore s, int chunkX, int chunkZ, uint8_t *blocks);
+extern void regionStoreSave(regionstore s, int chunkX, int chunkZ, const uint8_t *blocks);
+// rewrites every region file that has pending saves
+extern void regionStoreFlush(regionstore s);
+
+#endif
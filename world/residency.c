@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "residency.h"
+#include "chunk.h"
+#include "../adts/chunkmap.h"
+
+typedef struct lruNode {
+  int x, z;
+  chunk c;
+  size_t bytes;
+  unsigned lastVisibleFrame;
+  struct lruNode *prev;   // towards the most recently visible
+  struct lruNode *next;   // towards the least recently visible
+} lruNode;
+
+struct residency {
+  chunkmap nodes;   // (x, z) -> lruNode
+  lruNode *head;    // most recently visible
+  lruNode *tail;    // least recently visible
+  size_t budget;
+  size_t current;
+  size_t peak;
+  unsigned long evictions;
+  unsigned frame;
+  residencyevictfunc evict;
+  void *arg;
+};
+
+residency createResidency(size_t budgetBytes, residencyevictfunc evict, void *arg){
+  residency new = malloc(sizeof(struct residency));
+  assert(new != NULL);
+  // the nodes only reference chunks, the world owns them
+  new->nodes     = chunkMapCreate(&free);
+  new->head      = NULL;
+  new->tail      = NULL;
+  new->budget    = budgetBytes;
+  new->current   = 0;
+  new->peak      = 0;
+  new->evictions = 0;
+  new->frame     = 0;
+  new->evict     = evict;
+  new->arg       = arg;
+  return new;
+}
+
+void freeResidency(residency r){
+  chunkMapFree(r->nodes);
+  free(r);
+}
+
+void setResidencyBudget(residency r, size_t budgetBytes){
+  r->budget = budgetBytes;
+}
+
+static void lruUnlink(residency r, lruNode *n){
+  if (n->prev != NULL) n->prev->next = n->next; else r->head = n->next;
+  if (n->next != NULL) n->next->prev = n->prev; else r->tail = n->prev;
+  n->prev = n->next = NULL;
+}
+
+static void pushFront(residency r, lruNode *n){
+  n->prev = NULL;
+  n->next = r->head;
+  if (r->head != NULL) r->head->prev = n; else r->tail = n;
+  r->head = n;
+}
+
+// the mesh is built lazily, so the size is refreshed whenever we see it
+static void refreshBytes(residency r, lruNode *n){
+  size_t bytes = chunkMemoryBytes(n->c);
+  r->current = r->current - n->bytes + bytes;
+  n->bytes = bytes;
+  if (r->current > r->peak) r->peak = r->current;
+}
+
+void residencyTrack(residency r, int x, int z, chunk c){
+  assert(chunkMapFind(r->nodes, x, z) == NULL);
+  lruNode *n = malloc(sizeof(lruNode));
+  assert(n != NULL);
+  n->x = x;
+  n->z = z;
+  n->c = c;
+  n->bytes = 0;
+  n->lastVisibleFrame = r->frame;
+  chunkMapSet(r->nodes, x, z, n);
+  pushFront(r, n);
+  refreshBytes(r, n);
+}
+
+void residencyTouch(residency r, int x, int z){
+  lruNode *n = chunkMapFind(r->nodes, x, z);
+  if (n == NULL) return;
+  n->lastVisibleFrame = r->frame;
+  if (r->head != n){
+    lruUnlink(r, n);
+    pushFront(r, n);
+  }
+  refreshBytes(r, n);
+}
+
+void residencyEndFrame(residency r){
+  lruNode *n = r->tail;
+  while (r->budget != 0 && r->current > r->budget && n != NULL){
+    lruNode *prev = n->prev;
+    // everything from here on was visible this frame
+    if (n->lastVisibleFrame == r->frame) break;
+
+    if (r->evict(n->x, n->z, n->c, r->arg)){
+      r->current -= n->bytes;
+      r->evictions++;
+      lruUnlink(r, n);
+      chunkMapRemove(r->nodes, n->x, n->z);
+      free(n);
+    }
+    n = prev;
+  }
+  r->frame++;
+}
+
+residencyStats getResidencyStats(residency r){
+  residencyStats stats;
+  stats.budgetBytes    = r->budget;
+  stats.currentBytes   = r->current;
+  stats.peakBytes      = r->peak;
+  stats.residentChunks = chunkMapMembers(r->nodes);
+  stats.evictions      = r->evictions;
+  return stats;
+}
@@ -0,0 +1,43 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "chunk.h"
+
+/*
+ * Keeps the memory used by loaded chunks (block data plus mesh data) under
+ * a budget. Chunks are kept in least-recently-visible order; at the end of
+ * each frame the oldest ones are handed to the evict callback until the
+ * total is back under budget. Chunks seen in the current frame are never
+ * evicted.
+ */
+struct residency;
+typedef struct residency *residency;
+
+// Return false to keep the chunk (e.g. it has edits that could not be saved).
+// On true the callback owns the chunk and must unlink and free it.
+typedef bool (*residencyevictfunc)( int x, int z, chunk c, void *arg );
+
+typedef struct {
+  size_t budgetBytes;
+  size_t currentBytes;
+  size_t peakBytes;
+  int residentChunks;
+  unsigned long evictions;
+} residencyStats;
+
+// a budget of 0 means unlimited
+extern residency createResidency(size_t budgetBytes, residencyevictfunc evict, void *arg);
+extern void freeResidency(residency r);
+extern void setResidencyBudget(residency r, size_t budgetBytes);
+// start tracking a newly loaded chunk
+extern void residencyTrack(residency r, int x, int z, chunk c);
+// mark (x, z) as visible in the current frame
+extern void residencyTouch(residency r, int x, int z);
+// evicts down to the budget and advances the frame counter
+extern void residencyEndFrame(residency r);
+extern residencyStats getResidencyStats(residency r);
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "snapshot.h"
+#include "chunk.h"
+#include "region.h"
+#include "../adts/chunkmap.h"
+
+typedef struct {
+  int x, z;
+  blockdata data;
+} snapshotEntry;
+
+struct snapshot {
+  snapshotEntry *entries;
+  int count;
+  int cap;
+};
+
+static void collectCallback(int x, int z, void *el, void *arg){
+  chunk c = el;
+  snapshot s = arg;
+  if (!chunkIsModified(c)) return;
+
+  if (s->count == s->cap){
+    s->cap = s->cap * 2;
+    s->entries = realloc(s->entries, s->cap * sizeof(snapshotEntry));
+    assert(s->entries != NULL);
+  }
+  s->entries[s->count].x    = x;
+  s->entries[s->count].z    = z;
+  s->entries[s->count].data = shareChunkBlocks(c);
+  s->count++;
+  setChunkModified(c, false);
+}
+
+snapshot takeSnapshot(chunkmap chunks){
+  snapshot new = malloc(sizeof(struct snapshot));
+  assert(new != NULL);
+  new->count   = 0;
+  new->cap     = 64;
+  new->entries = malloc(new->cap * sizeof(snapshotEntry));
+  assert(new->entries != NULL);
+  chunkMapForeach(chunks, &collectCallback, new);
+  return new;
+}
+
+int snapshotChunks(snapshot s){
+  return s->count;
+}
+
+void writeSnapshot(snapshot s, regionstore store){
+  for (int i = 0; i < s->count; i++){
+    snapshotEntry *e = &s->entries[i];
+    regionStoreSave(store, e->x, e->z, getBlockDataBytes(e->data));
+  }
+  regionStoreFlush(store);
+}
+
+void freeSnapshot(snapshot s){
+  for (int i = 0; i < s->count; i++){
+    releaseBlocks(s->entries[i].data);
+  }
+  free(s->entries);
+  free(s);
+}
@@ -0,0 +1,23 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "../adts/chunkmap.h"
+#include "region.h"
+
+/*
+ * A point-in-time copy of the modified chunks of a world. Taking one only
+ * grabs a reference to each chunk's block data; the chunk pays for a copy
+ * the first time it is written to afterwards. The snapshot can then be
+ * written out on another thread while the game keeps editing.
+ */
+struct snapshot;
+typedef struct snapshot *snapshot;
+
+// takes every modified chunk in chunks and clears its modified flag
+extern snapshot takeSnapshot(chunkmap chunks);
+extern int snapshotChunks(snapshot s);
+// compresses and stores every chunk, then flushes the region files
+extern void writeSnapshot(snapshot s, regionstore store);
+extern void freeSnapshot(snapshot s);
+
+#endif
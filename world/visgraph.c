@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include "visgraph.h"
+
+#define ANY_FACE FACE_COUNT   // the camera's own chunk can be left any way
+
+// a chunk entered through face, or the open space above or below a column
+typedef struct {
+  short x, z;       // relative to the corner of the window
+  uint8_t face;
+  bool outside;
+} step;
+
+struct visgraph {
+  int distance;
+  int side;             // 2 * distance + 1 columns a row
+  int camX, camZ;
+  uint8_t *allowed;     // per column of the window
+  uint8_t *entered;     // per column, a bit per FACE the chunk was entered through
+  uint8_t *outsideEntered;
+  step *queue;
+};
+
+// the horizontal faces and the column each one leads to
+static const FACE exits[4] = { BACK, FRONT, LEFT, RIGHT };
+static const int exitX[4]  = { 0, 0, -1, 1 };
+static const int exitZ[4]  = { -1, 1, 0, 0 };
+
+visgraph createVisGraph(int distance){
+  visgraph new = malloc(sizeof(struct visgraph));
+  assert(new != NULL);
+  new->distance = distance;
+  new->side     = 2 * distance + 1;
+  int columns   = new->side * new->side;
+  new->allowed    = calloc(columns, 1);
+  new->entered    = calloc(columns, 1);
+  new->outsideEntered = calloc(columns, 1);
+  // each column is entered at most once per face, plus once from outside
+  new->queue = malloc((size_t)columns * (FACE_COUNT + 1) * sizeof(step));
+  assert(new->allowed != NULL && new->entered != NULL && new->outsideEntered != NULL && new->queue != NULL);
+  new->camX = 0;
+  new->camZ = 0;
+  return new;
+}
+
+void freeVisGraph(visgraph g){
+  free(g->allowed);
+  free(g->entered);
+  free(g->outsideEntered);
+  free(g->queue);
+  free(g);
+}
+
+void visGraphReset(visgraph g, int camX, int camZ){
+  int columns = g->side * g->side;
+  memset(g->allowed, 0, columns);
+  memset(g->entered, 0, columns);
+  memset(g->outsideEntered, 0, columns);
+  g->camX = camX;
+  g->camZ = camZ;
+}
+
+// index into the window, -1 outside it
+static int columnIndex(visgraph g, int x, int z){
+  int rx = x - g->camX + g->distance;
+  int rz = z - g->camZ + g->distance;
+  if (rx < 0 || rx >= g->side || rz < 0 || rz >= g->side) return -1;
+  return rx * g->side + rz;
+}
+
+void visGraphAllow(visgraph g, int x, int z){
+  int i = columnIndex(g, x, z);
+  if (i >= 0) g->allowed[i] = 1;
+}
+
+bool visGraphReached(visgraph g, int x, int z){
+  int i = columnIndex(g, x, z);
+  return i >= 0 && g->entered[i] != 0;
+}
+
+// a line of sight only ever moves away from the camera's column
+static bool awayFromCamera(int from, int step){
+  return step < 0 ? from <= 0 : from >= 0;
+}
+
+int visGraphSearch(visgraph g, float camY, visgraphlookup lookup, void *arg){
+  int head = 0, tail = 0;
+  int d = g->distance;
+  int centre = d * g->side + d;
+  // looking down from above the world or up from below it
+  FACE entry = camY >= CHUNK_SIZE_Y ? TOP : BOTTOM;
+  if (camY >= CHUNK_SIZE_Y || camY < 0.0f){
+    g->outsideEntered[centre] = 1;
+    g->queue[tail++] = (step){ d, d, ANY_FACE, true };
+  } else {
+    g->entered[centre] = (1 << FACE_COUNT) - 1;
+    g->queue[tail++] = (step){ d, d, ANY_FACE, false };
+  }
+
+  while (head < tail){
+    step s = g->queue[head++];
+    int worldX = g->camX + s.x - d;
+    int worldZ = g->camZ + s.z - d;
+
+    if (s.outside){
+      // into the chunk of this column, then on through open space
+      int i = s.x * g->side + s.z;
+      if (g->allowed[i] && !(g->entered[i] & (1 << entry))){
+        g->entered[i] |= 1 << entry;
+        g->queue[tail++] = (step){ s.x, s.z, entry, false };
+      }
+      for (int e = 0; e < 4; e++){
+        if (exitX[e] != 0 && !awayFromCamera(s.x - d, exitX[e])) continue;
+        if (exitZ[e] != 0 && !awayFromCamera(s.z - d, exitZ[e])) continue;
+        int nx = s.x + exitX[e], nz = s.z + exitZ[e];
+        if (nx < 0 || nx >= g->side || nz < 0 || nz >= g->side) continue;
+        int n = nx * g->side + nz;
+        if (g->outsideEntered[n]) continue;
+        g->outsideEntered[n] = 1;
+        g->queue[tail++] = (step){ nx, nz, ANY_FACE, true };
+      }
+      continue;
+    }
+
+    chunk c = lookup(worldX, worldZ, arg);
+    for (int e = 0; e < 4; e++){
+      if (exitX[e] != 0 && !awayFromCamera(s.x - d, exitX[e])) continue;
+      if (exitZ[e] != 0 && !awayFromCamera(s.z - d, exitZ[e])) continue;
+      if (s.face != ANY_FACE && c != NULL && !chunkFacesConnected(c, s.face, exits[e])) continue;
+      int nx = s.x + exitX[e], nz = s.z + exitZ[e];
+      if (nx < 0 || nx >= g->side || nz < 0 || nz >= g->side) continue;
+      int n = nx * g->side + nz;
+      FACE in = exits[e] ^ 1;   // entered through the opposite side
+      if (!g->allowed[n] || (g->entered[n] & (1 << in))) continue;
+      g->entered[n] |= 1 << in;
+      g->queue[tail++] = (step){ nx, nz, in, false };
+    }
+    // leaving through the top or bottom only reaches open space, and a
+    // line of sight never turns back into the world from there
+  }
+  return head;
+}
@@ -0,0 +1,38 @@
+#ifndef VISGRAPH_H
+#define VISGRAPH_H
+
+#include <stdbool.h>
+
+#include "chunk.h"
+
+/*
+ * Visibility through the chunk graph. Starting at the camera's chunk, a
+ * breadth first search steps into a neighbour only through faces that
+ * open air or water joins inside the chunk, and never back towards the
+ * camera, because no line of sight can turn around. Chunks it never
+ * reaches (sealed underground, or closed off behind solid rock) cannot
+ * be seen, without any depth testing.
+ *
+ * The world is one chunk tall, so the space above it and the space below
+ * it are each a single open layer. They only matter when the camera is
+ * out there, looking into the world through the top or bottom faces.
+ */
+struct visgraph;
+typedef struct visgraph *visgraph;
+
+// NULL when the chunk is not loaded, it is then taken to join every face
+typedef chunk (*visgraphlookup)(int x, int z, void *arg);
+
+// searches at most distance chunks from the camera in x and z
+extern visgraph createVisGraph(int distance);
+extern void freeVisGraph(visgraph g);
+// forget the last search and centre the next on the camera's column
+extern void visGraphReset(visgraph g, int camX, int camZ);
+// the search only enters columns allowed since the reset, the ones
+// in the view frustum
+extern void visGraphAllow(visgraph g, int x, int z);
+// camY is the camera's block height, returns the number of steps taken
+extern int visGraphSearch(visgraph g, float camY, visgraphlookup lookup, void *arg);
+extern bool visGraphReached(visgraph g, int x, int z);
+
+#endif
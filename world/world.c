@@ -2,18 +2,70 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 
 #include "world.h"
-#include "../adts/hash.h"
+#include "../adts/chunkmap.h"
 #include "../utils/math.h"
 #include "chunk.h"
-#include "../utils/stringManipulate.h"
+#include "chunkwindow.h"
+#include "region.h"
+#include "residency.h"
+#include "snapshot.h"
+#include "coldstore.h"
+#include "culltree.h"
+#include "occlusion.h"
+#include "visgraph.h"
+#include "../utils/pool.h"
+
+#define RENDER_DISTANCE 5  // default chunks drawn around the camera
+
+// a column that passed frustum culling, waiting on the occlusion test
+typedef struct {
+  int x, z;
+  float distance;    // squared, from the camera
+} column;
+
+// chunks that passed culling for one pass, rebuilt every time it is
+// culled, and the pass's own scratch so both passes can cull at once
+typedef struct {
+  chunk *chunks;     // room for every chunk in render distance, NULL for
+                     // one evicted since, loaded again when it is drawn
+  column *places;    // where each of those chunks goes
+  int count;
+  passStats stats;
+  // sized for the render distance
+  column *columns;
+  int columnCount;
+  occluder *occluders;
+  occlusion hidden;  // NULL when occlusion culling is off
+  visgraph graph;    // which chunks a line of sight can get to
+} visibleList;
 
 struct world{
-  hash chunks;
+  chunkmap chunks;
+  chunkwindow window; // chunks around the camera, indexed without hashing
+  regionstore store;  // NULL when the world is not persisted
+  residency resident; // keeps loaded chunks under the memory budget
+  coldstore cold;     // compresses chunks that sit idle
+  // background save, at most one at a time
+  pthread_t saver;
+  snapshot saving;    // NULL when no save is running
+  atomic_bool saveFinished;
+  double writeSeconds; // only touched by the saver until it is joined
+  saveStats stats;
+  visibleList visible[RENDER_PASSES];
+  pool rasterisers;     // shared by the passes' occlusion, NULL when off
+  culltree bounds;      // height ranges of the columns, for culling
+  unsigned boundsGeneration;
+  pthread_mutex_t boundsLock; // the first pass culled refreshes them
+  int renderDistance;
   int  width;
   int  height; 
 };
@@ -26,32 +78,447 @@ static void freeChunks(void *el){
   freeChunk(c);
 }
 
-hash getChunks(world w){
+chunkmap getChunks(world w){
   return w->chunks;
 }
 
-world createWorld(int width, int height){
+chunk getChunk(world w, int chunkX, int chunkZ){
+  return chunkWindowFind(w->window, w->chunks, chunkX, chunkZ);
+}
+
+void centreWorld(world w, vec3d pos){
+  int chunkX = (int)floorf(pos->x / 16.0f);
+  int chunkZ = (int)floorf(pos->z / 16.0f);
+  recentreChunkWindow(w->window, w->chunks, chunkX, chunkZ);
+}
+
+// load the chunk from the save if it is there, otherwise generate it
+static chunk loadChunk(world w, int chunkX, int chunkZ){
+  float x = (float)chunkX * CHUNK_SIZE_X;
+  float z = (float)chunkZ * CHUNK_SIZE_Z;
+  if (w->store != NULL){
+    uint8_t blocks[CHUNK_BLOCK_BYTES];
+    if (regionStoreLoad(w->store, chunkX, chunkZ, blocks)){
+      return createChunkFromBlocks(x, 0.0f, z, blocks);
+    }
+  }
+  chunk c = createChunk(x, 0.0f, z);
+  // trees follow the seed, which a new run may change, so a fresh chunk
+  // has to be saved to come back the same
+  setChunkModified(c, w->store != NULL);
+  return c;
+}
+
+static double nowSeconds(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void insertChunk(world w, int chunkX, int chunkZ, chunk c){
+  chunkMapSet(w->chunks, chunkX, chunkZ, c);
+  chunkWindowUpdate(w->window, chunkX, chunkZ, c);
+  residencyTrack(w->resident, chunkX, chunkZ, c);
+  int minY, maxY;
+  chunkHeightRange(c, &minY, &maxY);
+  cullTreeSetColumn(w->bounds, chunkX, chunkZ, (float)minY, (float)maxY);
+  linkChunks(c, LEFT,  getChunk(w, chunkX - 1, chunkZ));
+  linkChunks(c, RIGHT, getChunk(w, chunkX + 1, chunkZ));
+  linkChunks(c, BACK,  getChunk(w, chunkX, chunkZ - 1));
+  linkChunks(c, FRONT, getChunk(w, chunkX, chunkZ + 1));
+}
+
+// called by the residency manager for the least recently visible chunks
+static bool evictChunk(int chunkX, int chunkZ, chunk c, void *arg){
+  world w = arg;
+  // the snapshot marked its chunks clean before the saver has written
+  // them, so loading one back now would read the older copy on disk
+  if (w->saving != NULL) return false;
+  if (chunkIsModified(c)){
+    // without a save the edits would be lost, so keep it loaded
+    if (w->store == NULL) return false;
+    // buffered in the store, where loading finds it, until the next save
+    // flushes it from the saver thread
+    regionStoreSave(w->store, chunkX, chunkZ, getChunkBlocks(c));
+  }
+  chunkMapRemove(w->chunks, chunkX, chunkZ);
+  chunkWindowUpdate(w->window, chunkX, chunkZ, NULL);
+  // the save brings it back the same, otherwise its heights are unknown
+  if (w->store == NULL) cullTreeResetColumn(w->bounds, chunkX, chunkZ);
+  freeChunk(c);  // also unlinks it from its neighbours
+  return true;
+}
+
+world createWorld(int width, int height, const char *saveDir){
   world new = malloc(sizeof(struct world));
   assert(new != NULL);
-  new->chunks = hashCreate(NULL, &freeChunks, NULL);
+  new->chunks = chunkMapCreate(&freeChunks);
   assert(new->chunks != NULL);
+  new->window = createChunkWindow();
+  new->store  = saveDir != NULL ? openRegionStore(saveDir) : NULL;
+  new->resident = createResidency(0, &evictChunk, new);
+  new->cold     = createColdStore(0);
+  new->saving = NULL;
+  atomic_init(&new->saveFinished, false);
+  new->stats.lastSnapshotSeconds = 0.0;
+  new->stats.lastSnapshotChunks  = 0;
+  new->stats.lastWriteSeconds    = 0.0;
+  new->stats.copiedBytes         = 0;
+  new->stats.savesCompleted      = 0;
+  new->stats.saving              = false;
+  for (int i = 0; i < RENDER_PASSES; i++){
+    new->visible[i] = (visibleList){ .chunks = NULL, .places = NULL, .count = 0,
+                                     .stats = { 0, 0, 0, 0, 0, 0 },
+                                     .columns = NULL, .columnCount = 0, .occluders = NULL,
+                                     .hidden = NULL, .graph = NULL };
+  }
+  new->rasterisers = NULL;
+  pthread_mutex_init(&new->boundsLock, NULL);
+  setWorldRenderDistance(new, RENDER_DISTANCE);
+  new->bounds = createCullTree(width, height);
+  new->boundsGeneration = getChunkHeightGeneration();
   new->width  = width;
   new->height = height;
   for (int x = 0; x < width; x++){
-    for (int z = 0; z < width; z++){
-      char buffer[12];
-      sprintf(buffer, "(%d, %d)", x, z);
-      hashSet(new->chunks, clone(buffer), createChunk((float)x * 16, 0.0f, (float)z * 16));
+    for (int z = 0; z < height; z++){
+      insertChunk(new, x, z, loadChunk(new, x, z));
     }
   }
   return new;
 }
 
+static void saveCallback(int x, int z, void *el, void *arg){
+  chunk c = el;
+  if (chunkIsModified(c)){
+    regionStoreSave((regionstore)arg, x, z, getChunkBlocks(c));
+    setChunkModified(c, false);
+  }
+}
+
+static void *saveThread(void *arg){
+  world w = arg;
+  double start = nowSeconds();
+  writeSnapshot(w->saving, w->store);
+  w->writeSeconds = nowSeconds() - start;
+  atomic_store(&w->saveFinished, true);
+  return NULL;
+}
+
+// the snapshot has been written, by the saver or in place of one
+static void finishSave(world w){
+  freeSnapshot(w->saving);
+  w->saving = NULL;
+  atomic_store(&w->saveFinished, false);
+  w->stats.lastWriteSeconds = w->writeSeconds;
+  w->stats.savesCompleted++;
+}
+
+static void joinSave(world w){
+  if (w->saving == NULL) return;
+  pthread_join(w->saver, NULL);
+  finishSave(w);
+}
+
+bool saveWorldAsync(world w){
+  if (w->store == NULL) return false;
+  if (w->saving != NULL){
+    if (!atomic_load(&w->saveFinished)) return false;
+    joinSave(w);
+  }
+
+  double start = nowSeconds();
+  w->saving = takeSnapshot(w->chunks);
+  w->stats.lastSnapshotSeconds = nowSeconds() - start;
+  w->stats.lastSnapshotChunks  = snapshotChunks(w->saving);
+
+  if (pthread_create(&w->saver, NULL, &saveThread, w) != 0){
+    // no thread, write it out here instead
+    saveThread(w);
+    finishSave(w);
+  }
+  return true;
+}
+
+saveStats getWorldSaveStats(world w){
+  saveStats stats = w->stats;
+  stats.copiedBytes = getCopyOnWriteBytes();
+  stats.saving      = w->saving != NULL && !atomic_load(&w->saveFinished);
+  return stats;
+}
+
+void saveWorld(world w){
+  if (w->store == NULL) return;
+  joinSave(w);
+  chunkMapForeach(w->chunks, &saveCallback, w->store);
+  regionStoreFlush(w->store);
+}
+
+// FNV-1a over the chunk's place and blocks, summed so the order the
+// chunks are visited in does not matter
+static void checksumCallback(int x, int z, void *el, void *arg){
+  const uint8_t *blocks = getChunkBlocks((chunk)el);
+  uint64_t h = 0xcbf29ce484222325ull;
+  int place[2] = { x, z };
+  const uint8_t *bytes = (const uint8_t *)place;
+  for (size_t i = 0; i < sizeof(place); i++) h = (h ^ bytes[i]) * 0x100000001b3ull;
+  for (int i = 0; i < CHUNK_BLOCK_BYTES; i++) h = (h ^ blocks[i]) * 0x100000001b3ull;
+  *(uint64_t *)arg += h;
+}
+
+uint64_t worldChecksum(world w){
+  uint64_t sum = 0;
+  chunkMapForeach(w->chunks, &checksumCallback, &sum);
+  return sum;
+}
+
+void setWorldMemoryBudget(world w, size_t budgetBytes){
+  setResidencyBudget(w->resident, budgetBytes);
+}
+
+void endWorldFrame(world w){
+  if (w->saving != NULL && atomic_load(&w->saveFinished)){
+    joinSave(w);
+  }
+  residencyEndFrame(w->resident);
+  coldStoreUpdate(w->cold, w->chunks);
+  advanceChunkFrame();
+}
+
+void setWorldRenderDistance(world w, int distance){
+  int side = 2 * distance + 1;
+  w->renderDistance = distance;
+  for (int i = 0; i < RENDER_PASSES; i++){
+    visibleList *list = &w->visible[i];
+    free(list->chunks);
+    free(list->places);
+    free(list->columns);
+    free(list->occluders);
+    list->chunks    = malloc(side * side * sizeof(chunk));
+    list->places    = malloc(side * side * sizeof(column));
+    list->columns   = malloc(side * side * sizeof(column));
+    list->occluders = malloc(side * side * OCCLUDER_CELLS * OCCLUDER_CELLS * sizeof(occluder));
+    assert(list->chunks != NULL && list->places != NULL && list->columns != NULL && list->occluders != NULL);
+    list->count = 0;
+    if (list->graph != NULL) freeVisGraph(list->graph);
+    list->graph = createVisGraph(distance);
+  }
+}
+
+static void freeWorldOcclusion(world w){
+  for (int i = 0; i < RENDER_PASSES; i++){
+    visibleList *list = &w->visible[i];
+    if (list->hidden != NULL) freeOcclusion(list->hidden);
+    list->hidden = NULL;
+  }
+  if (w->rasterisers != NULL) freePool(w->rasterisers);
+  w->rasterisers = NULL;
+}
+
+void setWorldOcclusion(world w, int workers, double budgetSeconds){
+  freeWorldOcclusion(w);
+  if (budgetSeconds <= 0.0) return;
+  // passes culled at the same time take turns on the pool, rather than
+  // each bringing threads of its own
+  w->rasterisers = createPool("occlusion", workers);
+  for (int i = 0; i < RENDER_PASSES; i++){
+    w->visible[i].hidden = createOcclusion(w->rasterisers, budgetSeconds);
+  }
+}
+
+occlusionStats getWorldOcclusionStats(world w){
+  occlusion hidden = w->visible[RENDER_PASS_MAIN].hidden;
+  if (hidden == NULL) return (occlusionStats){ 0, 0, 0, 0, 0.0 };
+  return getOcclusionStats(hidden);
+}
+
+void setWorldColdAfter(world w, unsigned idleFrames){
+  setColdStoreIdleFrames(w->cold, idleFrames);
+}
+
+residencyStats getWorldResidencyStats(world w){
+  return getResidencyStats(w->resident);
+}
+
 void freeWorld(world w){
-  hashFree(w->chunks);
+  joinSave(w);
+  freeColdStore(w->cold);
+  if (w->store != NULL) closeRegionStore(w->store);
+  freeResidency(w->resident);
+  freeChunkWindow(w->window);
+  chunkMapFree(w->chunks);
+  // a no-op while another world still has chunks
+  releaseChunkPool();
+  freeCullTree(w->bounds);
+  for (int i = 0; i < RENDER_PASSES; i++){
+    visibleList *list = &w->visible[i];
+    free(list->chunks);
+    free(list->places);
+    free(list->columns);
+    free(list->occluders);
+    freeVisGraph(list->graph);
+  }
+  freeWorldOcclusion(w);
+  pthread_mutex_destroy(&w->boundsLock);
   free(w);
 }
 
+static void refreshBounds(int x, int z, void *el, void *arg){
+  int minY, maxY;
+  chunkHeightRange((chunk)el, &minY, &maxY);
+  cullTreeSetColumn((culltree)arg, x, z, (float)minY, (float)maxY);
+}
+
+struct visitArgs {
+  visibleList *list;
+  vec3 eye;
+};
+
+// called by the cull tree for each column that may be on screen
+static void visitColumn(int chunkX, int chunkZ, void *arg){
+  struct visitArgs *args = arg;
+  visibleList *list = args->list;
+  float dx = (chunkX + 0.5f) * CHUNK_SIZE_X - args->eye.x;
+  float dz = (chunkZ + 0.5f) * CHUNK_SIZE_Z - args->eye.z;
+  list->columns[list->columnCount++] = (column){ chunkX, chunkZ, dx * dx + dz * dz };
+}
+
+static chunk graphLookup(int x, int z, void *arg){
+  return getChunk((world)arg, x, z);
+}
+
+// drop the columns no line of sight gets to through the chunk graph
+static int dropUnreachable(world w, visibleList *list, int camChunkX, int camChunkZ, float camY){
+  visGraphReset(list->graph, camChunkX, camChunkZ);
+  for (int i = 0; i < list->columnCount; i++){
+    visGraphAllow(list->graph, list->columns[i].x, list->columns[i].z);
+  }
+  visGraphSearch(list->graph, camY, &graphLookup, w);
+  int kept = 0;
+  for (int i = 0; i < list->columnCount; i++){
+    if (visGraphReached(list->graph, list->columns[i].x, list->columns[i].z)){
+      list->columns[kept++] = list->columns[i];
+    }
+  }
+  int dropped = list->columnCount - kept;
+  list->columnCount = kept;
+  return dropped;
+}
+
+static int compareColumns(const void *a, const void *b){
+  float da = ((const column *)a)->distance;
+  float db = ((const column *)b)->distance;
+  return (da > db) - (da < db);
+}
+
+// rasterise the opaque parts of the loaded columns, nearest first
+static void drawOccluders(world w, visibleList *list, const mat4 *viewProj, vec3 eye){
+  int count = 0;
+  for (int i = 0; i < list->columnCount; i++){
+    chunk c = getChunk(w, list->columns[i].x, list->columns[i].z);
+    if (c == NULL) continue;
+    for (int x = 0; x < OCCLUDER_CELLS; x++){
+      for (int z = 0; z < OCCLUDER_CELLS; z++){
+        occluder *o = &list->occluders[count];
+        if (chunkOccluder(c, x, z, &o->min, &o->max)) count++;
+      }
+    }
+  }
+  occlusionRasterise(list->hidden, viewProj, eye, list->occluders, count);
+}
+
+static bool columnHidden(visibleList *list, chunk c, int chunkX, int chunkZ){
+  int minY = 0, maxY = CHUNK_SIZE_Y;
+  if (c != NULL) chunkHeightRange(c, &minY, &maxY);
+  vec3 min = vec3Make((float)(chunkX * CHUNK_SIZE_X), (float)minY, (float)(chunkZ * CHUNK_SIZE_Z));
+  vec3 max = vec3Make(min.x + CHUNK_SIZE_X, (float)maxY, min.z + CHUNK_SIZE_Z);
+  return !occlusionTestBox(list->hidden, min, max);
+}
+
+void cullWorld(world w, RENDER_PASS pass, vec3 eye, const mat4 *view, const mat4 *proj){
+  visibleList *list = &w->visible[pass];
+  mat4 viewProj = mat4Multiply(proj, view);
+  frustum f = frustumFromMatrix(&viewProj);
+
+  pthread_mutex_lock(&w->boundsLock);
+  if (w->boundsGeneration != getChunkHeightGeneration()){
+    // blocks were placed above or below what the tree knows about
+    chunkMapForeach(w->chunks, &refreshBounds, w->bounds);
+    w->boundsGeneration = getChunkHeightGeneration();
+  }
+  pthread_mutex_unlock(&w->boundsLock);
+
+  // Get the chunk position of the camera
+  int camChunkX = (int)floorf(eye.x / 16.0f);
+  int camChunkZ = (int)floorf(eye.z / 16.0f);
+  int minX = camChunkX - w->renderDistance, maxX = camChunkX + w->renderDistance;
+  int minZ = camChunkZ - w->renderDistance, maxZ = camChunkZ + w->renderDistance;
+
+  list->count = 0;
+  list->stats = (passStats){ 0, 0, 0, 0, 0, 0 };
+  list->columnCount = 0;
+  struct visitArgs args = { list, eye };
+  list->stats.boxTests = cullTreeQuery(w->bounds, &f, minX, minZ, maxX, maxZ, &visitColumn, &args);
+
+  int spanX = (maxX < w->width - 1 ? maxX : w->width - 1) - (minX > 0 ? minX : 0) + 1;
+  int spanZ = (maxZ < w->height - 1 ? maxZ : w->height - 1) - (minZ > 0 ? minZ : 0) + 1;
+  list->stats.considered = spanX > 0 && spanZ > 0 ? spanX * spanZ : 0;
+  list->stats.culled     = list->stats.considered - list->columnCount;
+  list->stats.unreachable = dropUnreachable(w, list, camChunkX, camChunkZ, eye.y);
+
+  // near to far, so the nearest occluders make the budget and the GPU
+  // gets to reject hidden fragments early
+  qsort(list->columns, list->columnCount, sizeof(column), &compareColumns);
+  if (list->hidden != NULL) drawOccluders(w, list, &viewProj, eye);
+
+  for (int i = 0; i < list->columnCount; i++){
+    int chunkX = list->columns[i].x;
+    int chunkZ = list->columns[i].z;
+    chunk c = getChunk(w, chunkX, chunkZ);
+    if (list->hidden != NULL && columnHidden(list, c, chunkX, chunkZ)){
+      list->stats.occluded++;
+      continue;
+    }
+    list->places[list->count] = list->columns[i];
+    list->chunks[list->count++] = c;
+  }
+}
+
+void drawWorld(
+  world w,
+  RENDER_PASS pass,
+  GLuint program,
+  GLuint waterShader,
+  mat4x4 view,
+  mat4x4 proj,
+  vec3d lightPos,
+  vec3d viewPos,
+  float time, GLuint texture,
+  GLuint reflectedTex,
+  GLuint dudvTex, GLuint normalTex
+) {
+  visibleList *list = &w->visible[pass];
+  for (int i = 0; i < list->count; i++){
+    int chunkX = list->places[i].x;
+    int chunkZ = list->places[i].z;
+    if (list->chunks[i] == NULL){
+      // evicted earlier, stream it back in unless the other pass's draw
+      // already has, both passes were culled before either was drawn
+      list->chunks[i] = getChunk(w, chunkX, chunkZ);
+      if (list->chunks[i] == NULL){
+        list->chunks[i] = loadChunk(w, chunkX, chunkZ);
+        insertChunk(w, chunkX, chunkZ, list->chunks[i]);
+      }
+    }
+    residencyTouch(w->resident, chunkX, chunkZ);
+  }
+
+  for (int i = 0; i < list->count; i++){
+    renderChunk(list->chunks[i], program, waterShader, view, proj, lightPos, viewPos, time, texture,
+                pass == RENDER_PASS_REFLECTION, reflectedTex, dudvTex, normalTex);
+  }
+  list->stats.drawn = list->count;
+}
+
 void renderWorld(
   world w, 
   vec3d camPos, 
@@ -65,34 +532,17 @@ void renderWorld(
   bool fake, GLuint reflectedTex, 
   GLuint dudvTex, GLuint normalTex
 ) {
-  int renderDistance = 5; 
-
-  // Get the chunk position of the camera
-  int camChunkX = (int)(camPos->x / 16.0f);
-  int camChunkZ = (int)(camPos->z / 16.0f);
-
-  for (int dx = -renderDistance; dx <= renderDistance; dx++) {
-    for (int dz = -renderDistance; dz <= renderDistance; dz++) {
-      int chunkX = camChunkX + dx;
-      int chunkZ = camChunkZ + dz;
-
-      if (chunkX < 0 || chunkX >= w->width || chunkZ < 0 || chunkZ >= w->height){
-        continue;
-      }
-
-      char buffer[20];
-      sprintf(buffer, "(%d, %d)", chunkX, chunkZ);
-
-      chunk c = hashFind(w->chunks, buffer);
-      if (c != NULL) {
-        renderChunk(c, program, waterShader, view, proj, lightPos, viewPos, time, texture, fake, reflectedTex, dudvTex, normalTex);
-      }
-    }
-  }
+  RENDER_PASS pass = fake ? RENDER_PASS_REFLECTION : RENDER_PASS_MAIN;
+  cullWorld(w, pass, *camPos, view, proj);
+  drawWorld(w, pass, program, waterShader, view, proj, lightPos, viewPos, time, texture,
+            reflectedTex, dudvTex, normalTex);
 }
 
+passStats getWorldPassStats(world w, RENDER_PASS pass){
+  return w->visible[pass].stats;
+}
 
-
-
-
-
+chunk *getWorldVisibleChunks(world w, RENDER_PASS pass, int *count){
+  *count = w->visible[pass].count;
+  return w->visible[pass].chunks;
+}
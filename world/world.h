@@ -2,16 +2,99 @@
 #define WORLD_H
 
 #include "../utils/math.h"
-#include "../adts/hash.h"
+#include "../adts/chunkmap.h"
+#include "chunk.h"
+#include "residency.h"
+#include "occlusion.h"
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 
 struct world;
 typedef struct world *world;
 
-extern hash getChunks(world w);
-extern world createWorld(int width, int height);
+typedef struct {
+  double lastSnapshotSeconds; // main thread time spent taking the snapshot
+  int lastSnapshotChunks;
+  double lastWriteSeconds;    // background time spent writing it out
+  unsigned long copiedBytes;  // copy-on-write bytes since startup
+  int savesCompleted;
+  bool saving;
+} saveStats;
+
+// renderWorld with fake set draws the reflection pass
+typedef enum {
+  RENDER_PASS_MAIN,
+  RENDER_PASS_REFLECTION,
+  RENDER_PASSES
+} RENDER_PASS;
+
+typedef struct {
+  int considered;  // chunks in range of the camera
+  int culled;      // of those, outside the view frustum or all air
+  int unreachable; // in the frustum but walled off in the chunk graph
+  int occluded;    // reachable but hidden behind terrain
+  int drawn;
+  int boxTests;    // bounding boxes tested against the frustum
+} passStats;
+
+extern chunkmap getChunks(world w);
+// NULL when the chunk at chunk coordinates (chunkX, chunkZ) is not loaded
+extern chunk getChunk(world w, int chunkX, int chunkZ);
+// recentre the window of directly indexed chunks on the given world position
+extern void centreWorld(world w, vec3d pos);
+// saveDir may be NULL for a world that is never loaded from or saved to disk
+extern world createWorld(int width, int height, const char *saveDir);
+// write every modified chunk to the world's region files
+extern void saveWorld(world w);
+// snapshot the modified chunks and write them out on a background thread,
+// along with edited chunks evicted since the last save. Returns false if
+// there is no save directory or a save is still running
+extern bool saveWorldAsync(world w);
+extern saveStats getWorldSaveStats(world w);
+// of the blocks of every loaded chunk, whatever order they were loaded in
+extern uint64_t worldChecksum(world w);
 extern void freeWorld(world w);
+// bytes of block and mesh data to keep loaded, 0 for no limit
+extern void setWorldMemoryBudget(world w, size_t budgetBytes);
+// call once per frame after rendering, evicts chunks over the budget.
+// Edited chunks it evicts reach the disk with the next save
+extern void endWorldFrame(world w);
+extern residencyStats getWorldResidencyStats(world w);
+// chunks drawn in each direction around the camera
+extern void setWorldRenderDistance(world w, int distance);
+// hide chunks behind terrain using workers threads besides the culling
+// one, shared by the passes, spending at most budgetSeconds a pass on it.
+// A budget of 0 turns it off.
+extern void setWorldOcclusion(world w, int workers, double budgetSeconds);
+// from the last pass rendered with occlusion culling on
+extern occlusionStats getWorldOcclusionStats(world w);
+// compress the blocks of chunks untouched for idleFrames frames, 0 to never
+extern void setWorldColdAfter(world w, unsigned idleFrames);
+// counts from the last time the pass was rendered
+extern passStats getWorldPassStats(world w, RENDER_PASS pass);
+// the chunks the pass drew last time. Valid until the pass is culled
+// again or endWorldFrame is called, which may evict and free them
+extern chunk *getWorldVisibleChunks(world w, RENDER_PASS pass, int *count);
+// Culling a pass makes no GL calls and may run on any thread, the two
+// passes at the same time, as long as nothing loads, evicts or edits
+// chunks or recentres the world meanwhile. Drawing what the last cull of
+// the pass kept is done on the GL thread, and loads any chunk that was
+// evicted since.
+extern void cullWorld(world w, RENDER_PASS pass, vec3 eye, const mat4 *view, const mat4 *proj);
+extern void drawWorld(
+  world w,
+  RENDER_PASS pass,
+  GLuint program,
+  GLuint waterShader,
+  mat4x4 view,
+  mat4x4 proj,
+  vec3d lightPos,
+  vec3d viewPos,
+  float time, GLuint texture,
+  GLuint reflectedTex,
+  GLuint dudvTex, GLuint normalTex
+);
+// both of the above, fake set for the reflection pass
 extern void renderWorld(
   world w, 
   vec3d camPos, 